@@ -99,6 +99,17 @@ ifeq ($(CFG_CORE_LARGE_PHYS_ADDR),y)
 $(call force,CFG_WITH_LPAE,y)
 endif
 
+# Map physically contiguous user mode regions covering complete 2 MiB
+# ranges with block entries in the user page directory instead of with one
+# translation table per 2 MiB. Saves translation tables and TLB entries
+# for large TA mappings.
+CFG_CORE_USER_BLOCK_MAP ?= n
+ifeq ($(CFG_CORE_USER_BLOCK_MAP),y)
+ifneq ($(CFG_WITH_LPAE),y)
+$(error CFG_CORE_USER_BLOCK_MAP depends on CFG_WITH_LPAE)
+endif
+endif
+
 # SPMC configuration "S-EL1 SPMC" where SPM Core is implemented at S-EL1,
 # that is, OP-TEE.
 ifeq ($(CFG_CORE_SEL1_SPMC),y)
@@ -131,6 +142,25 @@ $(error CFG_CORE_FFA depends on CFG_DT)
 endif
 endif
 
+ifeq ($(CFG_CORE_FFA)-$(CFG_CORE_MSG_RING),y-y)
+$(error CFG_CORE_MSG_RING is not supported with CFG_CORE_FFA)
+endif
+
+ifeq ($(CFG_CORE_FFA)-$(CFG_TA_PARAM_MAP_CACHE),y-y)
+$(error CFG_TA_PARAM_MAP_CACHE is not supported with CFG_CORE_FFA)
+endif
+
+# A TA would read the virtual counter which the time page doesn't describe
+ifeq ($(CFG_CORE_SEL2_SPMC)-$(CFG_TA_TIME_PAGE),y-y)
+$(error CFG_TA_TIME_PAGE is not supported with CFG_CORE_SEL2_SPMC)
+endif
+
+# Concurrent TAs find the state of each entry with TPIDR_EL0 which only the
+# AArch64 core keeps per thread
+ifeq ($(CFG_ARM32_core)-$(CFG_CONCURRENT_USER_TA),y-y)
+$(error CFG_CONCURRENT_USER_TA is not supported with CFG_ARM32_core)
+endif
+
 ifeq ($(CFG_CORE_PHYS_RELOCATABLE)-$(CFG_WITH_PAGER),y-y)
 $(error CFG_CORE_PHYS_RELOCATABLE and CFG_WITH_PAGER are not compatible)
 endif
@@ -454,6 +454,7 @@ DEFINE_U64_REG_READ_FUNC(midr_el1)
 DEFINE_U64_REG_READ_FUNC(par_el1)
 
 DEFINE_U64_REG_WRITE_FUNC(mair_el1)
+DEFINE_U64_REG_WRITE_FUNC(tpidr_el0)
 
 DEFINE_U64_REG_READ_FUNC(id_aa64mmfr1_el1)
 DEFINE_U64_REG_READ_FUNC(id_aa64pfr1_el1)
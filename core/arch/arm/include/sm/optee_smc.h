@@ -290,7 +290,9 @@
  *		  as the second MSG arg struct for
  *		  OPTEE_SMC_CALL_WITH_ARG
  *	Bit[31:8]: Reserved (MBZ)
- * a3-7	Preserved
+ * a4	Asynchronous notification value sent when a thread becomes
+ *	available, only valid with OPTEE_SMC_SEC_CAP_THREAD_AVAIL_NOTIF
+ * a5-7	Preserved
  *
  * Error return register usage:
  * a0	OPTEE_SMC_RETURN_ENOTAVAIL, can't use the capabilities from normal world
@@ -316,6 +318,17 @@
 #define OPTEE_SMC_SEC_CAP_ASYNC_NOTIF		BIT(5)
 /* Secure world supports pre-allocating RPC arg struct */
 #define OPTEE_SMC_SEC_CAP_RPC_ARG		BIT(6)
+/*
+ * Secure world sends an asynchronous notification when a thread is freed
+ * after a call has returned OPTEE_SMC_RETURN_ETHREAD_LIMIT, normal world
+ * can wait for that instead of retrying.
+ */
+#define OPTEE_SMC_SEC_CAP_THREAD_AVAIL_NOTIF	BIT(7)
+/*
+ * Secure world supports the OPTEE_MSG_CMD_*_RING commands for batched
+ * submissions through a shared memory ring
+ */
+#define OPTEE_SMC_SEC_CAP_MSG_RING		BIT(8)
 
 #define OPTEE_SMC_FUNCID_EXCHANGE_CAPABILITIES	U(9)
 #define OPTEE_SMC_EXCHANGE_CAPABILITIES \
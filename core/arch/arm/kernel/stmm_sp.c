@@ -363,7 +363,7 @@ TEE_Result stmm_init_session(const TEE_UUID *uuid, struct tee_ta_session *sess)
 
 	mutex_lock(&tee_ta_mutex);
 	spc->is_initializing = false;
-	TAILQ_INSERT_TAIL(&tee_ctxes, &spc->ta_ctx, link);
+	tee_ta_register_ctx(&spc->ta_ctx);
 	mutex_unlock(&tee_ta_mutex);
 
 	return TEE_SUCCESS;
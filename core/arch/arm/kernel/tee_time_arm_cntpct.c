@@ -29,6 +29,7 @@ static const struct time_source arm_cntpct_time_source = {
 	.name = "arm cntpct",
 	.protection_level = 1000,
 	.get_sys_time = arm_cntpct_get_sys_time,
+	.user_counter = IS_ENABLED(CFG_TA_TIME_PAGE),
 };
 
 REGISTER_TIME_SOURCE(arm_cntpct_time_source)
@@ -222,24 +222,12 @@ static void __thread_alloc_and_run(uint32_t a0, uint32_t a1, uint32_t a2,
 				   void *pc, uint32_t flags)
 {
 	struct thread_core_local *l = thread_get_core_local();
-	bool found_thread = false;
-	size_t n = 0;
+	int n = THREAD_ID_INVALID;
 
 	assert(l->curr_thread == THREAD_ID_INVALID);
 
-	thread_lock_global();
-
-	for (n = 0; n < CFG_NUM_THREADS; n++) {
-		if (threads[n].state == THREAD_STATE_FREE) {
-			threads[n].state = THREAD_STATE_ACTIVE;
-			found_thread = true;
-			break;
-		}
-	}
-
-	thread_unlock_global();
-
-	if (!found_thread)
+	n = thread_claim_free_ctx();
+	if (n == THREAD_ID_INVALID)
 		return;
 
 	l->curr_thread = n;
@@ -459,9 +447,7 @@ void thread_state_free(void)
 
 	thread_lock_global();
 
-	assert(threads[ct].state == THREAD_STATE_ACTIVE);
-	threads[ct].state = THREAD_STATE_FREE;
-	threads[ct].flags = 0;
+	thread_release_ctx(ct);
 	l->curr_thread = THREAD_ID_INVALID;
 
 	if (IS_ENABLED(CFG_NS_VIRTUALIZATION))
@@ -797,6 +783,10 @@ void thread_init_per_cpu(void)
 	 */
 	write_cntkctl(read_cntkctl() | CNTKCTL_PL0PCTEN);
 #endif
+#ifdef CFG_TA_TIME_PAGE
+	/* User TAs read the physical counter to compute system time */
+	write_cntkctl(read_cntkctl() | CNTKCTL_PL0PCTEN);
+#endif
 }
 
 #ifdef CFG_WITH_VFP
@@ -918,7 +908,7 @@ void thread_user_save_vfp(void)
 
 void thread_user_clear_vfp(struct user_mode_ctx *uctx)
 {
-	struct thread_user_vfp_state *uvfp = &uctx->vfp;
+	struct thread_user_vfp_state *uvfp = user_mode_ctx_get_vfp(uctx);
 	struct thread_ctx *thr = threads + thread_get_id();
 
 	if (uvfp == thr->vfp_state.uvfp)
@@ -1017,6 +1007,22 @@ static struct thread_pauth_keys *thread_get_pauth_keys(void)
 #endif
 }
 
+#ifdef ARM64
+/*
+ * When a TA calls another TA the thread pointer of the called TA is left
+ * in the thread context and in TPIDR_EL0, restore the one of the caller
+ * which it uses to find its TCB and its state of the entry.
+ */
+static void restore_user_tpidr(uint64_t tpidr_el0)
+{
+	uint32_t exceptions = thread_mask_exceptions(THREAD_EXCP_ALL);
+
+	thread_get_ctx_regs()->tpidr_el0 = tpidr_el0;
+	write_tpidr_el0(tpidr_el0);
+	thread_unmask_exceptions(exceptions);
+}
+#endif
+
 uint32_t thread_enter_user_mode(unsigned long a0, unsigned long a1,
 		unsigned long a2, unsigned long a3, unsigned long user_sp,
 		unsigned long entry_func, bool is_32bit,
@@ -1027,6 +1033,7 @@ uint32_t thread_enter_user_mode(unsigned long a0, unsigned long a1,
 	uint32_t rc = 0;
 	struct thread_ctx_regs *regs = NULL;
 	struct thread_pauth_keys *keys = NULL;
+	uint64_t tpidr_el0 __maybe_unused = 0;
 
 	tee_ta_update_session_utime_resume();
 
@@ -1047,8 +1054,14 @@ uint32_t thread_enter_user_mode(unsigned long a0, unsigned long a1,
 	 * unmasked when user mode has been entered.
 	 */
 	regs = thread_get_ctx_regs();
+#ifdef ARM64
+	tpidr_el0 = regs->tpidr_el0;
+#endif
 	set_ctx_regs(regs, a0, a1, a2, a3, user_sp, entry_func, spsr, keys);
 	rc = __thread_enter_user_mode(regs, exit_status0, exit_status1);
+#ifdef ARM64
+	restore_user_tpidr(tpidr_el0);
+#endif
 	thread_unmask_exceptions(exceptions);
 	return rc;
 }
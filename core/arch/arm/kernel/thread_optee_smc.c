@@ -13,7 +13,9 @@
 #include <kernel/thread.h>
 #include <kernel/thread_private.h>
 #include <kernel/virtualization.h>
+#include <malloc.h>
 #include <mm/core_mmu.h>
+#include <mm/tee_pager.h>
 #include <optee_msg.h>
 #include <optee_rpc_cmd.h>
 #include <sm/optee_smc.h>
@@ -27,6 +29,8 @@
 static bool thread_prealloc_rpc_cache;
 static unsigned int thread_rpc_pnum;
 
+static void clear_payload_cache(struct thread_ctx *thr, bool keep_kernel);
+
 static_assert(NOTIF_VALUE_DO_BOTTOM_HALF ==
 	      OPTEE_SMC_ASYNC_NOTIF_VALUE_DO_BOTTOM_HALF);
 
@@ -169,6 +173,16 @@ static uint32_t call_entry_std(struct optee_msg_arg *arg, size_t num_params,
 		rv = OPTEE_SMC_RETURN_OK;
 
 	thread_rpc_shm_cache_clear(&thr->shm_cache);
+
+	/*
+	 * Application payloads are owned by tee-supplicant and can only be
+	 * released with an RPC so they don't outlive the call. Kernel
+	 * payloads are kept as long as the prealloc RPC cache is enabled
+	 * and are handed back by thread_disable_prealloc_rpc_cache().
+	 */
+	if (IS_ENABLED(CFG_RPC_PAYLOAD_CACHE))
+		clear_payload_cache(thr, thread_prealloc_rpc_cache);
+
 	if (rpc_arg)
 		thr->rpc_arg = NULL;
 
@@ -296,10 +310,17 @@ uint32_t __weak __thread_std_smc_entry(uint32_t a0, uint32_t a1, uint32_t a2,
 				       uint32_t a3, uint32_t a4 __unused,
 				       uint32_t a5 __unused)
 {
+	uint32_t rv = 0;
+
 	if (IS_ENABLED(CFG_NS_VIRTUALIZATION))
 		virt_on_stdcall();
 
-	return std_smc_entry(a0, a1, a2, a3);
+	rv = std_smc_entry(a0, a1, a2, a3);
+
+	/* The call is served, a good time to save dirty paged pages */
+	tee_pager_preclean();
+
+	return rv;
 }
 
 bool thread_disable_prealloc_rpc_cache(uint64_t *cookie)
@@ -331,6 +352,22 @@ bool thread_disable_prealloc_rpc_cache(uint64_t *cookie)
 		}
 	}
 
+	if (IS_ENABLED(CFG_RPC_PAYLOAD_CACHE)) {
+		for (n = 0; n < CFG_NUM_THREADS; n++) {
+			struct mobj **slots = threads[n].payload_cache.kernel;
+			size_t m = 0;
+
+			for (m = 0; m < THREAD_RPC_PAYLOAD_NUM_CLASSES; m++) {
+				if (slots[m]) {
+					*cookie = mobj_get_cookie(slots[m]);
+					mobj_put(slots[m]);
+					slots[m] = NULL;
+					goto out;
+				}
+			}
+		}
+	}
+
 	*cookie = 0;
 	thread_prealloc_rpc_cache = false;
 out:
@@ -366,15 +403,43 @@ out:
 	return rv;
 }
 
+/*
+ * Describes a physically contiguous non-secure buffer with a page list so
+ * it's mapped the same way as an OPTEE_MSG_ATTR_NONCONTIG buffer.
+ */
+static struct mobj *contig_shm_mobj_alloc(paddr_t pa, size_t sz,
+					  uint64_t cookie)
+{
+	struct mobj *mobj = NULL;
+	size_t num_pages = 0;
+	paddr_t *pages = NULL;
+	size_t n = 0;
+
+	if (!sz)
+		return NULL;
+	num_pages = ROUNDUP_DIV(sz, SMALL_PAGE_SIZE);
+	if (num_pages == 1)
+		return mobj_mapped_shm_alloc(&pa, 1, 0, cookie);
+
+	pages = calloc(num_pages, sizeof(*pages));
+	if (!pages)
+		return NULL;
+	for (n = 0; n < num_pages; n++)
+		pages[n] = pa + n * SMALL_PAGE_SIZE;
+
+	mobj = mobj_mapped_shm_alloc(pages, num_pages, 0, cookie);
+	free(pages);
+	return mobj;
+}
+
 static struct mobj *rpc_shm_mobj_alloc(paddr_t pa, size_t sz, uint64_t cookie)
 {
 	/* Check if this region is in static shared space */
 	if (core_pbuf_is(CORE_MEM_NSEC_SHM, pa, sz))
 		return mobj_shm_alloc(pa, sz, cookie);
 
-	if (IS_ENABLED(CFG_CORE_DYN_SHM) &&
-	    !(pa & SMALL_PAGE_MASK) && sz <= SMALL_PAGE_SIZE)
-		return mobj_mapped_shm_alloc(&pa, 1, 0, cookie);
+	if (IS_ENABLED(CFG_CORE_DYN_SHM) && !(pa & SMALL_PAGE_MASK))
+		return contig_shm_mobj_alloc(pa, sz, cookie);
 
 	return NULL;
 }
@@ -674,33 +739,155 @@ static struct mobj *thread_rpc_alloc(size_t size, size_t align, unsigned int bt)
 	return get_rpc_alloc_res(arg, bt, size);
 }
 
-struct mobj *thread_rpc_alloc_payload(size_t size)
+static size_t payload_class_size(size_t n)
 {
-	return thread_rpc_alloc(size, 8, OPTEE_RPC_SHM_TYPE_APPL);
+	return SMALL_PAGE_SIZE << n;
 }
 
-struct mobj *thread_rpc_alloc_kernel_payload(size_t size)
+static struct mobj **payload_cache_slots(struct thread_ctx *thr,
+					 unsigned int bt)
+{
+	if (bt == OPTEE_RPC_SHM_TYPE_APPL)
+		return thr->payload_cache.appl;
+	if (bt == OPTEE_RPC_SHM_TYPE_KERNEL)
+		return thr->payload_cache.kernel;
+	return NULL;
+}
+
+/*
+ * Returns a cached buffer of type @bt large enough for *@size bytes, or
+ * NULL if there's none. *@size is rounded up to the size class to
+ * allocate from normal world if nothing was cached.
+ */
+static struct mobj *payload_cache_get(unsigned int bt, size_t *size)
 {
+	struct thread_ctx *thr = threads + thread_get_id();
+	struct mobj **slots = payload_cache_slots(thr, bt);
+	struct mobj *mobj = NULL;
+	size_t n = 0;
+
+	if (!IS_ENABLED(CFG_RPC_PAYLOAD_CACHE) || !slots)
+		return NULL;
+
+	for (n = 0; n < THREAD_RPC_PAYLOAD_NUM_CLASSES; n++) {
+		if (*size <= payload_class_size(n)) {
+			*size = payload_class_size(n);
+			mobj = slots[n];
+			slots[n] = NULL;
+			return mobj;
+		}
+	}
+
+	return NULL;
+}
+
+/* Returns true if @mobj was kept in the cache instead of being freed */
+static bool payload_cache_put(unsigned int bt, struct mobj *mobj)
+{
+	struct thread_ctx *thr = threads + thread_get_id();
+	struct mobj **slots = payload_cache_slots(thr, bt);
+	size_t n = THREAD_RPC_PAYLOAD_NUM_CLASSES;
+
+	if (!IS_ENABLED(CFG_RPC_PAYLOAD_CACHE) || !slots || !mobj)
+		return false;
+
+	while (n) {
+		n--;
+		if (mobj->size >= payload_class_size(n)) {
+			if (slots[n])
+				return false;
+			slots[n] = mobj;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool clear_payload_slots(struct mobj **slots, unsigned int bt)
+{
+	bool cleared = false;
+	size_t n = 0;
+
+	for (n = 0; n < THREAD_RPC_PAYLOAD_NUM_CLASSES; n++) {
+		if (slots[n]) {
+			thread_rpc_free(bt, mobj_get_cookie(slots[n]),
+					slots[n]);
+			slots[n] = NULL;
+			cleared = true;
+		}
+	}
+
+	return cleared;
+}
+
+static void clear_payload_cache(struct thread_ctx *thr, bool keep_kernel)
+{
+	clear_payload_slots(thr->payload_cache.appl, OPTEE_RPC_SHM_TYPE_APPL);
+	if (!keep_kernel)
+		clear_payload_slots(thr->payload_cache.kernel,
+				    OPTEE_RPC_SHM_TYPE_KERNEL);
+}
+
+static struct mobj *alloc_payload(size_t size, unsigned int bt)
+{
+	struct thread_ctx *thr = NULL;
+	struct mobj *mobj = NULL;
+	size_t sz = size;
+
+	mobj = payload_cache_get(bt, &sz);
+	if (mobj)
+		return mobj;
+
+	mobj = thread_rpc_alloc(sz, 8, bt);
+	if (mobj || !IS_ENABLED(CFG_RPC_PAYLOAD_CACHE))
+		return mobj;
+
 	/*
-	 * Error out early since kernel private dynamic shared memory
-	 * allocations don't currently use the `OPTEE_MSG_ATTR_NONCONTIG` bit
-	 * and therefore cannot be larger than a page.
+	 * Normal world is short of memory, give back what this thread
+	 * holds and try again if that was anything.
 	 */
-	if (IS_ENABLED(CFG_CORE_DYN_SHM) && size > SMALL_PAGE_SIZE)
+	thr = threads + thread_get_id();
+	if (!clear_payload_slots(thr->payload_cache.appl,
+				 OPTEE_RPC_SHM_TYPE_APPL) &&
+	    !clear_payload_slots(thr->payload_cache.kernel,
+				 OPTEE_RPC_SHM_TYPE_KERNEL))
 		return NULL;
 
-	return thread_rpc_alloc(size, 8, OPTEE_RPC_SHM_TYPE_KERNEL);
+	return thread_rpc_alloc(sz, 8, bt);
+}
+
+static void free_payload(struct mobj *mobj, unsigned int bt)
+{
+	if (!payload_cache_put(bt, mobj))
+		thread_rpc_free(bt, mobj_get_cookie(mobj), mobj);
+}
+
+struct mobj *thread_rpc_alloc_payload(size_t size)
+{
+	return alloc_payload(size, OPTEE_RPC_SHM_TYPE_APPL);
+}
+
+struct mobj *thread_rpc_alloc_kernel_payload(size_t size)
+{
+	/*
+	 * Kernel private dynamic shared memory may be returned either as
+	 * a page list with the OPTEE_MSG_ATTR_NONCONTIG bit or as a
+	 * physically contiguous buffer, both are mapped as a list of pages
+	 * so there's no upper limit of the size besides the shared memory
+	 * virtual address space.
+	 */
+	return alloc_payload(size, OPTEE_RPC_SHM_TYPE_KERNEL);
 }
 
 void thread_rpc_free_kernel_payload(struct mobj *mobj)
 {
-	thread_rpc_free(OPTEE_RPC_SHM_TYPE_KERNEL, mobj_get_cookie(mobj), mobj);
+	free_payload(mobj, OPTEE_RPC_SHM_TYPE_KERNEL);
 }
 
 void thread_rpc_free_payload(struct mobj *mobj)
 {
-	thread_rpc_free(OPTEE_RPC_SHM_TYPE_APPL, mobj_get_cookie(mobj),
-			mobj);
+	free_payload(mobj, OPTEE_RPC_SHM_TYPE_APPL);
 }
 
 struct mobj *thread_rpc_alloc_global_payload(size_t size)
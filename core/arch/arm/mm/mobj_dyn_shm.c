@@ -38,6 +38,8 @@ struct mobj_reg_shm {
 	tee_mm_entry_t *mm;
 	paddr_t page_offset;
 	struct refcount mapcount;
+	TAILQ_ENTRY(mobj_reg_shm) idle_link;
+	bool idle;
 	bool guarded;
 	bool releasing;
 	bool release_frees;
@@ -61,6 +63,19 @@ static SLIST_HEAD(reg_shm_head, mobj_reg_shm) reg_shm_list =
 static unsigned int reg_shm_slist_lock = SPINLOCK_UNLOCK;
 static unsigned int reg_shm_map_lock = SPINLOCK_UNLOCK;
 
+/*
+ * Registered shared memory which isn't used by anyone any longer is kept
+ * mapped on reg_shm_idle_list, least recently used first, as long as the
+ * idle mappings in total stay below CFG_CORE_DYN_SHM_MAP_CACHE_SIZE bytes.
+ * An idle mapping is reclaimed when the shared memory virtual address
+ * space runs out or when the shared memory is freed.
+ *
+ * Protected by reg_shm_map_lock.
+ */
+static TAILQ_HEAD(reg_shm_idle_head, mobj_reg_shm) reg_shm_idle_list =
+	TAILQ_HEAD_INITIALIZER(reg_shm_idle_list);
+static struct mobj_reg_shm_map_stats reg_shm_map_stats;
+
 static struct mobj_reg_shm *to_mobj_reg_shm(struct mobj *mobj);
 
 static TEE_Result mobj_reg_shm_get_pa(struct mobj *mobj, size_t offst,
@@ -101,26 +116,92 @@ static size_t mobj_reg_shm_get_phys_offs(struct mobj *mobj,
 	return to_mobj_reg_shm(mobj)->page_offset;
 }
 
+/*
+ * An idle mapping may be evicted at any time so only a mapping held with
+ * mobj_inc_map() has a virtual address. Checked under reg_shm_map_lock
+ * which is also held while evicting.
+ */
 static void *mobj_reg_shm_get_va(struct mobj *mobj, size_t offst, size_t len)
 {
 	struct mobj_reg_shm *mrs = to_mobj_reg_shm(mobj);
+	uint32_t exceptions = 0;
+	void *va = NULL;
 
-	if (!mrs->mm || !mobj_check_offset_and_len(mobj, offst, len))
+	if (!mobj_check_offset_and_len(mobj, offst, len))
 		return NULL;
 
-	return (void *)(vaddr_t)(tee_mm_get_smem(mrs->mm) + offst +
-				 mrs->page_offset);
+	exceptions = cpu_spin_lock_xsave(&reg_shm_map_lock);
+	if (mrs->mm && refcount_val(&mrs->mapcount))
+		va = (void *)(vaddr_t)(tee_mm_get_smem(mrs->mm) + offst +
+				       mrs->page_offset);
+	cpu_spin_unlock_xrestore(&reg_shm_map_lock, exceptions);
+
+	return va;
+}
+
+static void reg_shm_clear_idle(struct mobj_reg_shm *r)
+{
+	TAILQ_REMOVE(&reg_shm_idle_list, r, idle_link);
+	r->idle = false;
+	reg_shm_map_stats.idle_count--;
+	reg_shm_map_stats.idle_bytes -= tee_mm_get_bytes(r->mm);
 }
 
 static void reg_shm_unmap_helper(struct mobj_reg_shm *r)
 {
 	assert(r->mm);
 	assert(r->mm->pool->shift == SMALL_PAGE_SHIFT);
+	if (r->idle)
+		reg_shm_clear_idle(r);
+	reg_shm_map_stats.mapped_bytes -= tee_mm_get_bytes(r->mm);
 	core_mmu_unmap_pages(tee_mm_get_smem(r->mm), r->mm->size);
 	tee_mm_free(r->mm);
 	r->mm = NULL;
 }
 
+static bool reg_shm_evict_idle(void)
+{
+	struct mobj_reg_shm *r = TAILQ_FIRST(&reg_shm_idle_list);
+
+	if (!r)
+		return false;
+
+	reg_shm_unmap_helper(r);
+	reg_shm_map_stats.evictions++;
+
+	return true;
+}
+
+static void reg_shm_set_idle(struct mobj_reg_shm *r)
+{
+	size_t sz = tee_mm_get_bytes(r->mm);
+
+	if (sz > CFG_CORE_DYN_SHM_MAP_CACHE_SIZE) {
+		reg_shm_unmap_helper(r);
+		return;
+	}
+
+	r->idle = true;
+	TAILQ_INSERT_TAIL(&reg_shm_idle_list, r, idle_link);
+	reg_shm_map_stats.idle_count++;
+	reg_shm_map_stats.idle_bytes += sz;
+
+	while (reg_shm_map_stats.idle_bytes > CFG_CORE_DYN_SHM_MAP_CACHE_SIZE)
+		reg_shm_evict_idle();
+}
+
+static tee_mm_entry_t *reg_shm_alloc_va(size_t sz)
+{
+	tee_mm_entry_t *mm = NULL;
+
+	/* Reclaim idle mappings until there's enough virtual memory */
+	while (true) {
+		mm = tee_mm_alloc(&tee_mm_shm, sz);
+		if (mm || !reg_shm_evict_idle())
+			return mm;
+	}
+}
+
 static void reg_shm_free_helper(struct mobj_reg_shm *mobj_reg_shm)
 {
 	uint32_t exceptions = cpu_spin_lock_xsave(&reg_shm_map_lock);
@@ -201,11 +282,17 @@ static TEE_Result mobj_reg_shm_inc_map(struct mobj *mobj)
 
 	/*
 	 * If we have beaten another thread calling mobj_reg_shm_dec_map()
-	 * to get the lock we need only to reinitialize mapcount to 1.
+	 * to get the lock or if the mapping has been kept while idle we
+	 * need only to reinitialize mapcount to 1.
 	 */
-	if (!r->mm) {
+	if (r->mm) {
+		if (r->idle) {
+			reg_shm_clear_idle(r);
+			reg_shm_map_stats.hits++;
+		}
+	} else {
 		sz = ROUNDUP(mobj->size + r->page_offset, SMALL_PAGE_SIZE);
-		r->mm = tee_mm_alloc(&tee_mm_shm, sz);
+		r->mm = reg_shm_alloc_va(sz);
 		if (!r->mm) {
 			res = TEE_ERROR_OUT_OF_MEMORY;
 			goto out;
@@ -219,6 +306,8 @@ static TEE_Result mobj_reg_shm_inc_map(struct mobj *mobj)
 			r->mm = NULL;
 			goto out;
 		}
+		reg_shm_map_stats.misses++;
+		reg_shm_map_stats.mapped_bytes += sz;
 	}
 
 	refcount_set(&r->mapcount, 1);
@@ -242,11 +331,11 @@ static TEE_Result mobj_reg_shm_dec_map(struct mobj *mobj)
 	 * Check that another thread hasn't been able to:
 	 * - increase the mapcount
 	 * - or, increase the mapcount, decrease it again, and set r->mm to
-	 *   NULL
+	 *   NULL or put it on the idle list
 	 * before we acquired the spinlock
 	 */
-	if (!refcount_val(&r->mapcount) && r->mm)
-		reg_shm_unmap_helper(r);
+	if (!refcount_val(&r->mapcount) && r->mm && !r->idle)
+		reg_shm_set_idle(r);
 
 	cpu_spin_unlock_xrestore(&reg_shm_map_lock, exceptions);
 
@@ -379,6 +468,23 @@ struct mobj *mobj_reg_shm_get_by_cookie(uint64_t cookie)
 	return mobj_get(&r->mobj);
 }
 
+bool mobj_reg_shm_is_live(struct mobj *mobj)
+{
+	uint32_t exceptions = 0;
+	struct mobj_reg_shm *r = NULL;
+	bool ret = false;
+
+	if (mobj->ops != &mobj_reg_shm_ops)
+		return false;
+
+	r = to_mobj_reg_shm(mobj);
+	exceptions = cpu_spin_lock_xsave(&reg_shm_slist_lock);
+	ret = !r->guarded && !r->releasing;
+	cpu_spin_unlock_xrestore(&reg_shm_slist_lock, exceptions);
+
+	return ret;
+}
+
 TEE_Result mobj_reg_shm_release_by_cookie(uint64_t cookie)
 {
 	uint32_t exceptions = 0;
@@ -402,6 +508,8 @@ TEE_Result mobj_reg_shm_release_by_cookie(uint64_t cookie)
 	if (!r)
 		return TEE_ERROR_BAD_PARAMETERS;
 
+	/* Parked TA parameter mappings must not keep the mobj alive */
+	vm_revoke_parked_param(&r->mobj);
 	mobj_put(&r->mobj);
 
 	/*
@@ -437,6 +545,14 @@ TEE_Result mobj_reg_shm_release_by_cookie(uint64_t cookie)
 	return TEE_SUCCESS;
 }
 
+void mobj_reg_shm_get_map_stats(struct mobj_reg_shm_map_stats *stats)
+{
+	uint32_t exceptions = cpu_spin_lock_xsave(&reg_shm_map_lock);
+
+	*stats = reg_shm_map_stats;
+	cpu_spin_unlock_xrestore(&reg_shm_map_lock, exceptions);
+}
+
 struct mobj *mobj_mapped_shm_alloc(paddr_t *pages, size_t num_pages,
 				  paddr_t page_offset, uint64_t cookie)
 {
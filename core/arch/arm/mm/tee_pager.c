@@ -48,12 +48,15 @@ static struct vm_paged_region_head core_vm_regions =
  * @va_alias	Virtual address where the physical page always is aliased.
  *		Used during remapping of the page when the content need to
  *		be updated before it's available at the new location.
+ * @hot		The page is in the hot part of tee_pager_pmem_head, only
+ *		used with CFG_PAGER_2Q
  */
 struct tee_pager_pmem {
 	unsigned int flags;
 	unsigned int fobj_pgidx;
 	struct fobj *fobj;
 	void *va_alias;
+	bool hot;
 	TAILQ_ENTRY(tee_pager_pmem) link;
 };
 
@@ -77,6 +80,36 @@ static struct tee_pager_pmem_head tee_pager_lock_pmem_head =
 /* Number of registered physical pages, used hiding pages. */
 static size_t tee_pager_npages;
 
+/*
+ * With CFG_PAGER_2Q tee_pager_pmem_head is split in a cold part followed
+ * by a hot part starting at pager_hot_first. Pages loaded the first time
+ * are added last in the cold part and are evicted in FIFO order, hits on
+ * them are not recorded. Pages loaded again shortly after being evicted,
+ * that is, found in pager_ghosts[], are added to the hot part which is
+ * kept in LRU order. Pages are only evicted from the hot part when the
+ * cold part has shrunk to PAGER_2Q_COLD_MIN pages, this way a single
+ * sweep over a large region cannot evict the working set.
+ *
+ * Without CFG_PAGER_2Q there is no hot part and the whole list is kept in
+ * approximated LRU order by hiding the oldest pages.
+ */
+#define PAGER_2Q_COLD_MIN	(tee_pager_npages / 4)
+
+static struct tee_pager_pmem *pager_hot_first;
+static size_t pager_hot_npages;
+
+/*
+ * Recently evicted pages. Used to detect refaults, that is, pages which
+ * have to be loaded again shortly after being evicted.
+ */
+#define PAGER_NUM_GHOSTS	64
+
+static struct pager_ghost {
+	struct fobj *fobj;
+	unsigned int fobj_pgidx;
+} pager_ghosts[PAGER_NUM_GHOSTS];
+static size_t pager_ghost_next;
+
 /* This area covers the IVs for all fobjs with paged IVs */
 static struct vm_paged_region *pager_iv_region;
 /* Used by make_iv_available(), see make_iv_available() for details. */
@@ -105,6 +138,26 @@ static inline void incr_zi_released(void)
 	pager_stats.zi_released++;
 }
 
+static inline void incr_misses(void)
+{
+	pager_stats.misses++;
+}
+
+static inline void incr_refaults(void)
+{
+	pager_stats.refaults++;
+}
+
+static inline void incr_fault_around(void)
+{
+	pager_stats.fault_around++;
+}
+
+static inline void incr_precleaned(void)
+{
+	pager_stats.precleaned++;
+}
+
 static inline void incr_npages_all(void)
 {
 	pager_stats.npages_all++;
@@ -123,6 +176,10 @@ void tee_pager_get_stats(struct tee_pager_stats *stats)
 	pager_stats.ro_hits = 0;
 	pager_stats.rw_hits = 0;
 	pager_stats.zi_released = 0;
+	pager_stats.misses = 0;
+	pager_stats.refaults = 0;
+	pager_stats.fault_around = 0;
+	pager_stats.precleaned = 0;
 }
 
 #else /* CFG_WITH_STATS */
@@ -130,6 +187,10 @@ static inline void incr_ro_hits(void) { }
 static inline void incr_rw_hits(void) { }
 static inline void incr_hidden_hits(void) { }
 static inline void incr_zi_released(void) { }
+static inline void incr_misses(void) { }
+static inline void incr_refaults(void) { }
+static inline void incr_fault_around(void) { }
+static inline void incr_precleaned(void) { }
 static inline void incr_npages_all(void) { }
 static inline void set_npages(void) { }
 
@@ -502,6 +563,90 @@ static void pmem_clear(struct tee_pager_pmem *pmem)
 	pmem->flags = 0;
 }
 
+static void pmem_list_remove(struct tee_pager_pmem *pmem)
+{
+	if (pmem == pager_hot_first)
+		pager_hot_first = TAILQ_NEXT(pmem, link);
+	if (pmem->hot) {
+		pmem->hot = false;
+		pager_hot_npages--;
+	}
+	TAILQ_REMOVE(&tee_pager_pmem_head, pmem, link);
+}
+
+/* Add @pmem as the most recently used page of the cold or hot part */
+static void pmem_list_insert(struct tee_pager_pmem *pmem, bool hot)
+{
+	if (IS_ENABLED(CFG_PAGER_2Q) && hot) {
+		TAILQ_INSERT_TAIL(&tee_pager_pmem_head, pmem, link);
+		if (!pager_hot_first)
+			pager_hot_first = pmem;
+		pmem->hot = true;
+		pager_hot_npages++;
+	} else if (pager_hot_first) {
+		TAILQ_INSERT_BEFORE(pager_hot_first, pmem, link);
+	} else {
+		TAILQ_INSERT_TAIL(&tee_pager_pmem_head, pmem, link);
+	}
+}
+
+/* Record a hit on a page found hidden */
+static void pmem_list_touch(struct tee_pager_pmem *pmem)
+{
+	bool hot = pmem->hot;
+
+	/* With 2Q the cold part is kept in FIFO order */
+	if (IS_ENABLED(CFG_PAGER_2Q) && !hot)
+		return;
+
+	pmem_list_remove(pmem);
+	pmem_list_insert(pmem, hot);
+}
+
+static struct tee_pager_pmem *pmem_list_get_victim(void)
+{
+	struct tee_pager_pmem *pmem = TAILQ_FIRST(&tee_pager_pmem_head);
+
+	/* Unused pages are always taken first */
+	if (IS_ENABLED(CFG_PAGER_2Q) && pmem && pmem->fobj &&
+	    pager_hot_first &&
+	    tee_pager_npages - pager_hot_npages <= PAGER_2Q_COLD_MIN)
+		return pager_hot_first;
+
+	return pmem;
+}
+
+static void ghost_add(struct tee_pager_pmem *pmem)
+{
+	pager_ghosts[pager_ghost_next].fobj = pmem->fobj;
+	pager_ghosts[pager_ghost_next].fobj_pgidx = pmem->fobj_pgidx;
+	pager_ghost_next = (pager_ghost_next + 1) % PAGER_NUM_GHOSTS;
+}
+
+static bool ghost_remove(struct fobj *fobj, unsigned int fobj_pgidx)
+{
+	size_t n = 0;
+
+	for (n = 0; n < PAGER_NUM_GHOSTS; n++) {
+		if (pager_ghosts[n].fobj == fobj &&
+		    pager_ghosts[n].fobj_pgidx == fobj_pgidx) {
+			pager_ghosts[n].fobj = NULL;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void ghost_remove_fobj(struct fobj *fobj)
+{
+	size_t n = 0;
+
+	for (n = 0; n < PAGER_NUM_GHOSTS; n++)
+		if (pager_ghosts[n].fobj == fobj)
+			pager_ghosts[n].fobj = NULL;
+}
+
 static void pmem_unmap(struct tee_pager_pmem *pmem, struct pgt *only_this_pgt)
 {
 	struct vm_paged_region *reg = NULL;
@@ -529,6 +674,104 @@ static void pmem_unmap(struct tee_pager_pmem *pmem, struct pgt *only_this_pgt)
 	}
 }
 
+#ifdef CFG_PAGER_ZERO_PAGE
+/*
+ * A read fault on a page of a read/write user TA region which is known to
+ * be filled with zeroes is served by mapping a shared read-only page of
+ * zeroes instead of populating a pmem. The first write to the page faults
+ * and the zero page mapping is replaced by a populated page as usual.
+ *
+ * The zero page is only mapped for pages of a fobj not held by any pmem,
+ * all zero page mappings of a page are removed when a pmem is assigned
+ * to it.
+ */
+static paddr_t pager_zero_pa;
+
+static bool is_zero_page_entry(paddr_t pa, uint32_t attr)
+{
+	return pager_zero_pa && pa == pager_zero_pa &&
+	       (attr & TEE_MATTR_VALID_BLOCK);
+}
+
+static void zero_page_clear_entry(struct tblidx tblidx)
+{
+	tblidx_set_entry(tblidx, 0, 0);
+	tblidx_tlbi_entry(tblidx);
+	pgt_dec_used_entries(tblidx.pgt);
+}
+
+static void zero_page_unmap_region(struct vm_paged_region *reg,
+				   struct pgt *only_this_pgt)
+{
+	struct tblidx tblidx = { };
+	uint32_t attr = 0;
+	paddr_t pa = 0;
+	vaddr_t va = 0;
+
+	if (!pager_zero_pa || reg->type != PAGED_REGION_TYPE_RW)
+		return;
+
+	for (va = reg->base; va < reg->base + reg->size;
+	     va += SMALL_PAGE_SIZE) {
+		tblidx = region_va2tblidx(reg, va);
+		if (!tblidx.pgt ||
+		    (only_this_pgt && tblidx.pgt != only_this_pgt))
+			continue;
+		tblidx_get_entry(tblidx, &pa, &attr);
+		if (is_zero_page_entry(pa, attr))
+			zero_page_clear_entry(tblidx);
+	}
+}
+
+static void zero_page_unmap_fobj_page(struct fobj *fobj,
+				      unsigned int fobj_pgidx)
+{
+	struct vm_paged_region *reg = NULL;
+	struct tblidx tblidx = { };
+	uint32_t attr = 0;
+	paddr_t pa = 0;
+	vaddr_t va = 0;
+
+	if (!pager_zero_pa)
+		return;
+
+	TAILQ_FOREACH(reg, &fobj->regions, fobj_link) {
+		if (fobj_pgidx < reg->fobj_pgoffs ||
+		    fobj_pgidx - reg->fobj_pgoffs >=
+		    (reg->size >> SMALL_PAGE_SHIFT))
+			continue;
+		va = reg->base +
+		     (fobj_pgidx - reg->fobj_pgoffs) * SMALL_PAGE_SIZE;
+		tblidx = region_va2tblidx(reg, va);
+		if (!tblidx.pgt)
+			continue;
+		tblidx_get_entry(tblidx, &pa, &attr);
+		if (is_zero_page_entry(pa, attr))
+			zero_page_clear_entry(tblidx);
+	}
+}
+#else
+static bool is_zero_page_entry(paddr_t pa __unused, uint32_t attr __unused)
+{
+	return false;
+}
+
+static void zero_page_clear_entry(struct tblidx tblidx __unused)
+{
+}
+
+static void __maybe_unused
+zero_page_unmap_region(struct vm_paged_region *reg __unused,
+		       struct pgt *only_this_pgt __unused)
+{
+}
+
+static void zero_page_unmap_fobj_page(struct fobj *fobj __unused,
+				      unsigned int fobj_pgidx __unused)
+{
+}
+#endif /*CFG_PAGER_ZERO_PAGE*/
+
 void tee_pager_early_init(void)
 {
 	size_t n = 0;
@@ -1036,6 +1279,7 @@ static void rem_region(struct vm_paged_region_head *regions,
 		tblidx_tlbi_entry(tblidx);
 		pgt_dec_used_entries(tblidx.pgt);
 	}
+	zero_page_unmap_region(reg, NULL);
 
 	pager_unlock(exceptions);
 }
@@ -1124,6 +1368,9 @@ bool tee_pager_set_um_region_attr(struct user_mode_ctx *uctx, vaddr_t base,
 		if (reg->flags == f)
 			goto next_region;
 
+		/* Mapped again with the new attributes on next read */
+		zero_page_unmap_region(reg, NULL);
+
 		TAILQ_FOREACH(pmem, &tee_pager_pmem_head, link) {
 			if (!pmem_is_covered_by_region(pmem, reg))
 				continue;
@@ -1190,6 +1437,7 @@ void tee_pager_invalidate_fobj(struct fobj *fobj)
 	TAILQ_FOREACH(pmem, &tee_pager_pmem_head, link)
 		if (pmem->fobj == fobj)
 			pmem_clear(pmem);
+	ghost_remove_fobj(fobj);
 
 	pager_unlock(exceptions);
 }
@@ -1275,19 +1523,25 @@ static bool tee_pager_unhide_page(struct vm_paged_region *reg, vaddr_t page_va)
 	}
 	pgt_inc_used_entries(tblidx.pgt);
 
-	TAILQ_REMOVE(&tee_pager_pmem_head, pmem, link);
-	TAILQ_INSERT_TAIL(&tee_pager_pmem_head, pmem, link);
+	pmem_list_touch(pmem);
 	incr_hidden_hits();
 	return true;
 }
 
 static void tee_pager_hide_pages(void)
 {
-	struct tee_pager_pmem *pmem = NULL;
+	struct tee_pager_pmem *pmem = TAILQ_FIRST(&tee_pager_pmem_head);
+	size_t nhide = TEE_PAGER_NHIDE;
 	size_t n = 0;
 
-	TAILQ_FOREACH(pmem, &tee_pager_pmem_head, link) {
-		if (n >= TEE_PAGER_NHIDE)
+	/* With 2Q only hits in the hot part are of interest */
+	if (IS_ENABLED(CFG_PAGER_2Q)) {
+		pmem = pager_hot_first;
+		nhide = pager_hot_npages / 3;
+	}
+
+	for (; pmem; pmem = TAILQ_NEXT(pmem, link)) {
+		if (n >= nhide)
 			break;
 		n++;
 
@@ -1369,6 +1623,11 @@ static void pager_deploy_page(struct tee_pager_pmem *pmem,
 	unsigned int idx_alias = 0;
 	uint32_t attr_alias = 0;
 	paddr_t pa_alias = 0;
+	bool refault = ghost_remove(pmem->fobj, pmem->fobj_pgidx);
+
+	incr_misses();
+	if (refault)
+		incr_refaults();
 
 	/* Ensure we are allowed to write to aliased virtual page */
 	ti = find_table_info((vaddr_t)va_alias);
@@ -1387,7 +1646,7 @@ static void pager_deploy_page(struct tee_pager_pmem *pmem,
 	}
 	switch (reg->type) {
 	case PAGED_REGION_TYPE_RO:
-		TAILQ_INSERT_TAIL(&tee_pager_pmem_head, pmem, link);
+		pmem_list_insert(pmem, refault);
 		incr_ro_hits();
 		/* Forbid write to aliases for read-only (maybe exec) pages */
 		attr_alias &= ~TEE_MATTR_PW;
@@ -1395,7 +1654,7 @@ static void pager_deploy_page(struct tee_pager_pmem *pmem,
 		tlbi_va_allasid((vaddr_t)va_alias);
 		break;
 	case PAGED_REGION_TYPE_RW:
-		TAILQ_INSERT_TAIL(&tee_pager_pmem_head, pmem, link);
+		pmem_list_insert(pmem, refault);
 		if (writable && (attr & (TEE_MATTR_PW | TEE_MATTR_UW)))
 			pmem->flags |= PMEM_FLAG_DIRTY;
 		incr_rw_hits();
@@ -1545,6 +1804,76 @@ static void make_iv_available(struct fobj *fobj, unsigned int fobj_pgidx,
 	}
 }
 
+/*
+ * An IV is only used outside of pager_get_page() if its page is resident,
+ * loading it could consume pager_spare_pmem which can only be replaced
+ * by evicting another page.
+ */
+static bool iv_is_resident(struct fobj *fobj, unsigned int fobj_pgidx)
+{
+	vaddr_t page_va = fobj_get_iv_vaddr(fobj, fobj_pgidx) &
+			  ~SMALL_PAGE_MASK;
+
+	if (!IS_ENABLED(CFG_CORE_PAGE_TAG_AND_IV) || !page_va)
+		return true;
+
+	return pmem_find(pager_iv_region, page_va);
+}
+
+#ifdef CFG_PAGER_ZERO_PAGE
+static bool pager_map_zero_page(struct vm_paged_region *reg,
+				struct abort_info *ai)
+{
+	vaddr_t page_va = ai->va & ~SMALL_PAGE_MASK;
+	struct tblidx tblidx = region_va2tblidx(reg, page_va);
+	unsigned int fobj_pgidx = 0;
+	tee_mm_entry_t *mm = NULL;
+	uint32_t attr = 0;
+	void *va = NULL;
+
+	if (reg->type != PAGED_REGION_TYPE_RW || abort_is_write_fault(ai) ||
+	    (reg->flags & (TEE_MATTR_PX | TEE_MATTR_UX)))
+		return false;
+
+	fobj_pgidx = (page_va - reg->base) / SMALL_PAGE_SIZE +
+		     reg->fobj_pgoffs;
+	if (!iv_is_resident(reg->fobj, fobj_pgidx))
+		return false;
+	make_iv_available(reg->fobj, fobj_pgidx, false /*!writable*/);
+	if (!fobj_page_is_zero(reg->fobj, fobj_pgidx))
+		return false;
+
+	if (!pager_zero_pa) {
+		mm = tee_mm_alloc(&tee_mm_sec_ddr, SMALL_PAGE_SIZE);
+		if (!mm)
+			return false;
+		va = phys_to_virt(tee_mm_get_smem(mm), MEM_AREA_TA_RAM,
+				  SMALL_PAGE_SIZE);
+		assert(va);
+		memset(va, 0, SMALL_PAGE_SIZE);
+		pager_zero_pa = tee_mm_get_smem(mm);
+	}
+
+	attr = get_region_mattr(reg->flags) & ~(TEE_MATTR_PW | TEE_MATTR_UW);
+	tblidx_set_entry(tblidx, pager_zero_pa, attr);
+	/*
+	 * No need to flush TLB for this entry, it was invalid. We should
+	 * use a barrier though, to make sure that the change is visible.
+	 */
+	dsb_ishst();
+	pgt_inc_used_entries(tblidx.pgt);
+
+	FMSG("Mapped 0x%" PRIxVA " -> zero page", page_va);
+	return true;
+}
+#else
+static bool pager_map_zero_page(struct vm_paged_region *reg __unused,
+				struct abort_info *ai __unused)
+{
+	return false;
+}
+#endif /*CFG_PAGER_ZERO_PAGE*/
+
 static void pager_get_page(struct vm_paged_region *reg, struct abort_info *ai,
 			   bool clean_user_cache)
 {
@@ -1559,7 +1888,7 @@ static void pager_get_page(struct vm_paged_region *reg, struct abort_info *ai,
 	 * the corresponding IV page is available.
 	 */
 	while (true) {
-		pmem = TAILQ_FIRST(&tee_pager_pmem_head);
+		pmem = pmem_list_get_victim();
 		if (!pmem) {
 			EMSG("No pmem entries");
 			abort_print(ai);
@@ -1567,6 +1896,7 @@ static void pager_get_page(struct vm_paged_region *reg, struct abort_info *ai,
 		}
 
 		if (pmem->fobj) {
+			ghost_add(pmem);
 			pmem_unmap(pmem, NULL);
 			if (pmem_is_dirty(pmem)) {
 				uint8_t *va = pmem->va_alias;
@@ -1590,8 +1920,7 @@ static void pager_get_page(struct vm_paged_region *reg, struct abort_info *ai,
 				 */
 				if (IS_ENABLED(CFG_CORE_PAGE_TAG_AND_IV) &&
 				    !pager_spare_pmem) {
-					TAILQ_REMOVE(&tee_pager_pmem_head,
-						     pmem, link);
+					pmem_list_remove(pmem);
 					pager_spare_pmem = pmem;
 					pmem = NULL;
 				}
@@ -1616,7 +1945,7 @@ static void pager_get_page(struct vm_paged_region *reg, struct abort_info *ai,
 			}
 		}
 
-		TAILQ_REMOVE(&tee_pager_pmem_head, pmem, link);
+		pmem_list_remove(pmem);
 		pmem_clear(pmem);
 
 		pmem_assign_fobj_page(pmem, reg, page_va);
@@ -1650,9 +1979,68 @@ static void pager_get_page(struct vm_paged_region *reg, struct abort_info *ai,
 	else
 		writable = false;
 
+	zero_page_unmap_fobj_page(pmem->fobj, pmem->fobj_pgidx);
 	pager_deploy_page(pmem, reg, page_va, clean_user_cache, writable);
 }
 
+/*
+ * Read-ahead of read-only pages. After a fault on a read-only page up to
+ * pager_fa_npages following pages of the region are loaded too, as long
+ * as there are unused physical pages. The window is doubled, up to
+ * CFG_PAGER_FAULT_AROUND pages, each time a fault hits the page just
+ * after the previous window and halved otherwise.
+ */
+static vaddr_t pager_fa_next_va;
+static size_t pager_fa_npages;
+
+static void pager_fault_around(struct vm_paged_region *reg, vaddr_t page_va,
+			       bool clean_user_cache)
+{
+	struct tee_pager_pmem *pmem = NULL;
+	struct tblidx tblidx = { };
+	vaddr_t end = reg->base + reg->size;
+	vaddr_t va = 0;
+	uint32_t attr = 0;
+
+	if (!CFG_PAGER_FAULT_AROUND)
+		return;
+
+	if (page_va != pager_fa_next_va)
+		pager_fa_npages /= 2;
+	else if (!pager_fa_npages)
+		pager_fa_npages = 1;
+	else
+		pager_fa_npages = MIN(pager_fa_npages * 2,
+				      (size_t)CFG_PAGER_FAULT_AROUND);
+
+	if (end - page_va > (pager_fa_npages + 1) * SMALL_PAGE_SIZE)
+		end = page_va + (pager_fa_npages + 1) * SMALL_PAGE_SIZE;
+	pager_fa_next_va = end;
+
+	for (va = page_va + SMALL_PAGE_SIZE; va < end; va += SMALL_PAGE_SIZE) {
+		/* Only unused pages are taken, nothing is evicted */
+		pmem = TAILQ_FIRST(&tee_pager_pmem_head);
+		if (!pmem || pmem->fobj)
+			break;
+
+		tblidx = region_va2tblidx(reg, va);
+		if (!tblidx.pgt)
+			break;
+		tblidx_get_entry(tblidx, NULL, &attr);
+		if ((attr & TEE_MATTR_VALID_BLOCK) || pmem_find(reg, va))
+			continue;
+
+		pmem_list_remove(pmem);
+		pmem_assign_fobj_page(pmem, reg, va);
+		/* Read-only pages have no IV so the spare pmem isn't used */
+		make_iv_available(pmem->fobj, pmem->fobj_pgidx,
+				  false /*!writable*/);
+		pager_deploy_page(pmem, reg, va, clean_user_cache,
+				  false /*!writable*/);
+		incr_fault_around();
+	}
+}
+
 static bool pager_update_permissions(struct vm_paged_region *reg,
 				     struct abort_info *ai, bool *handled)
 {
@@ -1700,8 +2088,18 @@ static bool pager_update_permissions(struct vm_paged_region *reg,
 	case CORE_MMU_FAULT_WRITE_PERMISSION:
 		/* Check attempting to write to an RO page */
 		pmem = pmem_find(reg, ai->va);
-		if (!pmem)
-			panic();
+		if (!pmem) {
+			if (!is_zero_page_entry(pa, attr))
+				panic();
+			if (!(reg->flags & (TEE_MATTR_UW | TEE_MATTR_PW)))
+				return true;
+			/*
+			 * First write to a page mapped with the zero page,
+			 * remove the mapping to have the page populated.
+			 */
+			zero_page_clear_entry(tblidx);
+			return false;
+		}
 		if (abort_is_user_exception(ai)) {
 			if (!(reg->flags & TEE_MATTR_UW))
 				return true;
@@ -1813,7 +2211,13 @@ bool tee_pager_handle_fault(struct abort_info *ai)
 		goto out;
 	}
 
+	/* The zero page is only mapped in user TA regions */
+	if (clean_user_cache && pager_map_zero_page(reg, ai))
+		goto out_success;
+
 	pager_get_page(reg, ai, clean_user_cache);
+	if (reg->type == PAGED_REGION_TYPE_RO)
+		pager_fault_around(reg, page_va, clean_user_cache);
 
 out_success:
 	tee_pager_hide_pages();
@@ -1823,6 +2227,121 @@ out:
 	return ret;
 }
 
+/*
+ * Iterates over the pages in the order they will be evicted, see
+ * pmem_list_get_victim(). With 2Q the cold part is evicted until it has
+ * shrunk to PAGER_2Q_COLD_MIN pages, the hot part after that.
+ */
+static struct tee_pager_pmem *preclean_first(size_t *cold_left)
+{
+	size_t ncold = tee_pager_npages - pager_hot_npages;
+
+	if (!IS_ENABLED(CFG_PAGER_2Q) || !pager_hot_first) {
+		*cold_left = tee_pager_npages;
+		return TAILQ_FIRST(&tee_pager_pmem_head);
+	}
+
+	if (ncold <= PAGER_2Q_COLD_MIN) {
+		*cold_left = 0;
+		return pager_hot_first;
+	}
+
+	*cold_left = ncold - PAGER_2Q_COLD_MIN;
+	return TAILQ_FIRST(&tee_pager_pmem_head);
+}
+
+static struct tee_pager_pmem *preclean_next(struct tee_pager_pmem *pmem,
+					    size_t *cold_left)
+{
+	if (*cold_left) {
+		(*cold_left)--;
+		if (!*cold_left)
+			return pager_hot_first;
+	}
+
+	return TAILQ_NEXT(pmem, link);
+}
+
+/*
+ * Returns true if fewer than CFG_PAGER_PRECLEAN_WATERMARK pages can be
+ * taken without saving them: unused pages, which are always taken first,
+ * and clean pages among the next ones to be evicted.
+ */
+static bool preclean_is_needed(void)
+{
+	struct tee_pager_pmem *pmem = NULL;
+	size_t cold_left = 0;
+	size_t navail = 0;
+	size_t n = 0;
+
+	TAILQ_FOREACH(pmem, &tee_pager_pmem_head, link)
+		if (!pmem->fobj)
+			navail++;
+
+	for (pmem = preclean_first(&cold_left); pmem && n < TEE_PAGER_NHIDE;
+	     pmem = preclean_next(pmem, &cold_left), n++) {
+		if (navail >= CFG_PAGER_PRECLEAN_WATERMARK)
+			break;
+		if (pmem->fobj && !pmem_is_dirty(pmem))
+			navail++;
+	}
+
+	return navail < CFG_PAGER_PRECLEAN_WATERMARK;
+}
+
+void tee_pager_preclean(void)
+{
+	struct tee_pager_pmem *pmem = NULL;
+	uint32_t exceptions = 0;
+	size_t cold_left = 0;
+	size_t nclean = 0;
+	size_t n = 0;
+	uint8_t *va = NULL;
+
+	if (!CFG_PAGER_PRECLEAN)
+		return;
+
+	exceptions = pager_lock_check_stack(SMALL_PAGE_SIZE);
+
+	if (!preclean_is_needed())
+		goto out;
+
+	/*
+	 * A dirty page is hidden before it's saved so that a later write
+	 * will fault and mark the page dirty again.
+	 */
+	for (pmem = preclean_first(&cold_left);
+	     pmem && n < TEE_PAGER_NHIDE;
+	     pmem = preclean_next(pmem, &cold_left), n++) {
+		if (!pmem->fobj || !pmem_is_dirty(pmem))
+			continue;
+		if (!iv_is_resident(pmem->fobj, pmem->fobj_pgidx))
+			continue;
+
+		if (!pmem_is_hidden(pmem)) {
+			pmem->flags |= PMEM_FLAG_HIDDEN;
+			pmem_unmap(pmem, NULL);
+		}
+
+		make_iv_available(pmem->fobj, pmem->fobj_pgidx,
+				  true /*writable*/);
+		va = pmem->va_alias;
+		asan_tag_access(va, va + SMALL_PAGE_SIZE);
+		if (fobj_save_page(pmem->fobj, pmem->fobj_pgidx, va))
+			panic("fobj_save_page");
+		asan_tag_no_access(va, va + SMALL_PAGE_SIZE);
+
+		pmem->flags &= ~PMEM_FLAG_DIRTY;
+		incr_precleaned();
+		nclean++;
+		if (nclean == CFG_PAGER_PRECLEAN)
+			break;
+	}
+
+out:
+	pager_unlock(exceptions);
+}
+
 void tee_pager_add_pages(vaddr_t vaddr, size_t npages, bool unmap)
 {
 	size_t n = 0;
@@ -1886,7 +2405,7 @@ void tee_pager_add_pages(vaddr_t vaddr, size_t npages, bool unmap)
 			tee_pager_npages++;
 			incr_npages_all();
 			set_npages();
-			TAILQ_INSERT_TAIL(&tee_pager_pmem_head, pmem, link);
+			pmem_list_insert(pmem, false);
 		}
 	}
 
@@ -1945,12 +2464,14 @@ void tee_pager_pgt_save_and_release_entries(struct pgt *pgt)
 		if (pmem->fobj)
 			pmem_unmap(pmem, pgt);
 	}
-	assert(!pgt->num_used_entries);
 
 out:
 	regions = to_user_mode_ctx(pgt->ctx)->regions;
 	if (regions) {
 		TAILQ_FOREACH(reg, regions, link) {
+			if (pgt->num_used_entries &&
+			    region_have_pgt(reg, pgt))
+				zero_page_unmap_region(reg, pgt);
 			for (n = 0; n < get_pgt_count(reg->base, reg->size);
 			     n++) {
 				if (reg->pgt_array[n] == pgt) {
@@ -1960,6 +2481,7 @@ out:
 			}
 		}
 	}
+	assert(!pgt->num_used_entries);
 
 	pager_unlock(exceptions);
 }
@@ -116,6 +116,14 @@ static void tee_entry_exchange_capabilities(struct thread_smc_args *args)
 
 	args->a1 |= OPTEE_SMC_SEC_CAP_RPC_ARG;
 	args->a3 = THREAD_RPC_MAX_NUM_PARAMS;
+
+	if (thread_get_avail_notif_value()) {
+		args->a1 |= OPTEE_SMC_SEC_CAP_THREAD_AVAIL_NOTIF;
+		args->a4 = thread_get_avail_notif_value();
+	}
+
+	if (IS_ENABLED(CFG_CORE_MSG_RING))
+		args->a1 |= OPTEE_SMC_SEC_CAP_MSG_RING;
 }
 
 static void tee_entry_disable_shm_cache(struct thread_smc_args *args)
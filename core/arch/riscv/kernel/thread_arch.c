@@ -309,24 +309,12 @@ static void __thread_alloc_and_run(uint32_t a0, uint32_t a1, uint32_t a2,
 				   void *pc)
 {
 	struct thread_core_local *l = thread_get_core_local();
-	bool found_thread = false;
-	size_t n = 0;
+	int n = THREAD_ID_INVALID;
 
 	assert(l->curr_thread == THREAD_ID_INVALID);
 
-	thread_lock_global();
-
-	for (n = 0; n < CFG_NUM_THREADS; n++) {
-		if (threads[n].state == THREAD_STATE_FREE) {
-			threads[n].state = THREAD_STATE_ACTIVE;
-			found_thread = true;
-			break;
-		}
-	}
-
-	thread_unlock_global();
-
-	if (!found_thread)
+	n = thread_claim_free_ctx();
+	if (n == THREAD_ID_INVALID)
 		return;
 
 	l->curr_thread = n;
@@ -467,9 +455,7 @@ void thread_state_free(void)
 
 	thread_lock_global();
 
-	assert(threads[ct].state == THREAD_STATE_ACTIVE);
-	threads[ct].state = THREAD_STATE_FREE;
-	threads[ct].flags = 0;
+	thread_release_ctx(ct);
 	l->curr_thread = THREAD_ID_INVALID;
 
 	if (IS_ENABLED(CFG_NS_VIRTUALIZATION))
@@ -59,6 +59,12 @@ ifneq (y,$(call cfg-one-enabled,CFG_RISCV_M_MODE M CFG_RISCV_S_MODE))
 $(error Either CFG_RISCV_M_MODE or CFG_RISCV_S_MODE must be 'y')
 endif
 
+# libutee finds the state of each entry of a concurrent TA with the Arm
+# thread pointer register
+ifeq ($(CFG_CONCURRENT_USER_TA),y)
+$(error CFG_CONCURRENT_USER_TA is not supported on RISC-V)
+endif
+
 ifeq ($(CFG_RISCV_SBI_CONSOLE),y)
 $(call force,CFG_RISCV_SBI,y)
 endif
@@ -9,12 +9,21 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+/*
+ * struct handle_db - handle database
+ * @ptrs:	Array of pointers, indexed by handle
+ * @max_ptrs:	Number of elements in @ptrs
+ * @first_free:	All handles below this are in use
+ * @next:	Where handle_get_next() starts looking for a free handle
+ */
 struct handle_db {
 	void **ptrs;
 	size_t max_ptrs;
+	size_t first_free;
+	size_t next;
 };
 
-#define HANDLE_DB_INITIALIZER { NULL, 0 }
+#define HANDLE_DB_INITIALIZER { NULL, 0, 0, 0 }
 
 /*
  * Frees all internal data structures of the database, but does not free
@@ -36,6 +45,14 @@ bool handle_db_is_empty(struct handle_db *db);
  */
 int handle_get(struct handle_db *db, void *ptr);
 
+/*
+ * Same as handle_get() except that the search for a free handle starts
+ * after the handle allocated last by this function and wraps around, so
+ * a released handle isn't handed out again until the other free handles
+ * have been used.
+ */
+int handle_get_next(struct handle_db *db, void *ptr);
+
 /*
  * Deallocates a handle. Returns the assiciated pointer of the handle
  * if the handle was valid or NULL if it's invalid.
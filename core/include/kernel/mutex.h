@@ -14,6 +14,7 @@ struct mutex {
 	unsigned spin_lock;	/* used when operating on this struct */
 	struct wait_queue wq;
 	short state;		/* -1: write, 0: unlocked, > 0: readers */
+	short owner;		/* thread holding the write lock if state -1 */
 };
 
 #define MUTEX_INITIALIZER { .wq = WAIT_QUEUE_INITIALIZER }
@@ -29,6 +30,22 @@ struct recursive_mutex {
 
 TAILQ_HEAD(mutex_head, mutex);
 
+/*
+ * struct mutex_stats - statistics of contended mutexes
+ * @spin_acquired: Number of times a contended mutex was acquired while
+ *		   spinning
+ * @sleeps:	   Number of times a thread waited in normal world for a
+ *		   contended mutex
+ */
+struct mutex_stats {
+	uint32_t spin_acquired;
+	uint32_t sleeps;
+};
+
+#ifdef CFG_WITH_STATS
+void mutex_get_stats(struct mutex_stats *stats);
+#endif
+
 void mutex_init(struct mutex *m);
 void mutex_destroy(struct mutex *m);
 
@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2026, Analog Devices, Inc.
+ */
+#ifndef __KERNEL_RWLOCK_H
+#define __KERNEL_RWLOCK_H
+
+#include <kernel/mutex.h>
+#include <types_ext.h>
+#include <util.h>
+
+/*
+ * Reader-writer lock optimized for data which is read much more often
+ * than it is updated.
+ *
+ * Each core has its own reader count on a separate cache line so taking
+ * and releasing a read lock only touches memory local to the core as
+ * long as there's no writer. A thread may be rescheduled on another core
+ * while holding a read lock, so a single count may go negative, only the
+ * sum of all the counts is the number of readers.
+ *
+ * A writer first blocks new readers and then waits for the readers
+ * holding the lock to release it, this makes taking the write lock
+ * considerably more expensive than taking a mutex. Readers and writers
+ * may both sleep while holding the lock.
+ */
+struct rwlock_count {
+	int count;
+} __aligned(BIT(CFG_MAX_CACHE_LINE_SHIFT));
+
+struct rwlock {
+	struct rwlock_count readers[CFG_TEE_CORE_NB_CORE];
+	unsigned int writer;	/* 1 if a writer holds or waits for the lock */
+	struct mutex m;		/* serializes writers and blocked readers */
+	struct condvar cv;
+};
+
+#define RWLOCK_INITIALIZER { .m = MUTEX_INITIALIZER, \
+			     .cv = CONDVAR_INITIALIZER }
+
+void rwlock_init(struct rwlock *l);
+void rwlock_destroy(struct rwlock *l);
+
+void rwlock_read_lock(struct rwlock *l);
+void rwlock_read_unlock(struct rwlock *l);
+void rwlock_write_lock(struct rwlock *l);
+void rwlock_write_unlock(struct rwlock *l);
+
+#endif /*__KERNEL_RWLOCK_H*/
@@ -38,6 +38,7 @@ struct param_mem {
 	struct mobj *mobj;
 	size_t size;
 	size_t offs;
+	bool readonly; /* Mapped read-only in a called user TA */
 };
 
 struct tee_ta_param {
@@ -68,6 +69,7 @@ struct sample_buf {
 struct tee_ta_ctx {
 	uint32_t flags;		/* TA_FLAGS from TA header */
 	TAILQ_ENTRY(tee_ta_ctx) link;
+	LIST_ENTRY(tee_ta_ctx) uuid_link; /* Link in UUID hash bucket */
 	struct ts_ctx ts_ctx;
 	uint32_t panicked;	/* True if TA has panicked, written from asm */
 	uint32_t panic_code;	/* Code supplied for panic */
@@ -79,6 +81,8 @@ struct tee_ta_ctx {
 
 struct tee_ta_session {
 	TAILQ_ENTRY(tee_ta_session) link;
+	/* List of sessions this session is linked into */
+	struct tee_ta_session_head *open_sessions;
 	struct ts_session ts_sess;
 	uint32_t id;		/* Session handle (0 is invalid) */
 	TEE_Identity clnt_id;	/* Identify of client */
@@ -97,6 +101,13 @@ struct tee_ta_session {
 /* Registered contexts */
 extern struct tee_ta_ctx_head tee_ctxes;
 
+/*
+ * Adds @ctx to or removes it from tee_ctxes and the index used to find
+ * a context by UUID. Called with tee_ta_mutex held.
+ */
+void tee_ta_register_ctx(struct tee_ta_ctx *ctx);
+void tee_ta_unregister_ctx(struct tee_ta_ctx *ctx);
+
 extern struct mutex tee_ta_mutex;
 extern struct condvar tee_ta_init_cv;
 
@@ -131,6 +142,16 @@ TEE_Result tee_ta_close_session(struct tee_ta_session *sess,
 				struct tee_ta_session_head *open_sessions,
 				const TEE_Identity *clnt_id);
 
+/*
+ * Same as tee_ta_close_session() but the session is looked up by @id,
+ * for callers which don't hold a reference to the session. Returns
+ * TEE_ERROR_ITEM_NOT_FOUND if there's no such session in @open_sessions,
+ * for instance because another thread has already closed it.
+ */
+TEE_Result tee_ta_close_session_id(uint32_t id,
+				   struct tee_ta_session_head *open_sessions,
+				   const TEE_Identity *clnt_id);
+
 
 
 struct tee_ta_session *tee_ta_find_session(uint32_t id,
@@ -18,4 +18,11 @@ void tee_time_wait(uint32_t milliseconds_delay);
 /* Busy wait */
 void tee_time_busy_wait(uint32_t milliseconds_delay);
 
+struct mobj;
+/*
+ * Returns the mobj and offset of the page with struct utee_time_page or
+ * false if system time can't be computed in user mode.
+ */
+bool tee_time_get_user_page(struct mobj **mobj, size_t *offset);
+
 #endif
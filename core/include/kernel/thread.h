@@ -68,6 +68,13 @@ struct thread_core_local *thread_get_core_local(void);
  */
 bool thread_init_stack(uint32_t stack_id, vaddr_t sp);
 
+/*
+ * Returns the asynchronous notification value sent to normal world when a
+ * thread becomes free after a call was refused since all threads were
+ * busy, or 0 if there's no such notification.
+ */
+uint32_t thread_get_avail_notif_value(void);
+
 /*
  * Initializes thread contexts. Called in thread_init_boot_thread() if
  * virtualization is disabled. Virtualization subsystem calls it for
@@ -32,6 +32,22 @@ struct thread_shm_cache_entry {
 
 SLIST_HEAD(thread_shm_cache, thread_shm_cache_entry);
 
+/*
+ * Number of size classes in the RPC payload cache, class n holds a buffer
+ * of at least SMALL_PAGE_SIZE << n bytes.
+ */
+#define THREAD_RPC_PAYLOAD_NUM_CLASSES	4
+
+/*
+ * struct thread_rpc_payload_cache - payload buffers kept by a thread
+ * @appl:	OPTEE_RPC_SHM_TYPE_APPL buffers, one per size class
+ * @kernel:	OPTEE_RPC_SHM_TYPE_KERNEL buffers, one per size class
+ */
+struct thread_rpc_payload_cache {
+	struct mobj *appl[THREAD_RPC_PAYLOAD_NUM_CLASSES];
+	struct mobj *kernel[THREAD_RPC_PAYLOAD_NUM_CLASSES];
+};
+
 struct thread_ctx {
 	struct thread_ctx_regs regs;
 	enum thread_state state;
@@ -51,7 +67,11 @@ struct thread_ctx {
 	void *rpc_arg;
 	struct mobj *rpc_mobj;
 	struct thread_shm_cache shm_cache;
+	struct thread_rpc_payload_cache payload_cache;
 	struct thread_specific_data tsd;
+#ifdef CFG_DYN_THREAD_STACKS
+	uint64_t idle_timeout;	/* When the stack may be freed if unused */
+#endif
 };
 #endif /*__ASSEMBLER__*/
 
@@ -87,6 +107,20 @@ void thread_check_canaries(void);
 void thread_lock_global(void);
 void thread_unlock_global(void);
 
+/*
+ * Claims a free thread context and marks it active. With
+ * CFG_DYN_THREAD_STACKS a kernel stack is allocated if needed. Returns
+ * the thread ID or THREAD_ID_INVALID if no thread could be claimed.
+ */
+int thread_claim_free_ctx(void);
+
+/*
+ * Marks thread context @ct as free again, called with the global thread
+ * lock held. Notifies normal world if a caller has been turned away
+ * because no thread was free.
+ */
+void thread_release_ctx(int ct);
+
 /* Frees the cache of allocated FS RPC memory */
 void thread_rpc_shm_cache_clear(struct thread_shm_cache *cache);
 #endif /*__ASSEMBLER__*/
@@ -9,6 +9,8 @@ struct time_source {
 	const char *name;
 	uint32_t protection_level;
 	TEE_Result (*get_sys_time)(TEE_Time *time);
+	/* Time is the counter divided by its frequency, readable by TAs */
+	bool user_counter;
 };
 void time_source_init(void);
 
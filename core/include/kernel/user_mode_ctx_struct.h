@@ -16,6 +16,8 @@
  * @vm_info:		Virtual memory map of this context
  * @regions:		Memory regions registered by pager
  * @vfp:		State of VFP registers
+ * @thread_vfp:		State of VFP registers per thread, used instead of
+ *			@vfp when several threads may execute in the context
  * @keys:		Pointer authentication keys
  * @ts_ctx:		Generic TS context
  * @entry_func:		Entry address in TS
@@ -28,9 +30,16 @@
  * @is_32bit:		True if 32-bit TS, false if 64-bit TS
  * @is_initializing:	True if TS is not fully loaded
  * @stack_ptr:		Stack pointer
+ * @stack_size:		Size of the stack
  * @bbuf:		Bounce buffer for user buffers
  * @bbuf_size:		Size of bounce buffer
  * @bbuf_offs:		Offset to unused part of bounce buffer
+ * @thread_bbuf_offs:	Offset to unused part of bounce buffer per thread,
+ *			when set @bbuf holds CFG_NUM_THREADS bounce buffers
+ *			of @bbuf_size each, one for each thread
+ * @parked_param:	Memref parameter mappings kept from the last entry
+ * @parked_link:	Link in the list of contexts with parked mappings
+ * @time_page_va:	User address of struct utee_time_page or 0
  */
 struct user_mode_ctx {
 	struct vm_info vm_info;
@@ -38,6 +47,9 @@ struct user_mode_ctx {
 	struct pgt_cache pgt_cache;
 #if defined(CFG_WITH_VFP)
 	struct thread_user_vfp_state vfp;
+#if defined(CFG_CONCURRENT_USER_TA)
+	struct thread_user_vfp_state *thread_vfp;
+#endif
 #endif
 #if defined(CFG_TA_PAUTH)
 	struct thread_pauth_keys keys;
@@ -54,9 +66,33 @@ struct user_mode_ctx {
 	bool is_32bit;
 	bool is_initializing;
 	vaddr_t stack_ptr;
+	size_t stack_size;
 	uint8_t *bbuf;
 	size_t bbuf_size;
 	size_t bbuf_offs;
+#if defined(CFG_CONCURRENT_USER_TA)
+	size_t *thread_bbuf_offs;
+#endif
+#if defined(CFG_TA_PARAM_MAP_CACHE)
+	struct vm_region *parked_param[TEE_NUM_PARAMS];
+	SLIST_ENTRY(user_mode_ctx) parked_link;
+#endif
+#if defined(CFG_TA_TIME_PAGE)
+	uaddr_t time_page_va;
+#endif
 };
+
+#if defined(CFG_WITH_VFP)
+/* Returns the state of the VFP registers of the calling thread in @uctx */
+static inline struct thread_user_vfp_state *
+user_mode_ctx_get_vfp(struct user_mode_ctx *uctx)
+{
+#if defined(CFG_CONCURRENT_USER_TA)
+	if (uctx->thread_vfp)
+		return uctx->thread_vfp + thread_get_id();
+#endif
+	return &uctx->vfp;
+}
+#endif
 #endif /*__KERNEL_USER_MODE_CTX_STRUCT_H*/
 
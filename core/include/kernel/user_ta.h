@@ -7,6 +7,7 @@
 #define KERNEL_USER_TA_H
 
 #include <assert.h>
+#include <kernel/rwlock.h>
 #include <kernel/tee_ta_manager.h>
 #include <kernel/user_mode_ctx_struct.h>
 #include <kernel/thread.h>
@@ -22,6 +23,23 @@ TAILQ_HEAD(tee_obj_head, tee_obj);
 TAILQ_HEAD(tee_storage_enum_head, tee_storage_enum);
 SLIST_HEAD(load_seg_head, load_seg);
 
+#ifdef CFG_CONCURRENT_USER_TA
+/*
+ * struct user_ta_stack - additional stack of a concurrent user TA
+ * @top:	Initial stack pointer, the stack is uctx.stack_size bytes
+ * @link:	Link in the list of free stacks
+ */
+struct user_ta_stack {
+	vaddr_t top;
+	SLIST_ENTRY(user_ta_stack) link;
+};
+
+SLIST_HEAD(user_ta_stack_head, user_ta_stack);
+
+struct user_ta_lock_waiter;
+TAILQ_HEAD(user_ta_lock_waiter_head, user_ta_lock_waiter);
+#endif
+
 /*
  * struct user_ta_ctx - user TA context
  * @open_sessions:	List of sessions opened by this TA
@@ -31,6 +49,23 @@ SLIST_HEAD(load_seg_head, load_seg);
  * @ta_time_offs:	Time reference used by the TA
  * @uctx:		Generic user mode context
  * @ctx:		Generic TA context
+ *
+ * Only with CFG_CONCURRENT_USER_TA, used if TA_FLAG_CONCURRENT is set:
+ * @vm_lock:		Protects the address space in uctx, including the
+ *			parameter mappings. Held shared by system calls and
+ *			exclusively while the address space is changed.
+ * @vm_lock_thread:	Thread holding @vm_lock exclusively or
+ *			THREAD_ID_INVALID
+ * @obj_lock:		Protects @cryp_states, @objects, @storage_enums and
+ *			@ta_time_offs
+ * @lock:		Protects the fields below
+ * @lock_thread:	Thread currently holding @lock or THREAD_ID_INVALID
+ * @entry_count:	Number of threads executing in the TA
+ * @entry_cv:		Signalled when @entry_count drops to 0
+ * @free_stacks:	Additional stacks not currently in use
+ * @stack_in_use:	True if the stack at uctx.stack_ptr is in use
+ * @lock_wait_mu:	Protects @lock_waiters
+ * @lock_waiters:	Threads sleeping in user_ta_lock_wait()
  */
 struct user_ta_ctx {
 	struct tee_ta_session_head open_sessions;
@@ -40,6 +75,19 @@ struct user_ta_ctx {
 	void *ta_time_offs;
 	struct user_mode_ctx uctx;
 	struct tee_ta_ctx ta_ctx;
+#ifdef CFG_CONCURRENT_USER_TA
+	struct rwlock vm_lock;
+	short int vm_lock_thread;
+	struct mutex obj_lock;
+	struct mutex lock;
+	short int lock_thread;
+	unsigned int entry_count;
+	struct condvar entry_cv;
+	struct user_ta_stack_head free_stacks;
+	bool stack_in_use;
+	struct mutex lock_wait_mu;
+	struct user_ta_lock_waiter_head lock_waiters;
+#endif
 };
 
 #ifdef CFG_WITH_USER_TA
@@ -69,5 +117,71 @@ static inline TEE_Result tee_ta_init_user_ta_session(
 }
 #endif
 
+/*
+ * Locks of a concurrent user TA, see struct user_ta_ctx. They do nothing
+ * unless the TA has TA_FLAG_CONCURRENT set.
+ *
+ * user_ta_vm_lock_shared() - keep the address space of the TA unchanged
+ * user_ta_vm_lock() - lock the address space of the TA to change it
+ * user_ta_obj_lock() - lock the crypto states and objects of the TA
+ *
+ * @vm_lock is taken before @obj_lock, @lock_wait_mu before @vm_lock.
+ */
+#ifdef CFG_CONCURRENT_USER_TA
+void user_ta_vm_lock_shared(struct user_ta_ctx *utc);
+void user_ta_vm_unlock_shared(struct user_ta_ctx *utc);
+void user_ta_vm_lock(struct user_ta_ctx *utc);
+void user_ta_vm_unlock(struct user_ta_ctx *utc);
+void user_ta_obj_lock(struct user_ta_ctx *utc);
+void user_ta_obj_unlock(struct user_ta_ctx *utc);
+
+/*
+ * user_ta_lock_wait() - sleep on a lock in user mode
+ * @utc:	User TA context with TA_FLAG_CONCURRENT set
+ * @uaddr:	User address of the 32-bit lock word
+ * @val:	Expected value of the lock word
+ *
+ * Returns at once if the lock word doesn't hold @val, else sleeps until
+ * woken by user_ta_lock_wake() on @uaddr. The lock word is read while
+ * holding the lock of the waiters so a wakeup can't be missed if the
+ * waker updates the lock word before calling user_ta_lock_wake().
+ * Returns TEE_ERROR_TARGET_DEAD if another thread has panicked the TA.
+ */
+TEE_Result user_ta_lock_wait(struct user_ta_ctx *utc, vaddr_t uaddr,
+			     uint32_t val);
+
+/*
+ * user_ta_lock_wake() - wake threads sleeping on a lock in user mode
+ * @utc:	User TA context with TA_FLAG_CONCURRENT set
+ * @uaddr:	User address of the 32-bit lock word
+ * @count:	Maximum number of threads to wake
+ */
+TEE_Result user_ta_lock_wake(struct user_ta_ctx *utc, vaddr_t uaddr,
+			     size_t count);
+#else
+static inline void user_ta_vm_lock_shared(struct user_ta_ctx *utc __unused)
+{
+}
+
+static inline void user_ta_vm_unlock_shared(struct user_ta_ctx *utc __unused)
+{
+}
+
+static inline void user_ta_vm_lock(struct user_ta_ctx *utc __unused)
+{
+}
+
+static inline void user_ta_vm_unlock(struct user_ta_ctx *utc __unused)
+{
+}
+
+static inline void user_ta_obj_lock(struct user_ta_ctx *utc __unused)
+{
+}
+
+static inline void user_ta_obj_unlock(struct user_ta_ctx *utc __unused)
+{
+}
+#endif
 
 #endif /*KERNEL_USER_TA_H*/
@@ -6,20 +6,52 @@
 #define KERNEL_WAIT_QUEUE_H
 
 #include <types_ext.h>
-#include <sys/queue.h>
 
 struct wait_queue_elem;
-SLIST_HEAD(wait_queue, wait_queue_elem);
 
-#define WAIT_QUEUE_INITIALIZER { .slh_first = NULL }
+/* FIFO list of wait queue elements, empty when zero initialized */
+struct wait_queue_list {
+	struct wait_queue_elem *first;
+	struct wait_queue_elem *last;
+};
+
+/*
+ * struct wait_queue - waiters of a sync object
+ * @readers:	Active waiters for a read lock
+ * @writers:	Active waiters for a write lock
+ * @condvar:	Waiters on a condvar, promoted to active waiters by
+ *		wq_promote_condvar()
+ * @seq:	Sequence number of the next waiter, orders the readers and
+ *		writers between each other
+ * @num_elems:	Number of wait queue elements which haven't passed
+ *		wq_wait_final() yet
+ * @num_woken:	Number of woken up elements which haven't passed
+ *		wq_wait_final() yet
+ *
+ * Elements are added at the tail of the lists and removed from the head
+ * when woken up. A promoted condvar waiter is inserted in @readers or
+ * @writers according to its sequence number, that is, the position it
+ * had when it started to wait.
+ */
+struct wait_queue {
+	struct wait_queue_list readers;
+	struct wait_queue_list writers;
+	struct wait_queue_list condvar;
+	uint32_t seq;
+	unsigned int num_elems;
+	unsigned int num_woken;
+};
+
+#define WAIT_QUEUE_INITIALIZER { }
 
 struct condvar;
 struct wait_queue_elem {
 	short handle;
 	bool done;
 	bool wait_read;
+	uint32_t seq;
 	struct condvar *cv;
-	SLIST_ENTRY(wait_queue_elem) link;
+	struct wait_queue_elem *next;
 };
 
 /*
@@ -55,6 +87,13 @@ void wq_wake_next(struct wait_queue *wq, const void *sync_obj,
 /* Returns true if the wait queue doesn't contain any elements */
 bool wq_is_empty(struct wait_queue *wq);
 
+/*
+ * Returns true if there are active waiters, either still waiting or woken
+ * up but not yet returned from wq_wait_final(). Waiters on a condvar
+ * aren't counted.
+ */
+bool wq_have_waiters(struct wait_queue *wq);
+
 void wq_promote_condvar(struct wait_queue *wq, struct condvar *cv,
 			bool only_one, const void *sync_obj, const char *fname,
 			int lineno);
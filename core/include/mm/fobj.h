@@ -35,6 +35,8 @@ struct fobj {
  * @save_page:	  Saves page with index @page_idx from address @va
  * @get_iv_vaddr: Returns virtual address of tag and IV for the page at
  *		  @page_idx if tag and IV are paged for this fobj
+ * @page_is_zero: Returns true if the page at @page_idx is known to be
+ *		  loaded filled with zeroes
  * @get_pa:	  Returns physical address of page at @page_idx if not paged
  */
 struct fobj_ops {
@@ -45,6 +47,7 @@ struct fobj_ops {
 	TEE_Result (*save_page)(struct fobj *fobj, unsigned int page_idx,
 				const void *va);
 	vaddr_t (*get_iv_vaddr)(struct fobj *fobj, unsigned int page_idx);
+	bool (*page_is_zero)(struct fobj *fobj, unsigned int page_idx);
 #endif
 	paddr_t (*get_pa)(struct fobj *fobj, unsigned int page_idx);
 };
@@ -150,6 +153,25 @@ static inline vaddr_t fobj_get_iv_vaddr(struct fobj *fobj,
 
 	return 0;
 }
+
+/*
+ * fobj_page_is_zero() - Tell if a page is known to be filled with zeroes
+ * @fobj:	Fobj pointer
+ * @page_index:	Index of page in @fobj
+ *
+ * If tag and IV are paged for this fobj the page holding the tag and IV
+ * of @page_idx must be available.
+ *
+ * Returns true if the page has never been saved or was last saved filled
+ * with zeroes, false if not or if unknown.
+ */
+static inline bool fobj_page_is_zero(struct fobj *fobj, unsigned int page_idx)
+{
+	if (fobj && fobj->ops->page_is_zero)
+		return fobj->ops->page_is_zero(fobj, page_idx);
+
+	return false;
+}
 #endif
 
 /*
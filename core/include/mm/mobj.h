@@ -284,6 +284,39 @@ TEE_Result mobj_reg_shm_release_by_cookie(uint64_t cookie);
  */
 void mobj_reg_shm_unguard(struct mobj *mobj);
 
+/**
+ * mobj_reg_shm_is_live() - check for live registered shared memory
+ * @mobj:	pointer to a mobj
+ *
+ * Returns true if @mobj is shared memory registered by normal world
+ * which is unguarded and not being released.
+ */
+bool mobj_reg_shm_is_live(struct mobj *mobj);
+
+/*
+ * struct mobj_reg_shm_map_stats - core mappings of registered shared memory
+ * @mapped_bytes:	core virtual memory currently used by the mappings
+ * @idle_bytes:		part of @mapped_bytes kept for idle mappings
+ * @idle_count:		number of idle mappings
+ * @hits:		mappings reused from the idle mappings
+ * @misses:		mappings which had to be created
+ * @evictions:		idle mappings reclaimed before the shm was freed
+ */
+struct mobj_reg_shm_map_stats {
+	size_t mapped_bytes;
+	size_t idle_bytes;
+	size_t idle_count;
+	size_t hits;
+	size_t misses;
+	size_t evictions;
+};
+
+/*
+ * mobj_reg_shm_get_map_stats() - get registered shared memory map statistics
+ * @stats:	returned statistics
+ */
+void mobj_reg_shm_get_map_stats(struct mobj_reg_shm_map_stats *stats);
+
 /*
  * mapped_shm represents registered shared buffer
  * which is mapped into OPTEE va space
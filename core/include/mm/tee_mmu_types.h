@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include <sys/queue.h>
+#include <sys/tree.h>
 #include <util.h>
 
 #define TEE_MATTR_VALID_BLOCK		BIT(0)
@@ -97,7 +98,9 @@ struct vm_region {
 	size_t size;
 	uint16_t attr; /* TEE_MATTR_* above */
 	uint16_t flags; /* VM_FLAGS_* above */
+	short int thread_id; /* Thread mapping a VM_FLAG_EPHEMERAL region */
 	TAILQ_ENTRY(vm_region) link;
+	RB_ENTRY(vm_region) tree_link;
 };
 
 enum vm_paged_region_type {
@@ -120,9 +123,17 @@ struct vm_paged_region {
 
 TAILQ_HEAD(vm_paged_region_head, vm_paged_region);
 TAILQ_HEAD(vm_region_head, vm_region);
+RB_HEAD(vm_region_tree, vm_region);
 
+/*
+ * struct vm_info - virtual memory map of a user mode context
+ * @regions:		Regions sorted on virtual address
+ * @region_tree:	The same regions indexed on virtual address
+ * @asid:		Address space identifier
+ */
 struct vm_info {
 	struct vm_region_head regions;
+	struct vm_region_tree region_tree;
 	unsigned int asid;
 };
 
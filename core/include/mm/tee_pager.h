@@ -253,16 +253,38 @@ static inline void tee_pager_release_phys(void *addr __unused,
 }
 #endif
 
+/*
+ * tee_pager_preclean() - Save dirty pages which are next in line to be
+ *			  evicted
+ *
+ * Called when a standard call has been served to move the cost of saving
+ * dirty pages out of the handling of the page faults evicting them. Pages
+ * are only saved when fewer than CFG_PAGER_PRECLEAN_WATERMARK pages can be
+ * evicted without saving them, and then at most CFG_PAGER_PRECLEAN pages
+ * per call.
+ */
+#ifdef CFG_WITH_PAGER
+void tee_pager_preclean(void);
+#else
+static inline void tee_pager_preclean(void)
+{
+}
+#endif
+
 /*
  * Statistics on the pager
  */
 struct tee_pager_stats {
-	size_t hidden_hits;
+	size_t hidden_hits;	/* faults on resident pages */
 	size_t ro_hits;
 	size_t rw_hits;
 	size_t zi_released;
 	size_t npages;		/* number of load pages */
 	size_t npages_all;	/* number of pages */
+	size_t misses;		/* faults loading a page */
+	size_t refaults;	/* misses on recently evicted pages */
+	size_t fault_around;	/* pages loaded ahead of a fault */
+	size_t precleaned;	/* dirty pages saved ahead of eviction */
 };
 
 #ifdef CFG_WITH_PAGER
@@ -57,11 +57,55 @@ TEE_Result vm_set_prot(struct user_mode_ctx *uctx, vaddr_t va, size_t len,
 
 TEE_Result vm_unmap(struct user_mode_ctx *uctx, vaddr_t va, size_t len);
 
+/*
+ * Map the read-only system time page, if available, and record its
+ * address in @uctx
+ */
+#ifdef CFG_TA_TIME_PAGE
+TEE_Result vm_map_time_page(struct user_mode_ctx *uctx);
+#else
+static inline TEE_Result vm_map_time_page(struct user_mode_ctx *uctx __unused)
+{
+	return TEE_SUCCESS;
+}
+#endif
+
 /* Map parameters for a user TA */
 TEE_Result vm_map_param(struct user_mode_ctx *uctx, struct tee_ta_param *param,
 			void *param_va[TEE_NUM_PARAMS]);
 void vm_clean_param(struct user_mode_ctx *uctx);
 
+/*
+ * With CFG_TA_PARAM_MAP_CACHE the parameter mappings of registered shared
+ * memory are parked with vm_park_param() instead of being removed when
+ * the TA returns. vm_map_param() reuses a parked mapping if the next entry
+ * passes the same memory and removes all other parked mappings.
+ * vm_clean_parked_param() removes the parked mappings of an entry
+ * without parameters.
+ *
+ * vm_revoke_parked_param() is called when @mobj is about to be released,
+ * the parked mappings drop their reference to @mobj and are removed at
+ * the next entry into the TA.
+ */
+#ifdef CFG_TA_PARAM_MAP_CACHE
+void vm_park_param(struct user_mode_ctx *uctx);
+void vm_clean_parked_param(struct user_mode_ctx *uctx);
+void vm_revoke_parked_param(struct mobj *mobj);
+#else
+static inline void vm_park_param(struct user_mode_ctx *uctx)
+{
+	vm_clean_param(uctx);
+}
+
+static inline void vm_clean_parked_param(struct user_mode_ctx *uctx __unused)
+{
+}
+
+static inline void vm_revoke_parked_param(struct mobj *mobj __unused)
+{
+}
+#endif
+
 /*
  * These two functions are deprecated and should only be called from
  * mobj_seccpy_shm_alloc() and mobj_seccpy_shm_free().
@@ -103,6 +147,22 @@ TEE_Result vm_check_access_rights(const struct user_mode_ctx *uctx,
 /* Set user context @ctx or core privileged context if @ctx is NULL */
 void vm_set_ctx(struct ts_ctx *ctx);
 
+/*
+ * Return true if @r is mapped with CORE_MMU_PGDIR_SIZE block entries
+ * directly in the user page directory instead of with translation tables.
+ * Such a region is physically contiguous and covers complete
+ * CORE_MMU_PGDIR_SIZE ranges so no translation table is needed for it.
+ */
+#ifdef CFG_CORE_USER_BLOCK_MAP
+bool vm_region_is_block_mapped(const struct vm_region *r);
+#else
+static inline bool
+vm_region_is_block_mapped(const struct vm_region *r __unused)
+{
+	return false;
+}
+#endif
+
 struct mobj *vm_get_mobj(struct user_mode_ctx *uctx, vaddr_t va, size_t *len,
 			 uint16_t *prot, size_t *offs);
 #endif /*TEE_MMU_H*/
@@ -235,6 +235,54 @@ struct optee_msg_arg {
 	((OPTEE_MSG_NONCONTIG_PAGE_SIZE - sizeof(struct optee_msg_arg)) / \
 	 sizeof(struct optee_msg_param))
 
+/**
+ * struct optee_msg_ring - submission/completion ring header
+ * @num_entries: Number of entries in the ring, a power of two
+ * @entry_size:	 Size in bytes of each entry, a multiple of 8
+ * @sq_head:	 Index of next submission to consume, updated by secure world
+ * @sq_tail:	 Index of next submission to produce, updated by normal world
+ * @cq_head:	 Index of next completion to consume, updated by normal world
+ * @cq_tail:	 Index of next completion to produce, updated by secure world
+ * @pad:	 Reserved, must be zero
+ * @queues:	 The submission queue followed by the completion queue,
+ *		 each with @num_entries entry numbers
+ *
+ * The ring header is followed by @num_entries entries of @entry_size
+ * bytes at offset OPTEE_MSG_RING_ENTRIES_OFFS(@num_entries). Each entry
+ * holds a struct optee_msg_arg with as many parameters as fit.
+ *
+ * Normal world fills in an unused entry and submits it by storing its
+ * number in the submission queue and advancing @sq_tail. Secure world
+ * stores the number of a processed entry in the completion queue and
+ * advances @cq_tail. Head and tail indexes are free running, the
+ * position in a queue is the index modulo @num_entries.
+ *
+ * A submitted entry number which is out of range isn't processed, it's
+ * returned in the completion queue with OPTEE_MSG_RING_CQ_ERROR set.
+ */
+struct optee_msg_ring {
+	uint32_t num_entries;
+	uint32_t entry_size;
+	uint32_t sq_head;
+	uint32_t sq_tail;
+	uint32_t cq_head;
+	uint32_t cq_tail;
+	uint32_t pad[2];
+	uint32_t queues[];
+};
+
+/**
+ * OPTEE_MSG_RING_ENTRIES_OFFS - return offset of the first ring entry
+ *
+ * @num_entries: Number of entries in the ring
+ */
+#define OPTEE_MSG_RING_ENTRIES_OFFS(num_entries) \
+	ROUNDUP(sizeof(struct optee_msg_ring) + \
+		sizeof(uint32_t) * 2 * (num_entries), 8)
+
+/* Set in a completion queue element for an entry that wasn't processed */
+#define OPTEE_MSG_RING_CQ_ERROR		BIT32(31)
+
 #endif /*__ASSEMBLER__*/
 
 /*****************************************************************************
@@ -331,6 +379,27 @@ struct optee_msg_arg {
  * OPTEE_MSG_CMD_STOP_ASYNC_NOTIF informs secure world that from now is
  * normal world unable to process asynchronous notifications. Typically
  * used when the driver is shut down.
+ *
+ * OPTEE_MSG_CMD_REGISTER_RING registers a submission/completion ring,
+ * described by struct optee_msg_ring, in registered shared memory. Only
+ * one ring can be registered at a time. The information is passed as:
+ * [in] param[0].attr			OPTEE_MSG_ATTR_TYPE_RMEM_INPUT
+ * [in] param[0].u.rmem.shm_ref		holds shared memory reference
+ * [in] param[0].u.rmem.offs		offset of the ring header
+ * [in] param[0].u.rmem.size		size of the ring including entries
+ * [out] param[1].attr			OPTEE_MSG_ATTR_TYPE_VALUE_OUTPUT
+ * [out] param[1].u.value.a		asynchronous notification value
+ *					signalled when completions are posted
+ *
+ * OPTEE_MSG_CMD_UNREGISTER_RING unregisters the ring once all submissions
+ * being processed have completed. No parameters are passed.
+ *
+ * OPTEE_MSG_CMD_DRAIN_RING processes submitted ring entries until the
+ * submission queue is empty. Only OPTEE_MSG_CMD_OPEN_SESSION,
+ * OPTEE_MSG_CMD_INVOKE_COMMAND and OPTEE_MSG_CMD_CLOSE_SESSION are accepted
+ * in ring entries. Normal world issues this command after submitting
+ * entries; several threads may drain the same ring concurrently. No
+ * parameters are passed.
  */
 #define OPTEE_MSG_CMD_OPEN_SESSION	U(0)
 #define OPTEE_MSG_CMD_INVOKE_COMMAND	U(1)
@@ -340,6 +409,9 @@ struct optee_msg_arg {
 #define OPTEE_MSG_CMD_UNREGISTER_SHM	U(5)
 #define OPTEE_MSG_CMD_DO_BOTTOM_HALF	U(6)
 #define OPTEE_MSG_CMD_STOP_ASYNC_NOTIF	U(7)
+#define OPTEE_MSG_CMD_REGISTER_RING	U(8)
+#define OPTEE_MSG_CMD_UNREGISTER_RING	U(9)
+#define OPTEE_MSG_CMD_DRAIN_RING	U(10)
 #define OPTEE_MSG_FUNCID_CALL_WITH_ARG	U(0x0004)
 
 #endif /* _OPTEE_MSG_H */
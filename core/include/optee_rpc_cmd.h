@@ -89,6 +89,10 @@
  * [in]    value[0].b	    Requested size
  * [in]    value[0].c	    Required alignment
  * [out]   memref[0]	    Buffer
+ *
+ * With dynamic shared memory the buffer doesn't need to be physically
+ * contiguous, it can be returned as a list of pages by setting
+ * OPTEE_MSG_ATTR_NONCONTIG in the memref attribute.
  */
 #define OPTEE_RPC_CMD_SHM_ALLOC		U(6)
 /* Memory that can be shared with a non-secure user space application */
@@ -20,6 +20,16 @@
 TEE_Result tee_entry_std(struct optee_msg_arg *arg, uint32_t num_params);
 TEE_Result __tee_entry_std(struct optee_msg_arg *arg, uint32_t num_params);
 
+/*
+ * Serves @cmd, one of OPTEE_MSG_CMD_OPEN_SESSION,
+ * OPTEE_MSG_CMD_INVOKE_COMMAND or OPTEE_MSG_CMD_CLOSE_SESSION, with @arg.
+ * @cmd is supplied separately as @arg may be in memory that normal world
+ * can modify. Returns TEE_ERROR_NOT_IMPLEMENTED for any other command,
+ * else the result is reported in @arg.
+ */
+TEE_Result tee_entry_std_session_cmd(struct optee_msg_arg *arg,
+				     uint32_t num_params, uint32_t cmd);
+
 /* Get list head for sessions opened from non-secure */
 void nsec_sessions_list_head(struct tee_ta_session_head **open_sessions);
 
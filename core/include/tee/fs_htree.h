@@ -171,4 +171,36 @@ TEE_Result tee_fs_htree_write_block(struct tee_fs_htree **ht, size_t block_num,
 TEE_Result tee_fs_htree_read_block(struct tee_fs_htree **ht, size_t block_num,
 				   void *block);
 
+/**
+ * tee_fs_htree_write_user_block() - encrypt and write a user space block
+ * @ht:		hash tree
+ * @block_num:	block number
+ * @user_block:	pointer to a block of stor->block_size size in user space
+ *
+ * Same as tee_fs_htree_write_block() except that the block is encrypted
+ * directly from user space. The caller must have checked that @user_block
+ * is readable by the current user mode context.
+ *
+ * Frees the hash tree and sets *ht to NULL on failure and returns an error code
+ */
+TEE_Result tee_fs_htree_write_user_block(struct tee_fs_htree **ht,
+					 size_t block_num,
+					 const void *user_block);
+
+/**
+ * tee_fs_htree_read_user_block() - read and decrypt a block into user space
+ * @ht:		hash tree
+ * @block_num:	block number
+ * @user_block:	pointer to a block of stor->block_size size in user space
+ *
+ * Same as tee_fs_htree_read_block() except that the block is decrypted
+ * directly into user space. The caller must have checked that @user_block
+ * is writable by the current user mode context. @user_block is cleared if
+ * the block fails to authenticate.
+ *
+ * Frees the hash tree and sets *ht to NULL on failure and returns an error code
+ */
+TEE_Result tee_fs_htree_read_user_block(struct tee_fs_htree **ht,
+					size_t block_num, void *user_block);
+
 #endif /*__TEE_FS_HTREE_H*/
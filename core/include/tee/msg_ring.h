@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2026, Analog Devices, Inc.
+ */
+
+#ifndef __TEE_MSG_RING_H
+#define __TEE_MSG_RING_H
+
+#include <optee_msg.h>
+#include <types_ext.h>
+
+/*
+ * Handlers for OPTEE_MSG_CMD_REGISTER_RING, OPTEE_MSG_CMD_UNREGISTER_RING
+ * and OPTEE_MSG_CMD_DRAIN_RING, called from __tee_entry_std(). The result
+ * is reported in @arg.
+ */
+void msg_ring_register(struct optee_msg_arg *arg, uint32_t num_params);
+void msg_ring_unregister(struct optee_msg_arg *arg, uint32_t num_params);
+void msg_ring_drain(struct optee_msg_arg *arg, uint32_t num_params);
+
+#endif /*__TEE_MSG_RING_H*/
@@ -74,4 +74,18 @@ TEE_Result syscall_wait(unsigned long timeout);
 TEE_Result syscall_get_time(unsigned long cat, TEE_Time *time);
 TEE_Result syscall_set_ta_time(const TEE_Time *time);
 
+#ifdef CFG_TA_TIME_PAGE
+TEE_Result syscall_get_time_page(uint64_t *va);
+#else
+#define syscall_get_time_page syscall_not_supported
+#endif
+
+#ifdef CFG_CONCURRENT_USER_TA
+TEE_Result syscall_lock_wait(uint32_t *lock, unsigned long val);
+TEE_Result syscall_lock_wake(uint32_t *lock, unsigned long count);
+#else
+#define syscall_lock_wait syscall_not_supported
+#define syscall_lock_wake syscall_not_supported
+#endif
+
 #endif /* TEE_SVC_H */
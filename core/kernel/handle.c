@@ -28,6 +28,8 @@ void handle_db_destroy(struct handle_db *db, void (*ptr_destructor)(void *ptr))
 		free(db->ptrs);
 		db->ptrs = NULL;
 		db->max_ptrs = 0;
+		db->first_free = 0;
+		db->next = 0;
 	}
 }
 
@@ -53,10 +55,14 @@ int handle_get(struct handle_db *db, void *ptr)
 	if (!db || !ptr)
 		return -1;
 
-	/* Try to find an empty location */
-	for (n = 0; n < db->max_ptrs; n++) {
+	/*
+	 * Try to find an empty location, no need to look below first_free
+	 * which is updated by handle_put() as handles are released.
+	 */
+	for (n = db->first_free; n < db->max_ptrs; n++) {
 		if (!db->ptrs[n]) {
 			db->ptrs[n] = ptr;
+			db->first_free = n + 1;
 			return n;
 		}
 	}
@@ -76,6 +82,41 @@ int handle_get(struct handle_db *db, void *ptr)
 
 	/* Since n stopped at db->max_ptrs there is an empty location there */
 	db->ptrs[n] = ptr;
+	db->first_free = n + 1;
+	return n;
+}
+
+int handle_get_next(struct handle_db *db, void *ptr)
+{
+	size_t start = 0;
+	size_t n = 0;
+	int h = 0;
+
+	if (!db || !ptr)
+		return -1;
+
+	start = db->next;
+	if (start >= db->max_ptrs)
+		start = 0;
+
+	for (n = start; n < db->max_ptrs; n++)
+		if (!db->ptrs[n])
+			goto found;
+	for (n = 0; n < start; n++)
+		if (!db->ptrs[n])
+			goto found;
+
+	/* All handles are in use, let handle_get() grow the array */
+	h = handle_get(db, ptr);
+	if (h >= 0)
+		db->next = h + 1;
+	return h;
+
+found:
+	db->ptrs[n] = ptr;
+	db->next = n + 1;
+	if (n == db->first_free)
+		db->first_free = n + 1;
 	return n;
 }
 
@@ -88,6 +129,8 @@ void *handle_put(struct handle_db *db, int handle)
 
 	p = db->ptrs[handle];
 	db->ptrs[handle] = NULL;
+	if (p && (size_t)handle < db->first_free)
+		db->first_free = handle;
 	return p;
 }
 
@@ -6,6 +6,7 @@
  */
 
 #include <assert.h>
+#include <config.h>
 #include <kernel/ldelf_loader.h>
 #include <kernel/ldelf_syscalls.h>
 #include <kernel/scall.h>
@@ -13,6 +14,7 @@
 #include <ldelf.h>
 #include <mm/mobj.h>
 #include <mm/vm.h>
+#include <stdlib.h>
 
 #define BOUNCE_BUFFER_SIZE	4096
 
@@ -46,6 +48,87 @@ static TEE_Result alloc_and_map_fobj(struct user_mode_ctx *uctx, size_t sz,
 	return res;
 }
 
+#if defined(CFG_CONCURRENT_USER_TA)
+/*
+ * Replaces the bounce buffer used while loading with one bounce buffer for
+ * each thread since several threads may be in system calls concurrently.
+ */
+static TEE_Result init_thread_bbufs(struct user_mode_ctx *uctx)
+{
+	TEE_Result res = TEE_SUCCESS;
+	vaddr_t bb_addr = 0;
+
+	assert(!uctx->bbuf_offs);
+
+	uctx->thread_bbuf_offs = calloc(CFG_NUM_THREADS,
+					sizeof(*uctx->thread_bbuf_offs));
+	if (!uctx->thread_bbuf_offs)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	res = alloc_and_map_fobj(uctx, BOUNCE_BUFFER_SIZE * CFG_NUM_THREADS,
+				 TEE_MATTR_PRW, 0, &bb_addr);
+	if (res)
+		goto err;
+	res = vm_unmap(uctx, (vaddr_t)uctx->bbuf, BOUNCE_BUFFER_SIZE);
+	if (res)
+		goto err;
+	uctx->bbuf = (void *)bb_addr;
+
+	return TEE_SUCCESS;
+err:
+	free(uctx->thread_bbuf_offs);
+	uctx->thread_bbuf_offs = NULL;
+	return res;
+}
+#endif
+
+static TEE_Result init_user_ta_flags(struct user_mode_ctx *uctx,
+				     uint32_t flags)
+{
+	const uint32_t concurrent_flags = TA_FLAG_SINGLE_INSTANCE |
+					  TA_FLAG_MULTI_SESSION |
+					  TA_FLAG_CONCURRENT;
+
+	/*
+	 * This is already checked by the elf loader, but since it runs
+	 * in user mode we're not trusting it entirely.
+	 */
+	if (flags & ~TA_FLAGS_MASK)
+		return TEE_ERROR_BAD_FORMAT;
+
+	/*
+	 * Only a single-instance, multi-session TA can execute sessions
+	 * concurrently, and only if the core supports it.
+	 */
+	if ((flags & TA_FLAG_CONCURRENT) &&
+	    (!IS_ENABLED(CFG_CONCURRENT_USER_TA) ||
+	     (flags & concurrent_flags) != concurrent_flags)) {
+		DMSG("Ignoring TA_FLAG_CONCURRENT");
+		flags &= ~TA_FLAG_CONCURRENT;
+	}
+
+#if defined(CFG_CONCURRENT_USER_TA) && defined(CFG_WITH_VFP)
+	if (flags & TA_FLAG_CONCURRENT) {
+		uctx->thread_vfp = calloc(CFG_NUM_THREADS,
+					  sizeof(*uctx->thread_vfp));
+		if (!uctx->thread_vfp)
+			return TEE_ERROR_OUT_OF_MEMORY;
+	}
+#endif
+#if defined(CFG_CONCURRENT_USER_TA)
+	if (flags & TA_FLAG_CONCURRENT) {
+		TEE_Result res = init_thread_bbufs(uctx);
+
+		if (res)
+			return res;
+	}
+#endif
+
+	to_user_ta_ctx(uctx->ts_ctx)->ta_ctx.flags = flags;
+
+	return TEE_SUCCESS;
+}
+
 /*
  * This function may leave a few mappings behind on error, but that's taken
  * care of by tee_ta_init_user_ta_session() since the entire context is
@@ -121,6 +204,7 @@ TEE_Result ldelf_init_with_ldelf(struct ts_session *sess,
 	uint32_t panicked = 0;
 	uaddr_t usr_stack = 0;
 	struct ldelf_arg *arg_bbuf = NULL;
+	uint32_t flags = 0;
 
 	usr_stack = uctx->ldelf_stack_ptr;
 	usr_stack -= ROUNDUP(sizeof(*arg), STACK_ALIGNMENT);
@@ -157,21 +241,12 @@ TEE_Result ldelf_init_with_ldelf(struct ts_session *sess,
 	if (res)
 		return res;
 
-	if (is_user_ta_ctx(uctx->ts_ctx)) {
-		/*
-		 * This is already checked by the elf loader, but since it runs
-		 * in user mode we're not trusting it entirely.
-		 */
-		if (arg_bbuf->flags & ~TA_FLAGS_MASK)
-			return TEE_ERROR_BAD_FORMAT;
-
-		to_user_ta_ctx(uctx->ts_ctx)->ta_ctx.flags = arg_bbuf->flags;
-	}
-
+	flags = arg_bbuf->flags;
 	uctx->is_32bit = arg_bbuf->is_32bit;
 	uctx->entry_func = arg_bbuf->entry_func;
 	uctx->load_addr = arg_bbuf->load_addr;
 	uctx->stack_ptr = arg_bbuf->stack_ptr;
+	uctx->stack_size = arg_bbuf->stack_size;
 	uctx->dump_entry_func = arg_bbuf->dump_entry;
 #ifdef CFG_FTRACE_SUPPORT
 	uctx->ftrace_entry_func = arg_bbuf->ftrace_entry;
@@ -181,6 +256,13 @@ TEE_Result ldelf_init_with_ldelf(struct ts_session *sess,
 
 	bb_free(arg_bbuf, sizeof(*arg));
 
+	/*
+	 * The bounce buffer may be replaced below so @arg_bbuf must be
+	 * freed first.
+	 */
+	if (is_user_ta_ctx(uctx->ts_ctx))
+		return init_user_ta_flags(uctx, flags);
+
 	return TEE_SUCCESS;
 }
 
@@ -3,15 +3,77 @@
  * Copyright (c) 2015-2017, Linaro Limited
  */
 
+#include <atomic.h>
+#include <kernel/delay.h>
 #include <kernel/mutex.h>
 #include <kernel/panic.h>
 #include <kernel/refcount.h>
 #include <kernel/spinlock.h>
 #include <kernel/thread.h>
+#include <kernel/thread_private.h>
 #include <trace.h>
 
 #include "mutex_lockdep.h"
 
+#ifdef CFG_WITH_STATS
+static struct mutex_stats mutex_stats;
+
+static void incr_spin_acquired(void)
+{
+	atomic_inc32(&mutex_stats.spin_acquired);
+}
+
+static void incr_sleeps(void)
+{
+	atomic_inc32(&mutex_stats.sleeps);
+}
+
+void mutex_get_stats(struct mutex_stats *stats)
+{
+	stats->spin_acquired = atomic_load_u32(&mutex_stats.spin_acquired);
+	stats->sleeps = atomic_load_u32(&mutex_stats.sleeps);
+}
+#else
+static void incr_spin_acquired(void) { }
+static void incr_sleeps(void) { }
+#endif
+
+/*
+ * A contended mutex held for writing by a thread which is active, that
+ * is, executing on another core rather than being suspended in normal
+ * world, is likely to be released soon. Spinning for up to
+ * CFG_MUTEX_SPIN_US is then cheaper than a round trip to normal world to
+ * wait for it. There's no spinning if other threads are waiting already,
+ * they are first in line. Must be called with m->spin_lock held.
+ */
+static bool mutex_can_spin(struct mutex *m, uint64_t *spin_end)
+{
+	if (!CFG_MUTEX_SPIN_US || m->state != -1)
+		return false;
+	if (m->owner < 0 || m->owner >= CFG_NUM_THREADS ||
+	    threads[m->owner].state != THREAD_STATE_ACTIVE)
+		return false;
+	if (wq_have_waiters(&m->wq))
+		return false;
+
+	if (!*spin_end)
+		*spin_end = timeout_init_us(CFG_MUTEX_SPIN_US);
+	return !timeout_elapsed(*spin_end);
+}
+
+/*
+ * Waits until the mutex isn't write locked any longer or the spin time
+ * has elapsed. Only reading the state leaves the cache line shared
+ * instead of repeatedly taking m->spin_lock, reading the counter in
+ * timeout_elapsed() paces the loop.
+ */
+static void mutex_spin_wait(struct mutex *m, uint64_t spin_end)
+{
+	while (atomic_load_short(&m->state) == -1 &&
+	       !timeout_elapsed(spin_end))
+		;
+}
+
 void mutex_init(struct mutex *m)
 {
 	*m = (struct mutex)MUTEX_INITIALIZER;
@@ -24,6 +86,9 @@ void mutex_init_recursive(struct recursive_mutex *m)
 
 static void __mutex_lock(struct mutex *m, const char *fname, int lineno)
 {
+	uint64_t spin_end = 0;
+	bool spun = false;
+
 	assert_have_no_spinlock();
 	assert(thread_get_id_may_fail() != THREAD_ID_INVALID);
 	assert(thread_is_in_normal_mode());
@@ -33,6 +98,7 @@ static void __mutex_lock(struct mutex *m, const char *fname, int lineno)
 	while (true) {
 		uint32_t old_itr_status;
 		bool can_lock;
+		bool spin = false;
 		struct wait_queue_elem wqe;
 
 		/*
@@ -46,23 +112,44 @@ static void __mutex_lock(struct mutex *m, const char *fname, int lineno)
 
 		old_itr_status = cpu_spin_lock_xsave(&m->spin_lock);
 
-		can_lock = !m->state;
+		/*
+		 * After spinning the mutex is only taken if there are no
+		 * waiters, a woken up waiter must not be passed.
+		 */
+		can_lock = !m->state && !(spun && wq_have_waiters(&m->wq));
 		if (!can_lock) {
-			wq_wait_init(&m->wq, &wqe, false /* wait_read */);
+			spin = mutex_can_spin(m, &spin_end);
+			if (!spin)
+				wq_wait_init(&m->wq, &wqe,
+					     false /* wait_read */);
 		} else {
 			m->state = -1; /* write locked */
+			m->owner = thread_get_id();
 		}
 
 		cpu_spin_unlock_xrestore(&m->spin_lock, old_itr_status);
 
-		if (!can_lock) {
-			/*
-			 * Someone else is holding the lock, wait in normal
-			 * world for the lock to become available.
-			 */
-			wq_wait_final(&m->wq, &wqe, m, fname, lineno);
-		} else
+		if (can_lock) {
+			if (spun)
+				incr_spin_acquired();
 			return;
+		}
+
+		if (spin) {
+			/* The owner is active, try again once it's done */
+			mutex_spin_wait(m, spin_end);
+			spun = true;
+			continue;
+		}
+
+		/*
+		 * Someone else is holding the lock, wait in normal world
+		 * for the lock to become available.
+		 */
+		incr_sleeps();
+		spin_end = 0;
+		spun = false;
+		wq_wait_final(&m->wq, &wqe, m, fname, lineno);
 	}
 }
 
@@ -136,8 +223,10 @@ static bool __mutex_trylock(struct mutex *m, const char *fname __unused,
 	old_itr_status = cpu_spin_lock_xsave(&m->spin_lock);
 
 	can_lock_write = !m->state;
-	if (can_lock_write)
+	if (can_lock_write) {
 		m->state = -1;
+		m->owner = thread_get_id();
+	}
 
 	cpu_spin_unlock_xrestore(&m->spin_lock, old_itr_status);
 
@@ -171,6 +260,9 @@ static void __mutex_read_unlock(struct mutex *m, const char *fname, int lineno)
 
 static void __mutex_read_lock(struct mutex *m, const char *fname, int lineno)
 {
+	uint64_t spin_end = 0;
+	bool spun = false;
+
 	assert_have_no_spinlock();
 	assert(thread_get_id_may_fail() != THREAD_ID_INVALID);
 	assert(thread_is_in_normal_mode());
@@ -178,6 +270,7 @@ static void __mutex_read_lock(struct mutex *m, const char *fname, int lineno)
 	while (true) {
 		uint32_t old_itr_status;
 		bool can_lock;
+		bool spin = false;
 		struct wait_queue_elem wqe;
 
 		/*
@@ -191,23 +284,40 @@ static void __mutex_read_lock(struct mutex *m, const char *fname, int lineno)
 
 		old_itr_status = cpu_spin_lock_xsave(&m->spin_lock);
 
-		can_lock = m->state != -1;
+		can_lock = m->state != -1 &&
+			   !(spun && wq_have_waiters(&m->wq));
 		if (!can_lock) {
-			wq_wait_init(&m->wq, &wqe, true /* wait_read */);
+			spin = mutex_can_spin(m, &spin_end);
+			if (!spin)
+				wq_wait_init(&m->wq, &wqe,
+					     true /* wait_read */);
 		} else {
 			m->state++; /* read_locked */
 		}
 
 		cpu_spin_unlock_xrestore(&m->spin_lock, old_itr_status);
 
-		if (!can_lock) {
-			/*
-			 * Someone else is holding the lock, wait in normal
-			 * world for the lock to become available.
-			 */
-			wq_wait_final(&m->wq, &wqe, m, fname, lineno);
-		} else
+		if (can_lock) {
+			if (spun)
+				incr_spin_acquired();
 			return;
+		}
+
+		if (spin) {
+			/* The owner is active, try again once it's done */
+			mutex_spin_wait(m, spin_end);
+			spun = true;
+			continue;
+		}
+
+		/*
+		 * Someone else is holding the lock, wait in normal world
+		 * for the lock to become available.
+		 */
+		incr_sleeps();
+		spin_end = 0;
+		spun = false;
+		wq_wait_final(&m->wq, &wqe, m, fname, lineno);
 	}
 }
 
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: BSD-2-Clause
+/*
+ * Copyright (c) 2026, Analog Devices, Inc.
+ */
+
+#include <assert.h>
+#include <kernel/misc.h>
+#include <kernel/panic.h>
+#include <kernel/rwlock.h>
+#include <kernel/thread.h>
+#include <string.h>
+
+/*
+ * The reader count is updated and the writer flag read (and the other
+ * way around for writers) with sequentially consistent ordering. This
+ * guarantees that either a new reader sees the writer flag or the
+ * writer sees the count of the new reader.
+ */
+
+/* Called with foreign interrupts masked */
+static void add_reader_at(struct rwlock *l, size_t pos, int val)
+{
+	__atomic_add_fetch(&l->readers[pos].count, val, __ATOMIC_SEQ_CST);
+}
+
+static void add_reader(struct rwlock *l, int val)
+{
+	uint32_t exceptions = thread_mask_exceptions(THREAD_EXCP_FOREIGN_INTR);
+
+	add_reader_at(l, get_core_pos(), val);
+	thread_unmask_exceptions(exceptions);
+}
+
+static bool have_writer(struct rwlock *l)
+{
+	return __atomic_load_n(&l->writer, __ATOMIC_SEQ_CST);
+}
+
+static int sum_readers(struct rwlock *l)
+{
+	int sum = 0;
+	size_t n = 0;
+
+	for (n = 0; n < ARRAY_SIZE(l->readers); n++)
+		sum += __atomic_load_n(&l->readers[n].count, __ATOMIC_SEQ_CST);
+
+	return sum;
+}
+
+static void wake_writer(struct rwlock *l)
+{
+	mutex_lock(&l->m);
+	condvar_broadcast(&l->cv);
+	mutex_unlock(&l->m);
+}
+
+void rwlock_init(struct rwlock *l)
+{
+	*l = (struct rwlock)RWLOCK_INITIALIZER;
+}
+
+void rwlock_destroy(struct rwlock *l)
+{
+	if (l->writer || sum_readers(l))
+		panic();
+	mutex_destroy(&l->m);
+	condvar_destroy(&l->cv);
+}
+
+void rwlock_read_lock(struct rwlock *l)
+{
+	uint32_t exceptions = thread_mask_exceptions(THREAD_EXCP_FOREIGN_INTR);
+	size_t pos = get_core_pos();
+
+	/*
+	 * Backing off must undo the count in the same slot, else a writer
+	 * summing the slots could miss the +1 but see the -1 and take the
+	 * lock while another reader still holds it.
+	 */
+	add_reader_at(l, pos, 1);
+	if (!have_writer(l)) {
+		thread_unmask_exceptions(exceptions);
+		return;
+	}
+
+	/* Back off and wait until the writer is done */
+	add_reader_at(l, pos, -1);
+	thread_unmask_exceptions(exceptions);
+	wake_writer(l);
+
+	mutex_lock(&l->m);
+	while (l->writer)
+		condvar_wait(&l->cv, &l->m);
+	add_reader(l, 1);
+	mutex_unlock(&l->m);
+}
+
+void rwlock_read_unlock(struct rwlock *l)
+{
+	add_reader(l, -1);
+	if (have_writer(l))
+		wake_writer(l);
+}
+
+void rwlock_write_lock(struct rwlock *l)
+{
+	mutex_lock(&l->m);
+	while (l->writer)
+		condvar_wait(&l->cv, &l->m);
+	__atomic_store_n(&l->writer, 1, __ATOMIC_SEQ_CST);
+	while (sum_readers(l))
+		condvar_wait(&l->cv, &l->m);
+	mutex_unlock(&l->m);
+}
+
+void rwlock_write_unlock(struct rwlock *l)
+{
+	mutex_lock(&l->m);
+	assert(l->writer);
+	__atomic_store_n(&l->writer, 0, __ATOMIC_RELEASE);
+	condvar_broadcast(&l->cv);
+	mutex_unlock(&l->m);
+}
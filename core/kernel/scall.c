@@ -120,6 +120,9 @@ static const struct syscall_entry tee_syscall_table[] = {
 	SYSCALL_ENTRY(syscall_not_supported),
 	SYSCALL_ENTRY(syscall_not_supported),
 	SYSCALL_ENTRY(syscall_cache_operation),
+	SYSCALL_ENTRY(syscall_get_time_page),
+	SYSCALL_ENTRY(syscall_lock_wait),
+	SYSCALL_ENTRY(syscall_lock_wake),
 };
 
 /*
@@ -206,23 +209,84 @@ static syscall_t get_tee_syscall_func(size_t num)
 				 &sc_table[TEE_SCN_MAX].fn + 1);
 }
 
+/*
+ * System calls from a TA_FLAG_CONCURRENT TA hold the address space of
+ * the TA shared so that user memory stays mapped while it's accessed,
+ * except TEE_Wait() and the user mode lock system calls which may block
+ * for a long time, the latter take it only while reading the lock word.
+ * Calls to other TAs release it while the called TA executes, see
+ * tee_svc.c. Crypto and storage system calls and the TA time also take
+ * the lock of the crypto states and objects of the TA.
+ */
+static bool scn_uses_vm(size_t scn)
+{
+	return scn != TEE_SCN_WAIT && scn != TEE_SCN_LOCK_WAIT &&
+	       scn != TEE_SCN_LOCK_WAKE;
+}
+
+static bool scn_uses_objs(size_t scn)
+{
+	if (scn == TEE_SCN_GET_TIME || scn == TEE_SCN_SET_TA_TIME)
+		return true;
+
+	return scn >= TEE_SCN_CRYP_STATE_ALLOC &&
+	       scn <= TEE_SCN_CRYP_OBJ_GENERATE_KEY &&
+	       scn != TEE_SCN_CRYP_RANDOM_NUMBER_GENERATE;
+}
+
+static void scall_lock(struct user_ta_ctx *utc, size_t scn)
+{
+	if (scn_uses_vm(scn))
+		user_ta_vm_lock_shared(utc);
+	if (scn_uses_objs(scn))
+		user_ta_obj_lock(utc);
+}
+
+static void scall_unlock(struct user_ta_ctx *utc, size_t scn)
+{
+	if (scn_uses_objs(scn))
+		user_ta_obj_unlock(utc);
+	if (scn_uses_vm(scn))
+		user_ta_vm_unlock_shared(utc);
+}
+
 bool scall_handle_user_ta(struct thread_scall_regs *regs)
 {
+	struct ts_session *sess = ts_get_current_session();
+	struct user_ta_ctx *utc = to_user_ta_ctx(sess->ctx);
 	size_t scn = 0;
 	size_t max_args = 0;
 	syscall_t scf = NULL;
 
-	bb_reset();
 	scall_get_max_args(regs, &scn, &max_args);
 
+	scall_lock(utc, scn);
+
+	bb_reset();
+
 	trace_syscall(scn);
 
 	if (max_args > TEE_SVC_MAX_ARGS) {
 		DMSG("Too many arguments for SCN %zu (%zu)", scn, max_args);
 		scall_set_retval(regs, TEE_ERROR_GENERIC);
+		scall_unlock(utc, scn);
 		return true; /* return to user mode */
 	}
 
+	/*
+	 * Another thread has panicked in a TA_FLAG_CONCURRENT TA, leave
+	 * the TA as if this thread had panicked too.
+	 */
+	if (utc->ta_ctx.panicked) {
+		scall_set_retval(regs,
+				 scall_sys_return_helper(TEE_ERROR_TARGET_DEAD,
+							 true,
+							 TEE_ERROR_TARGET_DEAD,
+							 regs));
+		scall_unlock(utc, scn);
+		return false;
+	}
+
 	scf = get_tee_syscall_func(scn);
 
 	ftrace_syscall_enter(scn);
@@ -231,6 +295,8 @@ bool scall_handle_user_ta(struct thread_scall_regs *regs)
 
 	ftrace_syscall_leave();
 
+	scall_unlock(utc, scn);
+
 	/*
 	 * Return true if we're to return to user mode,
 	 * thread_scall_handler() will take care of the rest.
@@ -20,6 +20,7 @@ endif
 srcs-y += panic.c
 srcs-y += trace_ext.c
 srcs-y += refcount.c
+srcs-y += rwlock.c
 srcs-y += delay.c
 srcs-y += tee_time.c
 srcs-$(CFG_SECURE_TIME_SOURCE_REE) += tee_time_ree.c
@@ -5,6 +5,7 @@
  */
 
 #include <assert.h>
+#include <kernel/handle.h>
 #include <kernel/mutex.h>
 #include <kernel/panic.h>
 #include <kernel/pseudo_ta.h>
@@ -59,6 +60,15 @@ struct mutex tee_ta_mutex = MUTEX_INITIALIZER;
 struct condvar tee_ta_init_cv = CONDVAR_INITIALIZER;
 struct tee_ta_ctx_head tee_ctxes = TAILQ_HEAD_INITIALIZER(tee_ctxes);
 
+/*
+ * Registered contexts hashed on UUID and all open sessions indexed by
+ * session ID - 1, both protected by tee_ta_mutex.
+ */
+#define TEE_TA_CTX_HASH_SIZE	32
+static LIST_HEAD(tee_ta_ctx_bucket, tee_ta_ctx)
+	tee_ta_ctx_hash[TEE_TA_CTX_HASH_SIZE];
+static struct handle_db tee_ta_session_db = HANDLE_DB_INITIALIZER;
+
 #ifndef CFG_CONCURRENT_SINGLE_INSTANCE_TA
 static struct condvar tee_ta_cv = CONDVAR_INITIALIZER;
 static short int tee_ta_single_instance_thread = THREAD_ID_INVALID;
@@ -218,16 +228,13 @@ static struct tee_ta_session *tee_ta_find_session_nolock(uint32_t id,
 			struct tee_ta_session_head *open_sessions)
 {
 	struct tee_ta_session *s = NULL;
-	struct tee_ta_session *found = NULL;
 
-	TAILQ_FOREACH(s, open_sessions, link) {
-		if (s->id == id) {
-			found = s;
-			break;
-		}
-	}
+	/* An id of 0 or above INT_MAX turns into an invalid handle */
+	s = handle_lookup(&tee_ta_session_db, (int)(id - 1));
+	if (!s || s->open_sessions != open_sessions)
+		return NULL;
 
-	return found;
+	return s;
 }
 
 struct tee_ta_session *tee_ta_find_session(uint32_t id,
@@ -298,6 +305,7 @@ static void tee_ta_unlink_session(struct tee_ta_session *s,
 		condvar_wait(&s->refc_cv, &tee_ta_mutex);
 
 	TAILQ_REMOVE(open_sessions, s, link);
+	handle_put(&tee_ta_session_db, s->id - 1);
 
 	mutex_unlock(&tee_ta_mutex);
 }
@@ -329,6 +337,30 @@ static void destroy_context(struct tee_ta_ctx *ctx)
 	ctx->ts_ctx.ops->destroy(&ctx->ts_ctx);
 }
 
+static struct tee_ta_ctx_bucket *ctx_bucket(const TEE_UUID *uuid)
+{
+	uint32_t h = uuid->timeLow ^ uuid->timeMid ^
+		     (uuid->timeHiAndVersion << 16);
+	size_t n = 0;
+
+	for (n = 0; n < sizeof(uuid->clockSeqAndNode); n++)
+		h = h * 31 + uuid->clockSeqAndNode[n];
+
+	return tee_ta_ctx_hash + (h % TEE_TA_CTX_HASH_SIZE);
+}
+
+void tee_ta_register_ctx(struct tee_ta_ctx *ctx)
+{
+	TAILQ_INSERT_TAIL(&tee_ctxes, ctx, link);
+	LIST_INSERT_HEAD(ctx_bucket(&ctx->ts_ctx.uuid), ctx, uuid_link);
+}
+
+void tee_ta_unregister_ctx(struct tee_ta_ctx *ctx)
+{
+	TAILQ_REMOVE(&tee_ctxes, ctx, link);
+	LIST_REMOVE(ctx, uuid_link);
+}
+
 /*
  * tee_ta_context_find - Find TA in session list based on a UUID (input)
  * Returns a pointer to the session
@@ -337,7 +369,7 @@ static struct tee_ta_ctx *tee_ta_context_find(const TEE_UUID *uuid)
 {
 	struct tee_ta_ctx *ctx;
 
-	TAILQ_FOREACH(ctx, &tee_ctxes, link) {
+	LIST_FOREACH(ctx, ctx_bucket(uuid), uuid_link) {
 		if (memcmp(&ctx->ts_ctx.uuid, uuid, sizeof(TEE_UUID)) == 0)
 			return ctx;
 	}
@@ -460,22 +492,28 @@ TEE_Result tee_ta_close_session(struct tee_ta_session *csess,
 				struct tee_ta_session_head *open_sessions,
 				const TEE_Identity *clnt_id)
 {
-	struct tee_ta_session *sess = NULL;
-	struct tee_ta_ctx *ctx = NULL;
-	struct ts_ctx *ts_ctx = NULL;
-	bool keep_alive = false;
-
 	DMSG("csess 0x%" PRIxVA " id %u",
 	     (vaddr_t)csess, csess ? csess->id : UINT_MAX);
 
 	if (!csess)
 		return TEE_ERROR_ITEM_NOT_FOUND;
 
-	sess = tee_ta_get_session(csess->id, true, open_sessions);
+	return tee_ta_close_session_id(csess->id, open_sessions, clnt_id);
+}
+
+TEE_Result tee_ta_close_session_id(uint32_t id,
+				   struct tee_ta_session_head *open_sessions,
+				   const TEE_Identity *clnt_id)
+{
+	struct tee_ta_session *sess = NULL;
+	struct tee_ta_ctx *ctx = NULL;
+	struct ts_ctx *ts_ctx = NULL;
+	bool keep_alive = false;
+
+	sess = tee_ta_get_session(id, true, open_sessions);
 
 	if (!sess) {
-		EMSG("session 0x%" PRIxVA " to be removed is not found",
-		     (vaddr_t)csess);
+		EMSG("session %#"PRIx32" to be removed is not found", id);
 		return TEE_ERROR_ITEM_NOT_FOUND;
 	}
 
@@ -513,7 +551,7 @@ TEE_Result tee_ta_close_session(struct tee_ta_session *csess,
 			(ctx->flags & TA_FLAG_SINGLE_INSTANCE);
 	if (!ctx->ref_count && (ctx->panicked || !keep_alive)) {
 		if (!ctx->is_releasing) {
-			TAILQ_REMOVE(&tee_ctxes, ctx, link);
+			tee_ta_unregister_ctx(ctx);
 			ctx->is_releasing = true;
 		}
 		mutex_unlock(&tee_ta_mutex);
@@ -571,30 +609,15 @@ static TEE_Result tee_ta_init_session_with_context(struct tee_ta_session *s,
 	return TEE_SUCCESS;
 }
 
-static uint32_t new_session_id(struct tee_ta_session_head *open_sessions)
+static uint32_t new_session_id(struct tee_ta_session *s)
 {
-	struct tee_ta_session *last = NULL;
-	uint32_t saved = 0;
-	uint32_t id = 1;
-
-	last = TAILQ_LAST(open_sessions, tee_ta_session_head);
-	if (last) {
-		/* This value is less likely to be already used */
-		id = last->id + 1;
-		if (!id)
-			id++; /* 0 is not valid */
-	}
-
-	saved = id;
-	do {
-		if (!tee_ta_find_session_nolock(id, open_sessions))
-			return id;
-		id++;
-		if (!id)
-			id++;
-	} while (id != saved);
+	/* Don't hand out the ID of a just closed session again right away */
+	int h = handle_get_next(&tee_ta_session_db, s);
 
-	return 0;
+	if (h < 0)
+		return 0;
+	/* 0 is not valid */
+	return h + 1;
 }
 
 static TEE_Result tee_ta_init_session(TEE_ErrorOrigin *err,
@@ -616,12 +639,13 @@ static TEE_Result tee_ta_init_session(TEE_ErrorOrigin *err,
 	s->ref_count = 1;
 
 	mutex_lock(&tee_ta_mutex);
-	s->id = new_session_id(open_sessions);
+	s->id = new_session_id(s);
 	if (!s->id) {
 		res = TEE_ERROR_OVERFLOW;
 		goto err_mutex_unlock;
 	}
 
+	s->open_sessions = open_sessions;
 	TAILQ_INSERT_TAIL(open_sessions, s, link);
 
 	/* Look for already loaded TA */
@@ -651,6 +675,7 @@ out:
 
 	mutex_lock(&tee_ta_mutex);
 	TAILQ_REMOVE(open_sessions, s, link);
+	handle_put(&tee_ta_session_db, s->id - 1);
 err_mutex_unlock:
 	mutex_unlock(&tee_ta_mutex);
 	free(s);
@@ -666,7 +691,7 @@ static void release_ta_ctx(struct tee_ta_ctx *ctx)
 	ctx->is_releasing = true;
 	if (!was_releasing) {
 		DMSG("Releasing panicked TA ctx");
-		TAILQ_REMOVE(&tee_ctxes, ctx, link);
+		tee_ta_unregister_ctx(ctx);
 	}
 	mutex_unlock(&tee_ta_mutex);
 
@@ -6,19 +6,82 @@
 
 #include <compiler.h>
 #include <initcall.h>
+#include <kernel/delay.h>
+#include <kernel/panic.h>
+#include <kernel/spinlock.h>
 #include <kernel/tee_time.h>
 #include <kernel/thread.h>
 #include <kernel/time_source.h>
+#include <mm/core_memprot.h>
 #include <mm/core_mmu.h>
+#include <mm/mobj.h>
 #include <optee_rpc_cmd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <utee_defines.h>
+#include <utee_types.h>
+#include <util.h>
 
 struct time_source _time_source;
 
+#ifdef CFG_TA_TIME_PAGE
+static union {
+	struct utee_time_page page;
+	uint8_t data[SMALL_PAGE_SIZE];
+} time_page __nex_bss __aligned(SMALL_PAGE_SIZE);
+
+/*
+ * The page is in nexus memory, which isn't covered by mobj_tee_ram_rw
+ * with CFG_NS_VIRTUALIZATION, so it has a mobj of its own. The mobj is
+ * allocated by the initcall of each partition.
+ */
+static struct mobj *time_page_mobj;
+
+static void init_time_page(void)
+{
+	if (!_time_source.user_counter)
+		return;
+
+	time_page_mobj = mobj_phys_alloc(virt_to_phys(&time_page),
+					 sizeof(time_page),
+					 TEE_MATTR_MEM_TYPE_CACHED,
+					 CORE_MEM_TEE_RAM);
+	if (!time_page_mobj)
+		panic("Failed to register time page");
+
+	/*
+	 * No TA can read the page yet so there's no need to update the
+	 * sequence counter.
+	 */
+	time_page.page.cnt_freq = read_cntfrq();
+	time_page.page.cnt_offset = 0;
+}
+
+bool tee_time_get_user_page(struct mobj **mobj, size_t *offset)
+{
+	if (!time_page_mobj)
+		return false;
+
+	*mobj = time_page_mobj;
+	*offset = 0;
+	return true;
+}
+#else
+static void init_time_page(void)
+{
+}
+
+bool tee_time_get_user_page(struct mobj **mobj __unused,
+			    size_t *offset __unused)
+{
+	return false;
+}
+#endif
+
 static TEE_Result register_time_source(void)
 {
 	time_source_init();
+	init_time_page();
 
 	return TEE_SUCCESS;
 }
@@ -42,6 +105,86 @@ void tee_time_wait(uint32_t milliseconds_delay)
 	thread_rpc_cmd(OPTEE_RPC_CMD_SUSPEND, 1, &params);
 }
 
+static TEE_Result rpc_get_ree_time(TEE_Time *time)
+{
+	struct thread_param params = THREAD_PARAM_VALUE(OUT, 0, 0, 0);
+	TEE_Result res = TEE_SUCCESS;
+
+	res = thread_rpc_cmd(OPTEE_RPC_CMD_GET_TIME, 1, &params);
+	if (res == TEE_SUCCESS) {
+		time->seconds = params.u.value.a;
+		time->millis = params.u.value.b / 1000000;
+	}
+
+	return res;
+}
+
+#ifdef CFG_REE_TIME_CACHE
+/*
+ * REE time is sampled with an RPC at most every CFG_REE_TIME_CACHE_MS
+ * milliseconds and extrapolated with the counter in between. A new
+ * sample replaces the extrapolated time as is, so a correction of the
+ * REE clock backwards is seen by the callers. Monotonic time is provided
+ * by the REE time source, see tee_time_ree.c.
+ */
+static unsigned int ree_time_lock = SPINLOCK_UNLOCK;
+static uint64_t ree_time_base_cnt;
+static uint64_t ree_time_base_ms;
+static bool ree_time_valid;
+
+static uint64_t ree_time_to_ms(const TEE_Time *time)
+{
+	return (uint64_t)time->seconds * TEE_TIME_MILLIS_BASE + time->millis;
+}
+
+static void ree_time_from_ms(uint64_t ms, TEE_Time *time)
+{
+	time->seconds = ms / TEE_TIME_MILLIS_BASE;
+	time->millis = ms % TEE_TIME_MILLIS_BASE;
+}
+
+static bool get_cached_ree_time(TEE_Time *time)
+{
+	uint64_t freq = read_cntfrq();
+	uint64_t ms = 0;
+	uint64_t d = 0;
+	uint32_t exceptions = cpu_spin_lock_xsave(&ree_time_lock);
+	bool ret = false;
+
+	d = barrier_read_counter_timer() - ree_time_base_cnt;
+	if (ree_time_valid && d < freq * CFG_REE_TIME_CACHE_MS / 1000) {
+		ms = ree_time_base_ms + d * 1000 / freq;
+		ree_time_from_ms(ms, time);
+		ret = true;
+	}
+
+	cpu_spin_unlock_xrestore(&ree_time_lock, exceptions);
+
+	return ret;
+}
+
+static void update_cached_ree_time(uint64_t cnt, const TEE_Time *time)
+{
+	uint32_t exceptions = cpu_spin_lock_xsave(&ree_time_lock);
+
+	ree_time_base_cnt = cnt;
+	ree_time_base_ms = ree_time_to_ms(time);
+	ree_time_valid = true;
+
+	cpu_spin_unlock_xrestore(&ree_time_lock, exceptions);
+}
+#else
+static bool get_cached_ree_time(TEE_Time *time __unused)
+{
+	return false;
+}
+
+static void update_cached_ree_time(uint64_t cnt __unused,
+				   const TEE_Time *time __unused)
+{
+}
+#endif
+
 /*
  * tee_time_get_ree_time(): this function implements the GP Internal API
  * function TEE_GetREETime()
@@ -50,17 +193,21 @@ void tee_time_wait(uint32_t milliseconds_delay)
  */
 TEE_Result tee_time_get_ree_time(TEE_Time *time)
 {
-	struct thread_param params = THREAD_PARAM_VALUE(OUT, 0, 0, 0);
 	TEE_Result res = TEE_SUCCESS;
+	uint64_t cnt = 0;
 
 	if (!time)
 		return TEE_ERROR_BAD_PARAMETERS;
 
-	res = thread_rpc_cmd(OPTEE_RPC_CMD_GET_TIME, 1, &params);
-	if (res == TEE_SUCCESS) {
-		time->seconds = params.u.value.a;
-		time->millis = params.u.value.b / 1000000;
+	if (IS_ENABLED(CFG_REE_TIME_CACHE)) {
+		if (get_cached_ree_time(time))
+			return TEE_SUCCESS;
+		cnt = barrier_read_counter_timer();
 	}
 
+	res = rpc_get_ree_time(time);
+	if (res == TEE_SUCCESS)
+		update_cached_ree_time(cnt, time);
+
 	return res;
 }
@@ -7,14 +7,18 @@
 
 #include <config.h>
 #include <crypto/crypto.h>
+#include <initcall.h>
 #include <kernel/asan.h>
 #include <kernel/boot.h>
+#include <kernel/delay.h>
 #include <kernel/lockdep.h>
 #include <kernel/misc.h>
+#include <kernel/notif.h>
 #include <kernel/panic.h>
 #include <kernel/spinlock.h>
 #include <kernel/thread.h>
 #include <kernel/thread_private.h>
+#include <malloc.h>
 #include <mm/mobj.h>
 
 struct thread_ctx threads[CFG_NUM_THREADS];
@@ -51,8 +55,31 @@ linkage uint32_t name[num_stacks] \
 DECLARE_STACK(stack_tmp, CFG_TEE_CORE_NB_CORE, STACK_TMP_SIZE,
 	      /* global linkage */);
 DECLARE_STACK(stack_abt, CFG_TEE_CORE_NB_CORE, STACK_ABT_SIZE, static);
+/*
+ * With CFG_DYN_THREAD_STACKS only the first threads have a stack from
+ * boot, the others get one from the heap when needed.
+ */
+#ifdef CFG_DYN_THREAD_STACKS
+#define NUM_STATIC_THREAD_STACKS	CFG_NUM_STATIC_THREADS
+#else
+#define NUM_STATIC_THREAD_STACKS	CFG_NUM_THREADS
+#endif
+
 #ifndef CFG_WITH_PAGER
-DECLARE_STACK(stack_thread, CFG_NUM_THREADS, STACK_THREAD_SIZE, static);
+DECLARE_STACK(stack_thread, NUM_STATIC_THREAD_STACKS, STACK_THREAD_SIZE,
+	      static);
+#endif
+
+#ifdef CFG_DYN_THREAD_STACKS
+/*
+ * A stack allocated from the heap has the same layout as an element of
+ * stack_thread[], DYN_STACK_BASE() gives the start of the allocation from
+ * the "bottom" stored in thread_ctx::stack_va_end.
+ */
+#define DYN_STACK_SIZE	ROUNDUP(STACK_THREAD_SIZE + STACK_CANARY_SIZE + \
+				STACK_CHECK_EXTRA, STACK_ALIGNMENT)
+#define DYN_STACK_BASE(va_end) \
+	((va_end) + STACK_CANARY_SIZE / 2 - DYN_STACK_SIZE)
 #endif
 
 #define GET_STACK_TOP_HARD(stack, n) \
@@ -73,6 +100,36 @@ DECLARE_KEEP_PAGER(stack_tmp_stride);
 
 static unsigned int thread_global_lock __nex_bss = SPINLOCK_UNLOCK;
 
+/*
+ * Set when a caller has been turned away since no thread was free,
+ * protected by thread_global_lock.
+ */
+static bool thread_limit_reached;
+/* Asynchronous notification value sent when a thread is freed again */
+static uint32_t thread_avail_notif_value;
+
+#if defined(CFG_DYN_THREAD_STACKS) && defined(CFG_WITH_STACK_CANARIES)
+static uint32_t *dyn_start_canary(vaddr_t va_end)
+{
+	return (uint32_t *)DYN_STACK_BASE(va_end);
+}
+
+static uint32_t *dyn_end_canary(vaddr_t va_end)
+{
+	return (uint32_t *)(DYN_STACK_BASE(va_end) + DYN_STACK_SIZE) - 1;
+}
+
+static void init_dyn_canaries(vaddr_t va_end)
+{
+	*dyn_start_canary(va_end) = start_canary_value;
+	*dyn_end_canary(va_end) = end_canary_value;
+}
+#elif defined(CFG_DYN_THREAD_STACKS)
+static void init_dyn_canaries(vaddr_t va_end __unused)
+{
+}
+#endif
+
 void thread_init_canaries(void)
 {
 #ifdef CFG_WITH_STACK_CANARIES
@@ -91,6 +148,13 @@ void thread_init_canaries(void)
 #if !defined(CFG_WITH_PAGER) && !defined(CFG_NS_VIRTUALIZATION)
 	INIT_CANARY(stack_thread);
 #endif
+#ifdef CFG_DYN_THREAD_STACKS
+	thread_lock_global();
+	for (n = NUM_STATIC_THREAD_STACKS; n < CFG_NUM_THREADS; n++)
+		if (threads[n].stack_va_end)
+			init_dyn_canaries(threads[n].stack_va_end);
+	thread_unlock_global();
+#endif
 #endif/*CFG_WITH_STACK_CANARIES*/
 }
 
@@ -126,6 +190,7 @@ void thread_check_canaries(void)
 {
 #ifdef CFG_WITH_STACK_CANARIES
 	uint32_t *canary = NULL;
+	vaddr_t __maybe_unused va_end = 0;
 	size_t n = 0;
 
 	for (n = 0; n < ARRAY_SIZE(stack_tmp); n++) {
@@ -155,6 +220,22 @@ void thread_check_canaries(void)
 			CANARY_DIED(stack_thread, end, n, canary);
 	}
 #endif
+#ifdef CFG_DYN_THREAD_STACKS
+	/* The lock keeps reclaim_idle_stack() from freeing a stack here */
+	thread_lock_global();
+	for (n = NUM_STATIC_THREAD_STACKS; n < CFG_NUM_THREADS; n++) {
+		va_end = threads[n].stack_va_end;
+		if (!va_end)
+			continue;
+		canary = dyn_start_canary(va_end);
+		if (*canary != start_canary_value)
+			CANARY_DIED(dyn_stack_thread, start, n, canary);
+		canary = dyn_end_canary(va_end);
+		if (*canary != end_canary_value)
+			CANARY_DIED(dyn_stack_thread, end, n, canary);
+	}
+	thread_unlock_global();
+#endif
 #endif/*CFG_WITH_STACK_CANARIES*/
 }
 
@@ -168,6 +249,144 @@ void thread_unlock_global(void)
 	cpu_spin_unlock(&thread_global_lock);
 }
 
+#ifdef CFG_DYN_THREAD_STACKS
+static bool alloc_thread_stack(size_t n)
+{
+	void *p = memalign(STACK_ALIGNMENT, DYN_STACK_SIZE);
+	vaddr_t va_end = 0;
+
+	if (!p)
+		return false;
+
+	va_end = (vaddr_t)p + DYN_STACK_SIZE - STACK_CANARY_SIZE / 2;
+
+	/*
+	 * Publish the stack with the canaries in place, the lock serializes
+	 * with thread_check_canaries() and thread_init_canaries().
+	 */
+	thread_lock_global();
+	init_dyn_canaries(va_end);
+	threads[n].stack_va_end = va_end;
+	thread_unlock_global();
+
+	return true;
+}
+
+/*
+ * Called with the global thread lock held, returns the stack of a thread
+ * which has been idle for long enough to be freed or NULL.
+ */
+static void *reclaim_idle_stack(void)
+{
+	void *p = NULL;
+	size_t n = 0;
+
+	for (n = NUM_STATIC_THREAD_STACKS; n < CFG_NUM_THREADS; n++) {
+		if (threads[n].state == THREAD_STATE_FREE &&
+		    threads[n].stack_va_end &&
+		    timeout_elapsed(threads[n].idle_timeout)) {
+			p = (void *)DYN_STACK_BASE(threads[n].stack_va_end);
+			threads[n].stack_va_end = 0;
+			break;
+		}
+	}
+
+	return p;
+}
+#else
+static bool alloc_thread_stack(size_t n __unused)
+{
+	return false;
+}
+
+static void *reclaim_idle_stack(void)
+{
+	return NULL;
+}
+#endif
+
+int thread_claim_free_ctx(void)
+{
+	void *idle_stack = NULL;
+	bool need_stack = false;
+	int ct = THREAD_ID_INVALID;
+	size_t n = 0;
+
+	thread_lock_global();
+
+	/* Prefer a free thread which already has a stack */
+	for (n = 0; n < CFG_NUM_THREADS; n++) {
+		if (threads[n].state != THREAD_STATE_FREE)
+			continue;
+		if (threads[n].stack_va_end) {
+			ct = n;
+			break;
+		}
+		if (ct == THREAD_ID_INVALID)
+			ct = n;
+	}
+
+	if (ct == THREAD_ID_INVALID) {
+		thread_limit_reached = true;
+	} else {
+		threads[ct].state = THREAD_STATE_ACTIVE;
+		need_stack = !threads[ct].stack_va_end;
+	}
+
+	if (!need_stack)
+		idle_stack = reclaim_idle_stack();
+
+	thread_unlock_global();
+
+	free(idle_stack);
+
+	if (need_stack && !alloc_thread_stack(ct)) {
+		thread_lock_global();
+		threads[ct].state = THREAD_STATE_FREE;
+		thread_limit_reached = true;
+		thread_unlock_global();
+		return THREAD_ID_INVALID;
+	}
+
+	return ct;
+}
+
+void thread_release_ctx(int ct)
+{
+	assert(threads[ct].state == THREAD_STATE_ACTIVE);
+	threads[ct].state = THREAD_STATE_FREE;
+	threads[ct].flags = 0;
+#ifdef CFG_DYN_THREAD_STACKS
+	threads[ct].idle_timeout =
+		timeout_init_us(CFG_DYN_THREAD_STACK_IDLE_MS * 1000);
+#endif
+
+	if (thread_limit_reached) {
+		thread_limit_reached = false;
+		if (thread_avail_notif_value)
+			notif_send_async(thread_avail_notif_value);
+	}
+}
+
+uint32_t thread_get_avail_notif_value(void)
+{
+	return thread_avail_notif_value;
+}
+
+#if defined(CFG_CORE_ASYNC_NOTIF)
+static TEE_Result init_thread_avail_notif(void)
+{
+	uint32_t value = 0;
+
+	/* Normal world will have to retry as usual if this fails */
+	if (!notif_alloc_async_value(&value))
+		thread_avail_notif_value = value;
+
+	return TEE_SUCCESS;
+}
+service_init(init_thread_avail_notif);
+#endif
+
 static struct thread_core_local * __nostackcheck
 get_core_local(unsigned int pos)
 {
@@ -208,6 +427,9 @@ static void print_stack_limits(void)
 	}
 	for (n = 0; n < CFG_NUM_THREADS; n++) {
 		end = threads[n].stack_va_end;
+		/* No stack allocated for this thread yet */
+		if (!end)
+			continue;
 		start = end - STACK_THREAD_SIZE + STACK_CHECK_EXTRA;
 		DMSG("thr [%zu] 0x%" PRIxVA "..0x%" PRIxVA, n, start, end);
 	}
@@ -454,8 +676,12 @@ static void init_thread_stacks(void)
 {
 	size_t n;
 
+	/* Thread 0 is used as boot thread and needs a stack */
+	static_assert(NUM_STATIC_THREAD_STACKS > 0 &&
+		      NUM_STATIC_THREAD_STACKS <= CFG_NUM_THREADS);
+
 	/* Assign the thread stacks */
-	for (n = 0; n < CFG_NUM_THREADS; n++) {
+	for (n = 0; n < NUM_STATIC_THREAD_STACKS; n++) {
 		if (!thread_init_stack(n, GET_STACK_BOTTOM(stack_thread, n)))
 			panic("thread_init_stack failed");
 	}
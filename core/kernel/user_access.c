@@ -127,23 +127,47 @@ static void maybe_untag_bb(void *buf, size_t sz)
 	}
 }
 
+/*
+ * Returns the bounce buffer of the calling thread and its offset. Threads
+ * executing concurrently in a TA have one bounce buffer each.
+ */
+static uint8_t *get_bbuf(struct user_mode_ctx *uctx, size_t **offs)
+{
+#if defined(CFG_CONCURRENT_USER_TA)
+	if (uctx->thread_bbuf_offs) {
+		size_t n = thread_get_id();
+
+		*offs = uctx->thread_bbuf_offs + n;
+		return uctx->bbuf + n * uctx->bbuf_size;
+	}
+#endif
+	*offs = &uctx->bbuf_offs;
+	return uctx->bbuf;
+}
+
 void *bb_alloc(size_t len)
 {
 	struct user_mode_ctx *uctx = get_current_uctx();
+	size_t *bbuf_offs = NULL;
+	uint8_t *bbuf = NULL;
 	size_t offs = 0;
 	void *bb = NULL;
 
-	if (uctx && !ADD_OVERFLOW(uctx->bbuf_offs, len, &offs) &&
-	    offs <= uctx->bbuf_size) {
-		bb = maybe_tag_bb(uctx->bbuf + uctx->bbuf_offs, len);
-		uctx->bbuf_offs = ROUNDUP(offs, BB_ALIGNMENT);
+	if (!uctx)
+		return NULL;
+
+	bbuf = get_bbuf(uctx, &bbuf_offs);
+	if (!ADD_OVERFLOW(*bbuf_offs, len, &offs) && offs <= uctx->bbuf_size) {
+		bb = maybe_tag_bb(bbuf + *bbuf_offs, len);
+		*bbuf_offs = ROUNDUP(offs, BB_ALIGNMENT);
 	}
 	return bb;
 }
 
 static void bb_free_helper(struct user_mode_ctx *uctx, vaddr_t bb, size_t len)
 {
-	vaddr_t bbuf = (vaddr_t)uctx->bbuf;
+	size_t *bbuf_offs = NULL;
+	vaddr_t bbuf = (vaddr_t)get_bbuf(uctx, &bbuf_offs);
 
 	if (bb >= bbuf && IS_ALIGNED(bb, BB_ALIGNMENT)) {
 		size_t prev_offs = bb - bbuf;
@@ -154,8 +178,8 @@ static void bb_free_helper(struct user_mode_ctx *uctx, vaddr_t bb, size_t len)
 		 */
 		maybe_untag_bb((void *)bb, len);
 
-		if (prev_offs + ROUNDUP(len, BB_ALIGNMENT) == uctx->bbuf_offs)
-			uctx->bbuf_offs = prev_offs;
+		if (prev_offs + ROUNDUP(len, BB_ALIGNMENT) == *bbuf_offs)
+			*bbuf_offs = prev_offs;
 	}
 }
 
@@ -177,15 +201,18 @@ void bb_free_wipe(void *bb, size_t len)
 void bb_reset(void)
 {
 	struct user_mode_ctx *uctx = get_current_uctx();
+	size_t *bbuf_offs = NULL;
+	uint8_t *bbuf = NULL;
 
 	if (uctx) {
+		bbuf = get_bbuf(uctx, &bbuf_offs);
 		/*
 		 * Only the part up to the offset have been allocated, so
 		 * no need to clear tags beyond that.
 		 */
-		maybe_untag_bb(uctx->bbuf, uctx->bbuf_offs);
+		maybe_untag_bb(bbuf, *bbuf_offs);
 
-		uctx->bbuf_offs = 0;
+		*bbuf_offs = 0;
 	}
 }
 
@@ -150,6 +150,381 @@ static void dec_recursion(void)
 	tsd->syscall_recursion--;
 }
 
+#ifdef CFG_CONCURRENT_USER_TA
+static bool is_concurrent(struct user_ta_ctx *utc)
+{
+	return utc->ta_ctx.flags & TA_FLAG_CONCURRENT;
+}
+
+static void user_ta_lock(struct user_ta_ctx *utc)
+{
+	if (!is_concurrent(utc))
+		return;
+
+	mutex_lock(&utc->lock);
+	utc->lock_thread = thread_get_id();
+}
+
+static void user_ta_unlock(struct user_ta_ctx *utc)
+{
+	if (!is_concurrent(utc))
+		return;
+
+	assert(utc->lock_thread == thread_get_id());
+	utc->lock_thread = THREAD_ID_INVALID;
+	mutex_unlock(&utc->lock);
+}
+
+void user_ta_vm_lock_shared(struct user_ta_ctx *utc)
+{
+	if (is_concurrent(utc))
+		rwlock_read_lock(&utc->vm_lock);
+}
+
+void user_ta_vm_unlock_shared(struct user_ta_ctx *utc)
+{
+	if (is_concurrent(utc))
+		rwlock_read_unlock(&utc->vm_lock);
+}
+
+void user_ta_vm_lock(struct user_ta_ctx *utc)
+{
+	if (!is_concurrent(utc))
+		return;
+
+	rwlock_write_lock(&utc->vm_lock);
+	utc->vm_lock_thread = thread_get_id();
+}
+
+void user_ta_vm_unlock(struct user_ta_ctx *utc)
+{
+	if (!is_concurrent(utc))
+		return;
+
+	assert(utc->vm_lock_thread == thread_get_id());
+	utc->vm_lock_thread = THREAD_ID_INVALID;
+	rwlock_write_unlock(&utc->vm_lock);
+}
+
+void user_ta_obj_lock(struct user_ta_ctx *utc)
+{
+	if (is_concurrent(utc))
+		mutex_lock(&utc->obj_lock);
+}
+
+void user_ta_obj_unlock(struct user_ta_ctx *utc)
+{
+	if (is_concurrent(utc))
+		mutex_unlock(&utc->obj_lock);
+}
+
+/*
+ * struct user_ta_lock_waiter - thread sleeping in user_ta_lock_wait()
+ * @uaddr:	User address of the lock word
+ * @woken:	Set when removed from the list by user_ta_lock_wake() or
+ *		wake_all_lock_waiters()
+ * @cv:		Signalled when @woken is set
+ * @link:	Link in the list of waiters
+ */
+struct user_ta_lock_waiter {
+	vaddr_t uaddr;
+	bool woken;
+	struct condvar cv;
+	TAILQ_ENTRY(user_ta_lock_waiter) link;
+};
+
+TEE_Result user_ta_lock_wait(struct user_ta_ctx *utc, vaddr_t uaddr,
+			     uint32_t val)
+{
+	struct user_ta_lock_waiter w = { .uaddr = uaddr };
+	TEE_Result res = TEE_SUCCESS;
+	uint32_t v = 0;
+
+	if (!is_concurrent(utc))
+		return TEE_ERROR_BAD_STATE;
+	if (!IS_ALIGNED(uaddr, sizeof(v)))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	mutex_lock(&utc->lock_wait_mu);
+
+	/* Don't sleep in a TA which won't wake us up */
+	if (utc->ta_ctx.panicked) {
+		res = TEE_ERROR_TARGET_DEAD;
+		goto out;
+	}
+
+	user_ta_vm_lock_shared(utc);
+	res = copy_from_user(&v, (void *)uaddr, sizeof(v));
+	user_ta_vm_unlock_shared(utc);
+	if (res || v != val)
+		goto out;
+
+	condvar_init(&w.cv);
+	TAILQ_INSERT_TAIL(&utc->lock_waiters, &w, link);
+	while (!w.woken && !utc->ta_ctx.panicked)
+		condvar_wait(&w.cv, &utc->lock_wait_mu);
+	if (!w.woken)
+		TAILQ_REMOVE(&utc->lock_waiters, &w, link);
+	condvar_destroy(&w.cv);
+	if (utc->ta_ctx.panicked)
+		res = TEE_ERROR_TARGET_DEAD;
+out:
+	mutex_unlock(&utc->lock_wait_mu);
+
+	return res;
+}
+
+TEE_Result user_ta_lock_wake(struct user_ta_ctx *utc, vaddr_t uaddr,
+			     size_t count)
+{
+	struct user_ta_lock_waiter *next = NULL;
+	struct user_ta_lock_waiter *w = NULL;
+
+	if (!is_concurrent(utc))
+		return TEE_ERROR_BAD_STATE;
+
+	mutex_lock(&utc->lock_wait_mu);
+	TAILQ_FOREACH_SAFE(w, &utc->lock_waiters, link, next) {
+		if (!count)
+			break;
+		if (w->uaddr != uaddr)
+			continue;
+		TAILQ_REMOVE(&utc->lock_waiters, w, link);
+		w->woken = true;
+		condvar_signal(&w->cv);
+		count--;
+	}
+	mutex_unlock(&utc->lock_wait_mu);
+
+	return TEE_SUCCESS;
+}
+
+/*
+ * Called when the TA has panicked since no thread will release the locks
+ * in user mode any longer. The woken threads leave the TA at their next
+ * system call.
+ */
+static void wake_all_lock_waiters(struct user_ta_ctx *utc)
+{
+	struct user_ta_lock_waiter *w = NULL;
+
+	if (!is_concurrent(utc))
+		return;
+
+	mutex_lock(&utc->lock_wait_mu);
+	while (!TAILQ_EMPTY(&utc->lock_waiters)) {
+		w = TAILQ_FIRST(&utc->lock_waiters);
+		TAILQ_REMOVE(&utc->lock_waiters, w, link);
+		w->woken = true;
+		condvar_signal(&w->cv);
+	}
+	mutex_unlock(&utc->lock_wait_mu);
+}
+
+/*
+ * Only the exclusive owner of vm_lock can see its own thread ID in
+ * vm_lock_thread so it's safe to check without holding the lock.
+ */
+static bool is_locked_by_me(struct user_ta_ctx *utc)
+{
+	return is_concurrent(utc) && utc->vm_lock_thread == thread_get_id();
+}
+
+/* Called with the lock held, returns with the lock held */
+static void wait_for_entries(struct user_ta_ctx *utc)
+{
+	if (!is_concurrent(utc))
+		return;
+
+	while (utc->entry_count) {
+		utc->lock_thread = THREAD_ID_INVALID;
+		condvar_wait(&utc->entry_cv, &utc->lock);
+		utc->lock_thread = thread_get_id();
+	}
+}
+
+/*
+ * Called with vm_lock held exclusively and the lock held, returns with
+ * both released
+ */
+static void entry_begin(struct user_ta_ctx *utc)
+{
+	if (!is_concurrent(utc))
+		return;
+
+	utc->entry_count++;
+	user_ta_unlock(utc);
+	user_ta_vm_unlock(utc);
+}
+
+/*
+ * Called with vm_lock and the lock released, returns with vm_lock held
+ * exclusively and the lock held
+ */
+static void entry_end(struct user_ta_ctx *utc)
+{
+	if (!is_concurrent(utc))
+		return;
+
+	user_ta_vm_lock(utc);
+	user_ta_lock(utc);
+	assert(utc->entry_count);
+	utc->entry_count--;
+	if (!utc->entry_count)
+		condvar_broadcast(&utc->entry_cv);
+}
+
+static TEE_Result alloc_stack(struct user_ta_ctx *utc,
+			      struct user_ta_stack **stack)
+{
+	size_t sz = utc->uctx.stack_size;
+	TEE_Result res = TEE_SUCCESS;
+	struct user_ta_stack *s = NULL;
+	struct mobj *mobj = NULL;
+	struct fobj *f = NULL;
+	vaddr_t va = 0;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	f = fobj_ta_mem_alloc(ROUNDUP_DIV(sz, SMALL_PAGE_SIZE));
+	if (!f) {
+		res = TEE_ERROR_OUT_OF_MEMORY;
+		goto err;
+	}
+	mobj = mobj_with_fobj_alloc(f, NULL, TEE_MATTR_MEM_TYPE_TAGGED);
+	fobj_put(f);
+	if (!mobj) {
+		res = TEE_ERROR_OUT_OF_MEMORY;
+		goto err;
+	}
+	res = vm_map(&utc->uctx, &va, sz, TEE_MATTR_URW | TEE_MATTR_PRW, 0,
+		     mobj, 0);
+	mobj_put(mobj);
+	if (res)
+		goto err;
+
+	s->top = va + sz;
+	*stack = s;
+	return TEE_SUCCESS;
+err:
+	free(s);
+	return res;
+}
+
+/*
+ * The first thread entering the TA uses the stack set up by ldelf, each
+ * additional thread entering concurrently needs a stack of its own. Those
+ * stacks are kept mapped until the TA context is released.
+ */
+static TEE_Result get_stack(struct user_ta_ctx *utc,
+			    struct user_ta_stack **stack, vaddr_t *stack_top)
+{
+	TEE_Result res = TEE_SUCCESS;
+	struct user_ta_stack *s = NULL;
+
+	*stack = NULL;
+	if (!is_concurrent(utc) || !utc->stack_in_use) {
+		utc->stack_in_use = true;
+		*stack_top = utc->uctx.stack_ptr;
+		return TEE_SUCCESS;
+	}
+
+	s = SLIST_FIRST(&utc->free_stacks);
+	if (s) {
+		SLIST_REMOVE_HEAD(&utc->free_stacks, link);
+	} else {
+		res = alloc_stack(utc, &s);
+		if (res)
+			return res;
+	}
+
+	*stack = s;
+	*stack_top = s->top;
+	return TEE_SUCCESS;
+}
+
+static void put_stack(struct user_ta_ctx *utc, struct user_ta_stack *stack)
+{
+	if (stack)
+		SLIST_INSERT_HEAD(&utc->free_stacks, stack, link);
+	else
+		utc->stack_in_use = false;
+}
+
+static void free_stacks(struct user_ta_ctx *utc)
+{
+	struct user_ta_stack *s = NULL;
+
+	while (!SLIST_EMPTY(&utc->free_stacks)) {
+		s = SLIST_FIRST(&utc->free_stacks);
+		SLIST_REMOVE_HEAD(&utc->free_stacks, link);
+		free(s);
+	}
+}
+#else
+struct user_ta_stack;
+
+static void user_ta_lock(struct user_ta_ctx *utc __unused)
+{
+}
+
+static void user_ta_unlock(struct user_ta_ctx *utc __unused)
+{
+}
+
+static bool is_locked_by_me(struct user_ta_ctx *utc __unused)
+{
+	return false;
+}
+
+static void wait_for_entries(struct user_ta_ctx *utc __unused)
+{
+}
+
+static void wake_all_lock_waiters(struct user_ta_ctx *utc __unused)
+{
+}
+
+static void entry_begin(struct user_ta_ctx *utc __unused)
+{
+}
+
+static void entry_end(struct user_ta_ctx *utc __unused)
+{
+}
+
+static TEE_Result get_stack(struct user_ta_ctx *utc,
+			    struct user_ta_stack **stack, vaddr_t *stack_top)
+{
+	*stack = NULL;
+	*stack_top = utc->uctx.stack_ptr;
+	return TEE_SUCCESS;
+}
+
+static void put_stack(struct user_ta_ctx *utc __unused,
+		      struct user_ta_stack *stack __unused)
+{
+}
+
+static void free_stacks(struct user_ta_ctx *utc __unused)
+{
+}
+#endif /*CFG_CONCURRENT_USER_TA*/
+
+/*
+ * The parameter mappings of a TA which isn't executing several sessions
+ * concurrently may be parked until the next entry, see vm_park_param().
+ */
+static void clean_param(struct user_ta_ctx *utc)
+{
+	if (utc->ta_ctx.flags & TA_FLAG_CONCURRENT)
+		vm_clean_param(&utc->uctx);
+	else
+		vm_park_param(&utc->uctx);
+}
+
 static TEE_Result user_ta_enter(struct ts_session *session,
 				enum utee_entry_func func, uint32_t cmd)
 {
@@ -160,24 +535,43 @@ static TEE_Result user_ta_enter(struct ts_session *session,
 	struct tee_ta_session *ta_sess = to_ta_session(session);
 	struct ts_session *ts_sess __maybe_unused = NULL;
 	void *param_va[TEE_NUM_PARAMS] = { NULL };
+	struct user_ta_stack *stack = NULL;
+	uint32_t panicked = 0;
+	uint32_t panic_code = 0;
 
 	if (!inc_recursion()) {
 		/* Using this error code since we've run out of resources. */
 		res = TEE_ERROR_OUT_OF_MEMORY;
 		goto out_clr_cancel;
 	}
+	/*
+	 * A concurrent TA calling itself via a pseudo TA would wait for the
+	 * address space lock it's already holding in the system call.
+	 */
+	if (is_locked_by_me(utc)) {
+		res = TEE_ERROR_BUSY;
+		goto out;
+	}
+	user_ta_vm_lock(utc);
+	user_ta_lock(utc);
+
+	res = get_stack(utc, &stack, &usr_stack);
+	if (res)
+		goto out_unlock;
+
 	if (ta_sess->param) {
 		/* Map user space memory */
 		res = vm_map_param(&utc->uctx, ta_sess->param, param_va);
 		if (res != TEE_SUCCESS)
-			goto out;
+			goto out_put_stack;
+	} else {
+		vm_clean_parked_param(&utc->uctx);
 	}
 
 	/* Switch to user ctx */
 	ts_push_current_session(session);
 
 	/* Make room for usr_params at top of stack */
-	usr_stack = utc->uctx.stack_ptr;
 	usr_stack -= ROUNDUP(sizeof(struct utee_params), STACK_ALIGNMENT);
 	usr_params = (struct utee_params *)usr_stack;
 	if (ta_sess->param)
@@ -188,18 +582,26 @@ static TEE_Result user_ta_enter(struct ts_session *session,
 	if (res)
 		goto out_pop_session;
 
+	entry_begin(utc);
 	res = thread_enter_user_mode(func, kaddr_to_uref(session),
 				     (vaddr_t)usr_params, cmd, usr_stack,
 				     utc->uctx.entry_func, utc->uctx.is_32bit,
-				     &utc->ta_ctx.panicked,
-				     &utc->ta_ctx.panic_code);
+				     &panicked, &panic_code);
+	entry_end(utc);
 
 	thread_user_clear_vfp(&utc->uctx);
 
-	if (utc->ta_ctx.panicked) {
+	/*
+	 * With TA_FLAG_CONCURRENT another thread may return normally from
+	 * the TA after this one so the panic state must only be set, never
+	 * cleared.
+	 */
+	if (panicked) {
+		utc->ta_ctx.panicked = panicked;
+		utc->ta_ctx.panic_code = panic_code;
 		abort_print_current_ts();
 		DMSG("tee_user_ta_enter: TA panicked with code 0x%x",
-		     utc->ta_ctx.panic_code);
+		     panic_code);
 		res = TEE_ERROR_TARGET_DEAD;
 	} else {
 		/*
@@ -218,13 +620,20 @@ out_pop_session:
 	if (ta_sess->param) {
 		/*
 		 * Clear out the parameter mappings added with
-		 * vm_clean_param() above.
+		 * vm_map_param() above.
 		 */
-		vm_clean_param(&utc->uctx);
+		clean_param(utc);
 	}
 	ts_sess = ts_pop_current_session();
 	assert(ts_sess == session);
-
+out_put_stack:
+	put_stack(utc, stack);
+out_unlock:
+	user_ta_unlock(utc);
+	user_ta_vm_unlock(utc);
+	/* @lock_wait_mu is taken before the locks above */
+	if (panicked)
+		wake_all_lock_waiters(utc);
 out:
 	dec_recursion();
 out_clr_cancel:
@@ -303,9 +712,11 @@ static void user_ta_dump_ftrace(struct ts_ctx *ctx)
 	size_t blen = 0, ld_addr_len = 0;
 	vaddr_t va = 0;
 
+	user_ta_vm_lock(utc);
+
 	res = ldelf_dump_ftrace(&utc->uctx, NULL, &blen);
 	if (res != TEE_ERROR_SHORT_BUFFER)
-		return;
+		goto out_unlock;
 
 #define LOAD_ADDR_DUMP_SIZE	64
 	pl_sz = ROUNDUP(blen + sizeof(TEE_UUID) + LOAD_ADDR_DUMP_SIZE,
@@ -314,7 +725,7 @@ static void user_ta_dump_ftrace(struct ts_ctx *ctx)
 	mobj = thread_rpc_alloc_payload(pl_sz);
 	if (!mobj) {
 		EMSG("Ftrace thread_rpc_alloc_payload failed");
-		return;
+		goto out_unlock;
 	}
 
 	buf = mobj_get_va(mobj, 0, pl_sz);
@@ -355,6 +766,8 @@ out_unmap_pl:
 	assert(!res);
 out_free_pl:
 	thread_rpc_free_payload(mobj);
+out_unlock:
+	user_ta_vm_unlock(utc);
 }
 #endif /*CFG_FTRACE_SUPPORT*/
 
@@ -394,12 +807,28 @@ static void release_utc_state(struct user_ta_ctx *utc)
 static void free_utc(struct user_ta_ctx *utc)
 {
 	release_utc_state(utc);
+	free_stacks(utc);
+#if defined(CFG_CONCURRENT_USER_TA) && defined(CFG_WITH_VFP)
+	free(utc->uctx.thread_vfp);
+#endif
+#if defined(CFG_CONCURRENT_USER_TA)
+	free(utc->uctx.thread_bbuf_offs);
+#endif
 	free(utc);
 }
 
 static void user_ta_release_state(struct ts_ctx *ctx)
 {
-	release_utc_state(to_user_ta_ctx(ctx));
+	struct user_ta_ctx *utc = to_user_ta_ctx(ctx);
+
+	/*
+	 * A panicked TA_FLAG_CONCURRENT TA may still have other threads
+	 * executing in it, those leave at their next system call.
+	 */
+	user_ta_lock(utc);
+	wait_for_entries(utc);
+	release_utc_state(utc);
+	user_ta_unlock(utc);
 }
 
 static void user_ta_ctx_destroy(struct ts_ctx *ctx)
@@ -473,6 +902,17 @@ TEE_Result tee_ta_init_user_ta_session(const TEE_UUID *uuid,
 	TAILQ_INIT(&utc->storage_enums);
 	condvar_init(&utc->ta_ctx.busy_cv);
 	utc->ta_ctx.ref_count = 1;
+#ifdef CFG_CONCURRENT_USER_TA
+	rwlock_init(&utc->vm_lock);
+	utc->vm_lock_thread = THREAD_ID_INVALID;
+	mutex_init(&utc->obj_lock);
+	mutex_init(&utc->lock);
+	utc->lock_thread = THREAD_ID_INVALID;
+	condvar_init(&utc->entry_cv);
+	SLIST_INIT(&utc->free_stacks);
+	mutex_init(&utc->lock_wait_mu);
+	TAILQ_INIT(&utc->lock_waiters);
+#endif
 
 	/*
 	 * Set context TA operation structure. It is required by generic
@@ -498,7 +938,7 @@ TEE_Result tee_ta_init_user_ta_session(const TEE_UUID *uuid,
 	 * until this context is fully initialized. This is needed to
 	 * handle single instance TAs.
 	 */
-	TAILQ_INSERT_TAIL(&tee_ctxes, &utc->ta_ctx, link);
+	tee_ta_register_ctx(&utc->ta_ctx);
 	mutex_unlock(&tee_ta_mutex);
 
 	/*
@@ -510,6 +950,8 @@ TEE_Result tee_ta_init_user_ta_session(const TEE_UUID *uuid,
 	res = ldelf_load_ldelf(&utc->uctx);
 	if (!res)
 		res = ldelf_init_with_ldelf(&s->ts_sess, &utc->uctx);
+	if (!res)
+		res = vm_map_time_page(&utc->uctx);
 
 	ts_pop_current_session();
 
@@ -519,7 +961,7 @@ TEE_Result tee_ta_init_user_ta_session(const TEE_UUID *uuid,
 		utc->uctx.is_initializing = false;
 	} else {
 		s->ts_sess.ctx = NULL;
-		TAILQ_REMOVE(&tee_ctxes, &utc->ta_ctx, link);
+		tee_ta_unregister_ctx(&utc->ta_ctx);
 	}
 
 	/* The state has changed for the context, notify eventual waiters. */
@@ -3,6 +3,7 @@
  * Copyright (c) 2015-2021, Linaro Limited
  */
 
+#include <assert.h>
 #include <compiler.h>
 #include <kernel/notif.h>
 #include <kernel/spinlock.h>
@@ -40,18 +41,72 @@ static void do_notif(TEE_Result (*fn)(uint32_t), int id,
 		DMSG("%s thread %d res %#"PRIx32, cmd_str, id, res);
 }
 
-static void slist_add_tail(struct wait_queue *wq, struct wait_queue_elem *wqe)
+static void list_add_tail(struct wait_queue_list *l,
+			  struct wait_queue_elem *wqe)
 {
-	struct wait_queue_elem *wqe_iter;
-
-	/* Add elem to end of wait queue */
-	wqe_iter = SLIST_FIRST(wq);
-	if (wqe_iter) {
-		while (SLIST_NEXT(wqe_iter, link))
-			wqe_iter = SLIST_NEXT(wqe_iter, link);
-		SLIST_INSERT_AFTER(wqe_iter, wqe, link);
-	} else
-		SLIST_INSERT_HEAD(wq, wqe, link);
+	wqe->next = NULL;
+	if (l->last)
+		l->last->next = wqe;
+	else
+		l->first = wqe;
+	l->last = wqe;
+}
+
+/* Inserts @wqe in @l which is kept sorted on the sequence numbers */
+static void list_add_ordered(struct wait_queue_list *l,
+			     struct wait_queue_elem *wqe)
+{
+	struct wait_queue_elem *prev = NULL;
+	struct wait_queue_elem *e = l->first;
+
+	while (e && (int32_t)(e->seq - wqe->seq) < 0) {
+		prev = e;
+		e = e->next;
+	}
+
+	wqe->next = e;
+	if (prev)
+		prev->next = wqe;
+	else
+		l->first = wqe;
+	if (!e)
+		l->last = wqe;
+}
+
+static struct wait_queue_elem *list_rem_head(struct wait_queue_list *l)
+{
+	struct wait_queue_elem *wqe = l->first;
+
+	if (wqe) {
+		l->first = wqe->next;
+		if (!l->first)
+			l->last = NULL;
+		wqe->next = NULL;
+	}
+
+	return wqe;
+}
+
+static void list_rem_next(struct wait_queue_list *l,
+			  struct wait_queue_elem *prev,
+			  struct wait_queue_elem *wqe)
+{
+	if (prev)
+		prev->next = wqe->next;
+	else
+		l->first = wqe->next;
+	if (l->last == wqe)
+		l->last = prev;
+	wqe->next = NULL;
+}
+
+/* Returns the active waiter list for @wqe, wq_spin_lock must be held */
+static struct wait_queue_list *active_list(struct wait_queue *wq,
+					   struct wait_queue_elem *wqe)
+{
+	if (wqe->wait_read)
+		return &wq->readers;
+	return &wq->writers;
 }
 
 void wq_wait_init_condvar(struct wait_queue *wq, struct wait_queue_elem *wqe,
@@ -66,7 +121,16 @@ void wq_wait_init_condvar(struct wait_queue *wq, struct wait_queue_elem *wqe,
 
 	old_itr_status = cpu_spin_lock_xsave(&wq_spin_lock);
 
-	slist_add_tail(wq, wqe);
+	/*
+	 * Condvar waiters get their sequence number now too so that they
+	 * keep their position among the active waiters when promoted.
+	 */
+	wqe->seq = wq->seq++;
+	if (cv)
+		list_add_tail(&wq->condvar, wqe);
+	else
+		list_add_tail(active_list(wq, wqe), wqe);
+	wq->num_elems++;
 
 	cpu_spin_unlock_xrestore(&wq_spin_lock, old_itr_status);
 }
@@ -83,9 +147,13 @@ void wq_wait_final(struct wait_queue *wq, struct wait_queue_elem *wqe,
 
 		old_itr_status = cpu_spin_lock_xsave(&wq_spin_lock);
 
+		/* The element was removed from the lists when woken up */
 		done = wqe->done;
-		if (done)
-			SLIST_REMOVE(wq, wqe, wait_queue_elem, link);
+		if (done) {
+			assert(wq->num_elems && wq->num_woken);
+			wq->num_elems--;
+			wq->num_woken--;
+		}
 
 		cpu_spin_unlock_xrestore(&wq_spin_lock, old_itr_status);
 	} while (!done);
@@ -96,48 +164,45 @@ void wq_wake_next(struct wait_queue *wq, const void *sync_obj,
 {
 	uint32_t old_itr_status;
 	struct wait_queue_elem *wqe;
+	struct wait_queue_elem *r;
+	struct wait_queue_elem *w;
 	int handle = -1;
-	bool do_wakeup = false;
 	bool wake_type_assigned = false;
 	bool wake_read = false; /* avoid gcc warning */
 
 	/*
-	 * If next type is wait_read wakeup all wqe with wait_read true.
-	 * If next type isn't wait_read wakeup only the first wqe which isn't
-	 * done.
+	 * If the oldest active waiter is wait_read wakeup all wqe with
+	 * wait_read true. If it isn't wait_read wakeup only that wqe.
 	 */
 
 	while (true) {
 		old_itr_status = cpu_spin_lock_xsave(&wq_spin_lock);
 
-		SLIST_FOREACH(wqe, wq, link) {
-			if (wqe->cv)
-				continue;
-			if (wqe->done)
-				continue;
-			if (!wake_type_assigned) {
-				wake_read = wqe->wait_read;
-				wake_type_assigned = true;
-			}
-
-			if (wqe->wait_read != wake_read)
-				continue;
+		if (!wake_type_assigned) {
+			r = wq->readers.first;
+			w = wq->writers.first;
+			wake_read = r && (!w || (int32_t)(r->seq - w->seq) < 0);
+			wake_type_assigned = true;
+		}
 
+		if (wake_read)
+			wqe = list_rem_head(&wq->readers);
+		else
+			wqe = list_rem_head(&wq->writers);
+		if (wqe) {
 			wqe->done = true;
+			wq->num_woken++;
 			handle = wqe->handle;
-			do_wakeup = true;
-			break;
 		}
 
 		cpu_spin_unlock_xrestore(&wq_spin_lock, old_itr_status);
 
-		if (do_wakeup)
+		if (wqe)
 			do_notif(notif_send_sync, handle,
 				 "wake ", sync_obj, fname, lineno);
 
-		if (!do_wakeup || !wake_read)
+		if (!wqe || !wake_read)
 			break;
-		do_wakeup = false;
 	}
 }
 
@@ -147,6 +212,8 @@ void wq_promote_condvar(struct wait_queue *wq, struct condvar *cv,
 {
 	uint32_t old_itr_status;
 	struct wait_queue_elem *wqe;
+	struct wait_queue_elem *prev = NULL;
+	struct wait_queue_elem *next = NULL;
 
 	if (!cv)
 		return;
@@ -156,22 +223,28 @@ void wq_promote_condvar(struct wait_queue *wq, struct condvar *cv,
 	/*
 	 * Find condvar waiter(s) and promote each to an active waiter.
 	 * This is a bit unfair to eventual other active waiters as a
-	 * condvar waiter is added to the queue when waiting for the
-	 * condvar.
+	 * condvar waiter keeps the position it got when it started to wait
+	 * for the condvar.
 	 */
-	SLIST_FOREACH(wqe, wq, link) {
-		if (wqe->cv == cv) {
-			if (fname)
-				FMSG("promote thread %u %p %s:%d",
-				     wqe->handle, (void *)cv->m, fname, lineno);
-			else
-				FMSG("promote thread %u %p",
-				     wqe->handle, (void *)cv->m);
-
-			wqe->cv = NULL;
-			if (only_one)
-				break;
+	for (wqe = wq->condvar.first; wqe; wqe = next) {
+		next = wqe->next;
+		if (wqe->cv != cv) {
+			prev = wqe;
+			continue;
 		}
+
+		if (fname)
+			FMSG("promote thread %u %p %s:%d",
+			     wqe->handle, (void *)cv->m, fname, lineno);
+		else
+			FMSG("promote thread %u %p",
+			     wqe->handle, (void *)cv->m);
+
+		list_rem_next(&wq->condvar, prev, wqe);
+		wqe->cv = NULL;
+		list_add_ordered(active_list(wq, wqe), wqe);
+		if (only_one)
+			break;
 	}
 
 	cpu_spin_unlock_xrestore(&wq_spin_lock, old_itr_status);
@@ -185,7 +258,7 @@ bool wq_have_condvar(struct wait_queue *wq, struct condvar *cv)
 
 	old_itr_status = cpu_spin_lock_xsave(&wq_spin_lock);
 
-	SLIST_FOREACH(wqe, wq, link) {
+	for (wqe = wq->condvar.first; wqe; wqe = wqe->next) {
 		if (wqe->cv == cv) {
 			rc = true;
 			break;
@@ -204,7 +277,21 @@ bool wq_is_empty(struct wait_queue *wq)
 
 	old_itr_status = cpu_spin_lock_xsave(&wq_spin_lock);
 
-	ret = SLIST_EMPTY(wq);
+	ret = !wq->num_elems;
+
+	cpu_spin_unlock_xrestore(&wq_spin_lock, old_itr_status);
+
+	return ret;
+}
+
+bool wq_have_waiters(struct wait_queue *wq)
+{
+	uint32_t old_itr_status;
+	bool ret;
+
+	old_itr_status = cpu_spin_lock_xsave(&wq_spin_lock);
+
+	ret = wq->readers.first || wq->writers.first || wq->num_woken;
 
 	cpu_spin_unlock_xrestore(&wq_spin_lock, old_itr_status);
 
@@ -59,6 +59,47 @@ static struct tee_mmap_region static_memory_map[CFG_MMAP_REGIONS
 #endif
 						+ 1] __nex_bss;
 
+/*
+ * struct mmap_index - sorted index of static_memory_map
+ * @pa_count:	Number of entries in @by_type_pa
+ * @va_count:	Number of entries in @by_va
+ * @count:	Number of entries in @by_pa and @pa_max_end
+ * @by_type_pa:	Entries with a physical address sorted on type and address
+ * @by_va:	Entries sorted on virtual address
+ * @by_pa:	All entries sorted on physical address regardless of type
+ * @pa_max_end:	Highest last physical address of @by_pa[0] up to @by_pa[n]
+ *
+ * The index lets the address translations do binary searches instead of
+ * scanning the whole memory map. Entries are referred to by position in
+ * static_memory_map rather than by pointer since the index is created
+ * before the core may have been relocated.
+ *
+ * Entries of different types may overlap in physical memory, @pa_max_end
+ * lets a lookup in @by_pa stop as soon as no earlier entry can contain the
+ * address.
+ *
+ * The index is updated each time static_memory_map is changed.
+ * invalidate_mmap_index() sets mmap_index_sel to 0 before the memory map
+ * is changed, the new index is then created in the element of
+ * mmap_index_buf[] which wasn't published last and published by updating
+ * mmap_index_sel. While mmap_index_sel is 0 the lookups fall back to
+ * scanning the memory map.
+ */
+struct mmap_index {
+	size_t pa_count;
+	size_t va_count;
+	size_t count;
+	uint8_t by_type_pa[ARRAY_SIZE(static_memory_map)];
+	uint8_t by_va[ARRAY_SIZE(static_memory_map)];
+	uint8_t by_pa[ARRAY_SIZE(static_memory_map)];
+	paddr_t pa_max_end[ARRAY_SIZE(static_memory_map)];
+};
+
+static struct mmap_index mmap_index_buf[2] __nex_bss;
+static unsigned int mmap_index_sel __nex_bss;
+/* Element of mmap_index_buf[] published last, 1 or 2, 0 if none yet */
+static unsigned int mmap_index_last __nex_bss;
+
 /* Define the platform's memory layout. */
 struct memaccess_area {
 	paddr_t paddr;
@@ -235,6 +276,149 @@ static bool pbuf_inside_map_area(unsigned long p, size_t l,
 	return core_is_buffer_inside(p, l, map->pa, map->size);
 }
 
+static bool map_has_pa(const struct tee_mmap_region *map)
+{
+	switch (map->type) {
+	case MEM_AREA_RES_VASPACE:
+	case MEM_AREA_SHM_VASPACE:
+	case MEM_AREA_TS_VASPACE:
+	case MEM_AREA_PAGER_VASPACE:
+		return false;
+	default:
+		return true;
+	}
+}
+
+static bool map_type_pa_is_less(const struct tee_mmap_region *a,
+				const struct tee_mmap_region *b)
+{
+	if (a->type != b->type)
+		return a->type < b->type;
+	return a->pa < b->pa;
+}
+
+static void mmap_index_insert(uint8_t *idx, size_t n, uint8_t pos,
+			      bool (*is_less)(const struct tee_mmap_region *a,
+					      const struct tee_mmap_region *b))
+{
+	size_t i = n;
+
+	while (i && is_less(static_memory_map + pos,
+			    static_memory_map + idx[i - 1])) {
+		idx[i] = idx[i - 1];
+		i--;
+	}
+	idx[i] = pos;
+}
+
+static bool map_va_is_less(const struct tee_mmap_region *a,
+			   const struct tee_mmap_region *b)
+{
+	return a->va < b->va;
+}
+
+static bool map_pa_is_less(const struct tee_mmap_region *a,
+			   const struct tee_mmap_region *b)
+{
+	return a->pa < b->pa;
+}
+
+static bool mmap_index_is_sane(const struct mmap_index *idx)
+{
+	const struct tee_mmap_region *prev = NULL;
+	const struct tee_mmap_region *map = NULL;
+	size_t n = 0;
+
+	/*
+	 * The lookups only consider the closest entry so entries must not
+	 * overlap, in virtual memory or in physical memory within a type.
+	 */
+	for (n = 1; n < idx->pa_count; n++) {
+		prev = static_memory_map + idx->by_type_pa[n - 1];
+		map = static_memory_map + idx->by_type_pa[n];
+		if (prev->type == map->type &&
+		    map->pa - prev->pa < prev->size)
+			return false;
+	}
+	for (n = 1; n < idx->va_count; n++) {
+		prev = static_memory_map + idx->by_va[n - 1];
+		map = static_memory_map + idx->by_va[n];
+		if (map->va - prev->va < prev->size)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Must be called before static_memory_map is changed, the lookups scan
+ * the memory map until update_mmap_index() has published a new index.
+ */
+static void invalidate_mmap_index(void)
+{
+	__atomic_store_n(&mmap_index_sel, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Must be called each time static_memory_map has been updated. Updates
+ * are done by a single thread at a time, during boot or driver
+ * initialization.
+ */
+static void update_mmap_index(void)
+{
+	unsigned int sel = (mmap_index_last == 1) ? 2 : 1;
+	struct mmap_index *idx = mmap_index_buf + sel - 1;
+	struct tee_mmap_region *map = NULL;
+	paddr_t max_end = 0;
+	size_t n = 0;
+
+	COMPILE_TIME_ASSERT(ARRAY_SIZE(static_memory_map) <= UINT8_MAX);
+
+	invalidate_mmap_index();
+
+	idx->pa_count = 0;
+	idx->va_count = 0;
+	idx->count = 0;
+	for (n = 0; !core_mmap_is_end_of_table(static_memory_map + n); n++) {
+		if (!static_memory_map[n].size)
+			continue;
+		if (map_has_pa(static_memory_map + n))
+			mmap_index_insert(idx->by_type_pa, idx->pa_count++, n,
+					  map_type_pa_is_less);
+		mmap_index_insert(idx->by_va, idx->va_count++, n,
+				  map_va_is_less);
+		mmap_index_insert(idx->by_pa, idx->count++, n,
+				  map_pa_is_less);
+	}
+
+	for (n = 0; n < idx->count; n++) {
+		map = static_memory_map + idx->by_pa[n];
+		max_end = MAX(max_end, map->pa + map->size - 1);
+		idx->pa_max_end[n] = max_end;
+	}
+
+	if (!mmap_index_is_sane(idx))
+		return;
+
+	/* Publish the index once it's complete */
+	mmap_index_last = sel;
+	__atomic_store_n(&mmap_index_sel, sel, __ATOMIC_RELEASE);
+}
+
+static const struct mmap_index *get_mmap_index(void)
+{
+	unsigned int sel = 0;
+
+	if (get_memory_map() != static_memory_map)
+		return NULL;
+
+	sel = __atomic_load_n(&mmap_index_sel, __ATOMIC_ACQUIRE);
+	if (!sel)
+		return NULL;
+
+	return mmap_index_buf + sel - 1;
+}
+
 static struct tee_mmap_region *find_map_by_type(enum teecore_memtypes type)
 {
 	struct tee_mmap_region *map;
@@ -248,8 +432,33 @@ static struct tee_mmap_region *find_map_by_type(enum teecore_memtypes type)
 static struct tee_mmap_region *
 find_map_by_type_and_pa(enum teecore_memtypes type, paddr_t pa, size_t len)
 {
+	const struct mmap_index *idx = get_mmap_index();
 	struct tee_mmap_region *map;
 
+	if (idx) {
+		size_t lo = 0;
+		size_t hi = idx->pa_count;
+		size_t mid = 0;
+
+		/* Find the first entry sorted after (type, pa) */
+		while (lo < hi) {
+			mid = (lo + hi) / 2;
+			map = static_memory_map + idx->by_type_pa[mid];
+			if (map->type < type ||
+			    (map->type == type && map->pa <= pa))
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (!lo)
+			return NULL;
+
+		map = static_memory_map + idx->by_type_pa[lo - 1];
+		if (map->type == type && pa_is_in_map(map, pa, len))
+			return map;
+		return NULL;
+	}
+
 	for (map = get_memory_map(); !core_mmap_is_end_of_table(map); map++) {
 		if (map->type != type)
 			continue;
@@ -261,9 +470,32 @@ find_map_by_type_and_pa(enum teecore_memtypes type, paddr_t pa, size_t len)
 
 static struct tee_mmap_region *find_map_by_va(void *va)
 {
+	const struct mmap_index *idx = get_mmap_index();
 	struct tee_mmap_region *map = get_memory_map();
 	unsigned long a = (unsigned long)va;
 
+	if (idx) {
+		size_t lo = 0;
+		size_t hi = idx->va_count;
+		size_t mid = 0;
+
+		/* Find the first entry starting above va */
+		while (lo < hi) {
+			mid = (lo + hi) / 2;
+			if (static_memory_map[idx->by_va[mid]].va <= a)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (!lo)
+			return NULL;
+
+		map = static_memory_map + idx->by_va[lo - 1];
+		if (a <= map->va - 1 + map->size)
+			return map;
+		return NULL;
+	}
+
 	while (!core_mmap_is_end_of_table(map)) {
 		if (a >= map->va && a <= (map->va - 1 + map->size))
 			return map;
@@ -274,8 +506,38 @@ static struct tee_mmap_region *find_map_by_va(void *va)
 
 static struct tee_mmap_region *find_map_by_pa(unsigned long pa)
 {
+	const struct mmap_index *idx = get_mmap_index();
 	struct tee_mmap_region *map = get_memory_map();
 
+	if (idx) {
+		struct tee_mmap_region *found = NULL;
+		size_t lo = 0;
+		size_t hi = idx->count;
+		size_t mid = 0;
+
+		/* Find the first entry starting above pa */
+		while (lo < hi) {
+			mid = (lo + hi) / 2;
+			if (static_memory_map[idx->by_pa[mid]].pa <= pa)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		/*
+		 * Entries may overlap, return the first matching entry in
+		 * memory map order as the scan below would.
+		 */
+		while (lo && idx->pa_max_end[lo - 1] >= pa) {
+			lo--;
+			map = static_memory_map + idx->by_pa[lo];
+			if (pa <= map->pa + map->size - 1 &&
+			    (!found || map < found))
+				found = map;
+		}
+		return found;
+	}
+
 	while (!core_mmap_is_end_of_table(map)) {
 		if (pa >= map->pa && pa <= (map->pa + map->size - 1))
 			return map;
@@ -1466,7 +1728,9 @@ void __weak core_init_mmu_map(unsigned long seed, struct core_mmu_config *cfg)
 	dump_xlat_table(0x0, CORE_MMU_BASE_TABLE_LEVEL);
 	core_init_mmu_regs(cfg);
 	cfg->map_offset = offs;
+	invalidate_mmap_index();
 	memcpy(static_memory_map, tmp_mmap, sizeof(static_memory_map));
+	update_mmap_index();
 }
 
 bool core_mmu_mattr_is_ok(uint32_t mattr)
@@ -1675,6 +1939,21 @@ static void set_pg_region(struct core_mmu_table_info *dir_info,
 	vaddr_t end = r.va + r.size;
 	uint32_t pgt_attr = (r.attr & TEE_MATTR_SECURE) | TEE_MATTR_TABLE;
 
+	/*
+	 * A revoked parked parameter mapping has no mobj left, it's
+	 * removed before the context is entered again.
+	 */
+	if (!region->mobj)
+		return;
+
+	if (vm_region_is_block_mapped(region)) {
+		/* Map with block entries directly in the page directory */
+		if (mobj_get_pa(region->mobj, region->offset, 0, &r.pa))
+			panic("Failed to get PA of block mapped mobj");
+		set_region(dir_info, &r);
+		return;
+	}
+
 	while (r.va < end) {
 		if (!pg_info->table ||
 		    r.va >= (pg_info->va_base + CORE_MMU_PGDIR_SIZE)) {
@@ -2052,6 +2331,7 @@ TEE_Result core_mmu_remove_mapping(enum teecore_memtypes type, void *addr,
 	if (map->pa != p || map->size != l)
 		return TEE_ERROR_GENERIC;
 
+	invalidate_mmap_index();
 	clear_region(&tbl_info, map);
 	tlbi_all();
 
@@ -2069,6 +2349,8 @@ TEE_Result core_mmu_remove_mapping(enum teecore_memtypes type, void *addr,
 	memset(static_memory_map + ARRAY_SIZE(static_memory_map) - 1,
 	       0, sizeof(*map));
 
+	update_mmap_index();
+
 	return TEE_SUCCESS;
 }
 
@@ -2141,6 +2423,8 @@ void *core_mmu_add_mapping(enum teecore_memtypes type, paddr_t addr, size_t len)
 	if (core_mmu_va2idx(&tbl_info, map->va + len) >= tbl_info.num_entries)
 		return NULL;
 
+	invalidate_mmap_index();
+
 	/* Find end of the memory map */
 	n = 0;
 	while (!core_mmap_is_end_of_table(static_memory_map + n))
@@ -2171,6 +2455,8 @@ void *core_mmu_add_mapping(enum teecore_memtypes type, paddr_t addr, size_t len)
 	/* Make sure the new entry is visible before continuing. */
 	core_mmu_table_write_barrier();
 
+	update_mmap_index();
+
 	return (void *)(vaddr_t)(map->va + addr - map->pa);
 }
 
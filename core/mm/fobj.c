@@ -3,12 +3,14 @@
  * Copyright (c) 2019-2022, Linaro Limited
  */
 
+#include <bitstring.h>
 #include <config.h>
 #include <crypto/crypto.h>
 #include <crypto/internal_aes-gcm.h>
 #include <initcall.h>
 #include <kernel/boot.h>
 #include <kernel/panic.h>
+#include <kernel/spinlock.h>
 #include <memtag.h>
 #include <mm/core_memprot.h>
 #include <mm/core_mmu.h>
@@ -16,6 +18,7 @@
 #include <mm/tee_mm.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/queue.h>
 #include <tee_api_types.h>
 #include <types_ext.h>
 #include <util.h>
@@ -237,6 +240,16 @@ static vaddr_t rwp_paged_iv_get_iv_vaddr(struct fobj *fobj,
 }
 DECLARE_KEEP_PAGER(rwp_paged_iv_get_iv_vaddr);
 
+static bool rwp_paged_iv_page_is_zero(struct fobj *fobj, unsigned int page_idx)
+{
+	struct fobj_rwp_paged_iv *rwp = to_rwp_paged_iv(fobj);
+	struct rwp_state_padded *st = idx_to_state_padded(rwp->idx + page_idx);
+
+	assert(page_idx < fobj->num_pages);
+	return !st->state.iv;
+}
+DECLARE_KEEP_PAGER(rwp_paged_iv_page_is_zero);
+
 /*
  * Note: this variable is weak just to ease breaking its dependency chain
  * when added to the unpaged area.
@@ -247,6 +260,7 @@ __weak __relrodata_unpaged("ops_rwp_paged_iv") = {
 	.load_page = rwp_paged_iv_load_page,
 	.save_page = rwp_paged_iv_save_page,
 	.get_iv_vaddr = rwp_paged_iv_get_iv_vaddr,
+	.page_is_zero = rwp_paged_iv_page_is_zero,
 };
 
 static struct fobj *rwp_unpaged_iv_alloc(unsigned int num_pages)
@@ -324,6 +338,16 @@ static TEE_Result rwp_unpaged_iv_save_page(struct fobj *fobj,
 }
 DECLARE_KEEP_PAGER(rwp_unpaged_iv_save_page);
 
+static bool rwp_unpaged_iv_page_is_zero(struct fobj *fobj,
+					unsigned int page_idx)
+{
+	struct fobj_rwp_unpaged_iv *rwp = to_rwp_unpaged_iv(fobj);
+
+	assert(page_idx < fobj->num_pages);
+	return !rwp->state[page_idx].iv;
+}
+DECLARE_KEEP_PAGER(rwp_unpaged_iv_page_is_zero);
+
 static void rwp_unpaged_iv_free(struct fobj *fobj)
 {
 	struct fobj_rwp_unpaged_iv *rwp = NULL;
@@ -352,7 +376,519 @@ __weak __relrodata_unpaged("ops_rwp_unpaged_iv") = {
 	.free = rwp_unpaged_iv_free,
 	.load_page = rwp_unpaged_iv_load_page,
 	.save_page = rwp_unpaged_iv_save_page,
+	.page_is_zero = rwp_unpaged_iv_page_is_zero,
+};
+
+#ifdef CFG_PAGER_RW_COMPRESS
+/*
+ * Read/write paged storage where the pages are compressed before they are
+ * encrypted. The encrypted data is stored in slots carved out of pages
+ * allocated on demand from tee_mm_sec_ddr, each such page is split into
+ * slots of equal size. The slot sizes are powers of two from
+ * RWPC_MIN_SLOT_SIZE up to SMALL_PAGE_SIZE, the latter is used for pages
+ * which don't compress. A page only containing zeroes is not stored at
+ * all.
+ *
+ * The pager can't handle a failure to save a page, so if no slot can be
+ * allocated the page is stored uncompressed in a page of a reserve of
+ * CFG_PAGER_RW_COMPRESS_RESERVE pages allocated at boot. The page leaves
+ * the reserve when it's saved again and a slot can be allocated.
+ *
+ * The compression is a simple word based run-length encoding which is
+ * cheap and handles the typical zero or pattern filled pages in a TA heap
+ * or stack well. Each token starts with a header byte where the two upper
+ * bits select the kind of token and the six lower bits hold the number of
+ * words minus one:
+ * RWPC_TOK_ZERO:	a run of zero words
+ * RWPC_TOK_REPEAT:	a run of the 32-bit word following the header
+ * RWPC_TOK_LITERAL:	the words following the header
+ */
+#define RWPC_TOK_ZERO		0
+#define RWPC_TOK_REPEAT		1
+#define RWPC_TOK_LITERAL	2
+#define RWPC_TOK_SHIFT		6
+#define RWPC_TOK_MAX_WORDS	BIT(RWPC_TOK_SHIFT)
+
+#define RWPC_PAGE_WORDS		(SMALL_PAGE_SIZE / sizeof(uint32_t))
+#define RWPC_BUF_SIZE		(SMALL_PAGE_SIZE + 1 + \
+				 RWPC_TOK_MAX_WORDS * sizeof(uint32_t))
+
+#define RWPC_MIN_SLOT_SHIFT	8
+#define RWPC_MIN_SLOT_SIZE	BIT(RWPC_MIN_SLOT_SHIFT)
+#define RWPC_NUM_CLASSES	(SMALL_PAGE_SHIFT - RWPC_MIN_SLOT_SHIFT + 1)
+
+struct rwpc_slab {
+	uint8_t *store;
+	tee_mm_entry_t *mm;
+	uint16_t free_mask;
+	uint8_t class;
+	SLIST_ENTRY(rwpc_slab) link;
+};
+
+SLIST_HEAD(rwpc_slab_head, rwpc_slab);
+
+/*
+ * struct rwpc_page - state of a page in a struct fobj_rwpc
+ * @state:	IV and tag
+ * @slab:	Slab holding the data or NULL if in the reserve
+ * @len:	Length of the stored data, 0 if nothing is stored
+ * @slot:	Slot in @slab or page in the reserve
+ */
+struct rwpc_page {
+	struct rwp_state state;
+	struct rwpc_slab *slab;
+	uint16_t len;
+	uint16_t slot;
+};
+
+struct fobj_rwpc {
+	struct rwpc_page *pages;
+	struct fobj fobj;
+};
+
+const struct fobj_ops ops_rwpc;
+
+/* Slabs with at least one free slot, indexed by slot size class */
+static struct rwpc_slab_head rwpc_slabs[RWPC_NUM_CLASSES];
+static uint8_t *rwpc_reserve;
+static bitstr_t bit_decl(rwpc_reserve_used, CFG_PAGER_RW_COMPRESS_RESERVE);
+/* Protects rwpc_slabs and rwpc_reserve_used */
+static unsigned int rwpc_slab_lock = SPINLOCK_UNLOCK;
+
+/*
+ * Holds the compressed clear text of a page while saving or loading.
+ * Pages are only saved and loaded by the pager with the pager lock held
+ * so one buffer is enough.
+ */
+static uint8_t rwpc_buf[RWPC_BUF_SIZE] __aligned(sizeof(uint32_t));
+
+static size_t rwpc_put_token(uint8_t *dst, unsigned int kind, size_t nwords,
+			     const uint32_t *words)
+{
+	size_t n = 0;
+
+	assert(nwords && nwords <= RWPC_TOK_MAX_WORDS);
+
+	dst[0] = SHIFT_U32(kind, RWPC_TOK_SHIFT) | (nwords - 1);
+	if (kind == RWPC_TOK_REPEAT)
+		n = sizeof(uint32_t);
+	else if (kind == RWPC_TOK_LITERAL)
+		n = nwords * sizeof(uint32_t);
+	if (n)
+		memcpy(dst + 1, words, n);
+
+	return n + 1;
+}
+
+/*
+ * Compresses the page at @va into @dst which must be at least
+ * RWPC_BUF_SIZE large. Returns the length of the compressed data or
+ * SMALL_PAGE_SIZE if the page doesn't compress, 0 if the page only
+ * contains zeroes.
+ */
+static size_t rwpc_compress(const void *va, uint8_t *dst)
+{
+	const uint32_t *w = va;
+	bool is_zero = true;
+	size_t len = 0;
+	size_t n = 0;
+	size_t m = 0;
+
+	while (n < RWPC_PAGE_WORDS && len < SMALL_PAGE_SIZE) {
+		m = n + 1;
+		while (m < RWPC_PAGE_WORDS && m - n < RWPC_TOK_MAX_WORDS &&
+		       w[m] == w[n])
+			m++;
+
+		if (!w[n]) {
+			len += rwpc_put_token(dst + len, RWPC_TOK_ZERO, m - n,
+					      NULL);
+		} else if (m - n > 1) {
+			len += rwpc_put_token(dst + len, RWPC_TOK_REPEAT, m - n,
+					      w + n);
+			is_zero = false;
+		} else {
+			/* Collect literals until a run starts */
+			while (m < RWPC_PAGE_WORDS &&
+			       m - n < RWPC_TOK_MAX_WORDS && w[m] &&
+			       (m + 1 == RWPC_PAGE_WORDS || w[m] != w[m + 1]))
+				m++;
+			len += rwpc_put_token(dst + len, RWPC_TOK_LITERAL,
+					      m - n, w + n);
+			is_zero = false;
+		}
+		n = m;
+	}
+
+	if (n < RWPC_PAGE_WORDS || len >= SMALL_PAGE_SIZE)
+		return SMALL_PAGE_SIZE;
+	if (is_zero)
+		return 0;
+	return len;
+}
+
+static TEE_Result rwpc_decompress(const uint8_t *src, size_t len, void *va)
+{
+	uint32_t *w = va;
+	unsigned int kind = 0;
+	size_t nwords = 0;
+	size_t n = 0;
+	size_t i = 0;
+
+	while (len) {
+		kind = src[0] >> RWPC_TOK_SHIFT;
+		nwords = (src[0] & (RWPC_TOK_MAX_WORDS - 1)) + 1;
+		src++;
+		len--;
+
+		if (nwords > RWPC_PAGE_WORDS - n)
+			return TEE_ERROR_CORRUPT_OBJECT;
+
+		if (kind == RWPC_TOK_ZERO) {
+			memset(w + n, 0, nwords * sizeof(uint32_t));
+		} else if (kind == RWPC_TOK_REPEAT) {
+			if (len < sizeof(uint32_t))
+				return TEE_ERROR_CORRUPT_OBJECT;
+			memcpy(w + n, src, sizeof(uint32_t));
+			for (i = 1; i < nwords; i++)
+				w[n + i] = w[n];
+			src += sizeof(uint32_t);
+			len -= sizeof(uint32_t);
+		} else if (kind == RWPC_TOK_LITERAL) {
+			if (len < nwords * sizeof(uint32_t))
+				return TEE_ERROR_CORRUPT_OBJECT;
+			memcpy(w + n, src, nwords * sizeof(uint32_t));
+			src += nwords * sizeof(uint32_t);
+			len -= nwords * sizeof(uint32_t);
+		} else {
+			return TEE_ERROR_CORRUPT_OBJECT;
+		}
+		n += nwords;
+	}
+
+	if (n != RWPC_PAGE_WORDS)
+		return TEE_ERROR_CORRUPT_OBJECT;
+	return TEE_SUCCESS;
+}
+
+static unsigned int rwpc_len_to_class(size_t len)
+{
+	unsigned int class = 0;
+
+	assert(len && len <= SMALL_PAGE_SIZE);
+
+	while (BIT(RWPC_MIN_SLOT_SHIFT + class) < len)
+		class++;
+
+	return class;
+}
+
+static size_t rwpc_slot_size(struct rwpc_slab *slab)
+{
+	return BIT(RWPC_MIN_SLOT_SHIFT + slab->class);
+}
+
+static uint8_t *rwpc_slot_store(struct rwpc_page *p)
+{
+	if (!p->slab)
+		return rwpc_reserve + p->slot * SMALL_PAGE_SIZE;
+	return p->slab->store + p->slot * rwpc_slot_size(p->slab);
+}
+
+static TEE_Result rwpc_alloc_slot(size_t len, struct rwpc_slab **slab_ret,
+				  uint16_t *slot_ret)
+{
+	unsigned int class = rwpc_len_to_class(len);
+	struct rwpc_slab *slab = NULL;
+	uint32_t exceptions = 0;
+	unsigned int slot = 0;
+
+	exceptions = cpu_spin_lock_xsave(&rwpc_slab_lock);
+
+	slab = SLIST_FIRST(rwpc_slabs + class);
+	if (!slab) {
+		slab = calloc(1, sizeof(*slab));
+		if (!slab)
+			goto err;
+		slab->mm = tee_mm_alloc(&tee_mm_sec_ddr, SMALL_PAGE_SIZE);
+		if (!slab->mm) {
+			free(slab);
+			goto err;
+		}
+		slab->store = phys_to_virt(tee_mm_get_smem(slab->mm),
+					   MEM_AREA_TA_RAM, SMALL_PAGE_SIZE);
+		assert(slab->store);
+		slab->class = class;
+		slab->free_mask = BIT(SMALL_PAGE_SIZE /
+				      rwpc_slot_size(slab)) - 1;
+		SLIST_INSERT_HEAD(rwpc_slabs + class, slab, link);
+	}
+
+	slot = __builtin_ctz(slab->free_mask);
+	slab->free_mask &= ~BIT(slot);
+	if (!slab->free_mask)
+		SLIST_REMOVE_HEAD(rwpc_slabs + class, link);
+
+	cpu_spin_unlock_xrestore(&rwpc_slab_lock, exceptions);
+
+	*slab_ret = slab;
+	*slot_ret = slot;
+	return TEE_SUCCESS;
+err:
+	cpu_spin_unlock_xrestore(&rwpc_slab_lock, exceptions);
+	return TEE_ERROR_OUT_OF_MEMORY;
+}
+
+static TEE_Result rwpc_alloc_reserve(uint16_t *slot_ret)
+{
+	uint32_t exceptions = cpu_spin_lock_xsave(&rwpc_slab_lock);
+	int slot = -1;
+
+	bit_ffc(rwpc_reserve_used, CFG_PAGER_RW_COMPRESS_RESERVE, &slot);
+	if (slot >= 0)
+		bit_set(rwpc_reserve_used, slot);
+
+	cpu_spin_unlock_xrestore(&rwpc_slab_lock, exceptions);
+
+	if (slot < 0)
+		return TEE_ERROR_OUT_OF_MEMORY;
+	*slot_ret = slot;
+	return TEE_SUCCESS;
+}
+
+static void rwpc_free_slot(struct rwpc_page *p)
+{
+	struct rwpc_slab *slab = p->slab;
+	unsigned int num_slots = 0;
+	uint32_t exceptions = cpu_spin_lock_xsave(&rwpc_slab_lock);
+
+	if (!slab) {
+		assert(bit_test(rwpc_reserve_used, p->slot));
+		bit_clear(rwpc_reserve_used, p->slot);
+		goto out;
+	}
+
+	num_slots = SMALL_PAGE_SIZE / rwpc_slot_size(slab);
+	assert(!(slab->free_mask & BIT(p->slot)));
+
+	if (!slab->free_mask)
+		SLIST_INSERT_HEAD(rwpc_slabs + slab->class, slab, link);
+	slab->free_mask |= BIT(p->slot);
+
+	if (slab->free_mask == BIT(num_slots) - 1) {
+		SLIST_REMOVE(rwpc_slabs + slab->class, slab, rwpc_slab, link);
+		tee_mm_free(slab->mm);
+		free(slab);
+	}
+out:
+	cpu_spin_unlock_xrestore(&rwpc_slab_lock, exceptions);
+}
+
+/*
+ * Finds a slot for @len bytes of data of @p. The current slot of @p is
+ * kept if it has the right size. If no slot can be allocated a page in
+ * the reserve is used instead and @len is updated to SMALL_PAGE_SIZE,
+ * the page is then stored uncompressed.
+ */
+static TEE_Result rwpc_get_slot(struct rwpc_page *p, size_t *len,
+				struct rwpc_slab **slab, uint16_t *slot)
+{
+	if (p->len && p->slab &&
+	    p->slab->class == rwpc_len_to_class(*len)) {
+		*slab = p->slab;
+		*slot = p->slot;
+		return TEE_SUCCESS;
+	}
+
+	if (!rwpc_alloc_slot(*len, slab, slot))
+		return TEE_SUCCESS;
+
+	*len = SMALL_PAGE_SIZE;
+	*slab = NULL;
+	if (p->len && !p->slab) {
+		*slot = p->slot;
+		return TEE_SUCCESS;
+	}
+	return rwpc_alloc_reserve(slot);
+}
+
+static void rwpc_init_reserve(void)
+{
+	size_t size = CFG_PAGER_RW_COMPRESS_RESERVE * SMALL_PAGE_SIZE;
+	tee_mm_entry_t *mm = NULL;
+
+	COMPILE_TIME_ASSERT(SMALL_PAGE_SIZE / RWPC_MIN_SLOT_SIZE <=
+			    sizeof(((struct rwpc_slab *)0)->free_mask) * 8);
+	COMPILE_TIME_ASSERT(CFG_PAGER_RW_COMPRESS_RESERVE > 0 &&
+			    CFG_PAGER_RW_COMPRESS_RESERVE <= UINT16_MAX);
+
+	mm = tee_mm_alloc(&tee_mm_sec_ddr, size);
+	if (!mm)
+		panic("Can't allocate compressed paging reserve");
+	rwpc_reserve = phys_to_virt(tee_mm_get_smem(mm), MEM_AREA_TA_RAM,
+				    size);
+	assert(rwpc_reserve);
+}
+
+static struct fobj *rwpc_alloc(unsigned int num_pages)
+{
+	struct fobj_rwpc *rwpc = NULL;
+
+	rwpc = calloc(1, sizeof(*rwpc));
+	if (!rwpc)
+		return NULL;
+
+	rwpc->pages = calloc(num_pages, sizeof(*rwpc->pages));
+	if (!rwpc->pages) {
+		free(rwpc);
+		return NULL;
+	}
+
+	fobj_init(&rwpc->fobj, &ops_rwpc, num_pages);
+
+	return &rwpc->fobj;
+}
+
+static struct fobj_rwpc *to_rwpc(struct fobj *fobj)
+{
+	assert(fobj->ops == &ops_rwpc);
+
+	return container_of(fobj, struct fobj_rwpc, fobj);
+}
+
+static TEE_Result rwpc_load_page(struct fobj *fobj, unsigned int page_idx,
+				 void *va)
+{
+	struct fobj_rwpc *rwpc = to_rwpc(fobj);
+	struct rwpc_page *p = rwpc->pages + page_idx;
+	struct rwp_aes_gcm_iv iv = {
+		.iv = { (vaddr_t)&p->state, p->state.iv >> 32, p->state.iv }
+	};
+	TEE_Result res = TEE_SUCCESS;
+	uint8_t *dst = rwpc_buf;
+
+	assert(refcount_val(&fobj->refc));
+	assert(page_idx < fobj->num_pages);
+
+	if (!p->len) {
+		/* Previously unused page or a page with only zeroes */
+		memset(va, 0, SMALL_PAGE_SIZE);
+		return TEE_SUCCESS;
+	}
+
+	if (p->len == SMALL_PAGE_SIZE)
+		dst = va;
+
+	res = internal_aes_gcm_dec(&rwp_ae_key, &iv, sizeof(iv), NULL, 0,
+				   rwpc_slot_store(p), p->len, dst,
+				   p->state.tag, sizeof(p->state.tag));
+	if (res || p->len == SMALL_PAGE_SIZE)
+		return res;
+
+	return rwpc_decompress(dst, p->len, va);
+}
+DECLARE_KEEP_PAGER(rwpc_load_page);
+
+static TEE_Result rwpc_save_page(struct fobj *fobj, unsigned int page_idx,
+				 const void *va)
+{
+	struct fobj_rwpc *rwpc = to_rwpc(fobj);
+	struct rwpc_page *p = rwpc->pages + page_idx;
+	size_t tag_len = sizeof(p->state.tag);
+	struct rwp_aes_gcm_iv iv = { };
+	struct rwpc_slab *slab = NULL;
+	TEE_Result res = TEE_SUCCESS;
+	const void *src = rwpc_buf;
+	uint16_t slot = 0;
+	size_t len = 0;
+
+	assert(page_idx < fobj->num_pages);
+
+	if (!refcount_val(&fobj->refc)) {
+		/*
+		 * This fobj is being teared down, it just hasn't had the time
+		 * to call tee_pager_invalidate_fobj() yet.
+		 */
+		assert(TAILQ_EMPTY(&fobj->regions));
+		return TEE_SUCCESS;
+	}
+
+	len = rwpc_compress(va, rwpc_buf);
+	if (len) {
+		res = rwpc_get_slot(p, &len, &slab, &slot);
+		if (res)
+			return res;
+	}
+
+	if (p->len && (p->slab != slab || p->slot != slot || !len))
+		rwpc_free_slot(p);
+	p->slab = slab;
+	p->slot = slot;
+	p->len = len;
+	if (!len)
+		return TEE_SUCCESS;
+
+	if (len == SMALL_PAGE_SIZE)
+		src = va;
+
+	assert(p->state.iv + 1 > p->state.iv);
+	p->state.iv++;
+
+	/* IV is constructed as in rwp_save_page() */
+	iv.iv[0] = (vaddr_t)&p->state;
+	iv.iv[1] = p->state.iv >> 32;
+	iv.iv[2] = p->state.iv;
+
+	return internal_aes_gcm_enc(&rwp_ae_key, &iv, sizeof(iv), NULL, 0,
+				    src, len, rwpc_slot_store(p),
+				    p->state.tag, &tag_len);
+}
+DECLARE_KEEP_PAGER(rwpc_save_page);
+
+static bool rwpc_page_is_zero(struct fobj *fobj, unsigned int page_idx)
+{
+	struct fobj_rwpc *rwpc = to_rwpc(fobj);
+
+	assert(page_idx < fobj->num_pages);
+	return !rwpc->pages[page_idx].len;
+}
+DECLARE_KEEP_PAGER(rwpc_page_is_zero);
+
+static void rwpc_free(struct fobj *fobj)
+{
+	struct fobj_rwpc *rwpc = to_rwpc(fobj);
+	unsigned int n = 0;
+
+	fobj_uninit(fobj);
+
+	for (n = 0; n < fobj->num_pages; n++)
+		if (rwpc->pages[n].len)
+			rwpc_free_slot(rwpc->pages + n);
+
+	free(rwpc->pages);
+	free(rwpc);
+}
+
+/*
+ * Note: this variable is weak just to ease breaking its dependency chain
+ * when added to the unpaged area.
+ */
+const struct fobj_ops ops_rwpc __weak __relrodata_unpaged("ops_rwpc") = {
+	.free = rwpc_free,
+	.load_page = rwpc_load_page,
+	.save_page = rwpc_save_page,
+	.page_is_zero = rwpc_page_is_zero,
 };
+#else
+static void rwpc_init_reserve(void)
+{
+}
+
+static struct fobj *rwpc_alloc(unsigned int num_pages __unused)
+{
+	return NULL;
+}
+#endif /*CFG_PAGER_RW_COMPRESS*/
 
 static TEE_Result rwp_init(void)
 {
@@ -368,6 +904,9 @@ static TEE_Result rwp_init(void)
 				      &rwp_ae_key.rounds))
 		panic("failed to expand key");
 
+	if (IS_ENABLED(CFG_PAGER_RW_COMPRESS))
+		rwpc_init_reserve();
+
 	if (!IS_ENABLED(CFG_CORE_PAGE_TAG_AND_IV))
 		return TEE_SUCCESS;
 
@@ -403,7 +942,9 @@ struct fobj *fobj_rw_paged_alloc(unsigned int num_pages)
 {
 	assert(num_pages);
 
-	if (IS_ENABLED(CFG_CORE_PAGE_TAG_AND_IV))
+	if (IS_ENABLED(CFG_PAGER_RW_COMPRESS))
+		return rwpc_alloc(num_pages);
+	else if (IS_ENABLED(CFG_CORE_PAGE_TAG_AND_IV))
 		return rwp_paged_iv_alloc(num_pages);
 	else
 		return rwp_unpaged_iv_alloc(num_pages);
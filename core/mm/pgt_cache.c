@@ -12,6 +12,7 @@
 #include <mm/core_mmu.h>
 #include <mm/pgt_cache.h>
 #include <mm/tee_pager.h>
+#include <mm/vm.h>
 #include <stdlib.h>
 #include <trace.h>
 #include <util.h>
@@ -35,6 +36,10 @@
  * be freed. A threads allocated tables are freed each time a TA is
  * unmapped so each thread should be able to allocate the needed tables in
  * turn if needed.
+ *
+ * Regions mapped with block entries in the page directory, see
+ * vm_region_is_block_mapped(), don't use any page tables and are skipped
+ * when counting and allocating the page tables needed by a context.
  */
 
 #if defined(CFG_CORE_PREALLOC_EL0_TBLS) || \
@@ -286,6 +291,8 @@ bool pgt_check_avail(struct user_mode_ctx *uctx)
 	 * allocate new ones.
 	 */
 	TAILQ_FOREACH(r, &vm_info->regions, link) {
+		if (vm_region_is_block_mapped(r))
+			continue;
 		for (va = ROUNDDOWN(r->va, CORE_MMU_PGDIR_SIZE);
 		     va < r->va + r->size; va += CORE_MMU_PGDIR_SIZE) {
 			if (!p_used)
@@ -310,6 +317,8 @@ prune_done:
 	p = SLIST_FIRST(pgt_cache);
 	pp = NULL;
 	TAILQ_FOREACH(r, &vm_info->regions, link) {
+		if (vm_region_is_block_mapped(r))
+			continue;
 		for (va = ROUNDDOWN(r->va, CORE_MMU_PGDIR_SIZE);
 		     va < r->va + r->size; va += CORE_MMU_PGDIR_SIZE) {
 			if (p && p->vabase < va) {
@@ -775,6 +784,8 @@ static bool pgt_alloc_unlocked(struct pgt_cache *pgt_cache, struct ts_ctx *ctx,
 	vaddr_t va = 0;
 
 	TAILQ_FOREACH(r, &vm_info->regions, link) {
+		if (vm_region_is_block_mapped(r))
+			continue;
 		for (va = ROUNDDOWN(r->va, CORE_MMU_PGDIR_SIZE);
 		     va < r->va + r->size; va += CORE_MMU_PGDIR_SIZE) {
 			if (p && p->vabase == va)
@@ -804,6 +815,8 @@ bool pgt_check_avail(struct user_mode_ctx *uctx)
 	vaddr_t va = 0;
 
 	TAILQ_FOREACH(r, &vm_info->regions, link) {
+		if (vm_region_is_block_mapped(r))
+			continue;
 		for (va = ROUNDDOWN(r->va, CORE_MMU_PGDIR_SIZE);
 		     va < r->va + r->size; va += CORE_MMU_PGDIR_SIZE) {
 			if (va == last_va)
@@ -8,10 +8,12 @@
 #include <assert.h>
 #include <config.h>
 #include <initcall.h>
+#include <kernel/mutex.h>
 #include <kernel/panic.h>
 #include <kernel/spinlock.h>
 #include <kernel/tee_common.h>
 #include <kernel/tee_misc.h>
+#include <kernel/tee_time.h>
 #include <kernel/tlb_helpers.h>
 #include <kernel/user_mode_ctx.h>
 #include <kernel/virtualization.h>
@@ -45,6 +47,67 @@
 #define TEE_MMU_UCACHE_DEFAULT_ATTR	(TEE_MATTR_MEM_TYPE_CACHED << \
 					 TEE_MATTR_MEM_TYPE_SHIFT)
 
+/*
+ * The regions of a vm_info are kept both in the sorted vm_info->regions
+ * list and in vm_info->region_tree to find the region covering a virtual
+ * address in O(log n). Regions never overlap so ordering the tree on the
+ * start address is enough. Each insertion or removal of a region in
+ * vm_info->regions must be matched by the same operation on the tree.
+ */
+static int cmp_vm_region(struct vm_region *r0, struct vm_region *r1)
+{
+	return CMP_TRILEAN(r0->va, r1->va);
+}
+
+RB_GENERATE_STATIC(vm_region_tree, vm_region, tree_link, cmp_vm_region)
+
+static void region_tree_insert(struct vm_info *vmi, struct vm_region *r)
+{
+	if (RB_INSERT(vm_region_tree, &vmi->region_tree, r))
+		panic("Overlapping vm_region");
+}
+
+static void region_tree_remove(struct vm_info *vmi, struct vm_region *r)
+{
+	RB_REMOVE(vm_region_tree, &vmi->region_tree, r);
+}
+
+static struct vm_region *find_vm_region(const struct vm_info *vmi,
+					vaddr_t va)
+{
+	struct vm_region *r = RB_ROOT(&vmi->region_tree);
+
+	while (r) {
+		if (va < r->va)
+			r = RB_LEFT(r, tree_link);
+		else if (va - r->va >= r->size)
+			r = RB_RIGHT(r, tree_link);
+		else
+			return r;
+	}
+
+	return NULL;
+}
+
+/* Returns the last region starting below @va or NULL */
+static struct vm_region *find_vm_region_before(const struct vm_info *vmi,
+					       vaddr_t va)
+{
+	struct vm_region *r = RB_ROOT(&vmi->region_tree);
+	struct vm_region *res = NULL;
+
+	while (r) {
+		if (r->va < va) {
+			res = r;
+			r = RB_RIGHT(r, tree_link);
+		} else {
+			r = RB_LEFT(r, tree_link);
+		}
+	}
+
+	return res;
+}
+
 static vaddr_t select_va_in_range(const struct vm_region *prev_reg,
 				  const struct vm_region *next_reg,
 				  const struct vm_region *reg,
@@ -132,14 +195,83 @@ static TEE_Result alloc_pgt(struct user_mode_ctx *uctx)
 	return TEE_SUCCESS;
 }
 
+#ifdef CFG_CORE_USER_BLOCK_MAP
+static bool mobj_range_is_block_aligned(struct mobj *mobj, size_t offs,
+					size_t size)
+{
+	paddr_t pa = 0;
+
+	/* Only physically contiguous memory can be mapped with blocks */
+	if (mobj_is_paged(mobj) || mobj->phys_granule)
+		return false;
+	if (!size || (size & CORE_MMU_PGDIR_MASK))
+		return false;
+	if (mobj_get_pa(mobj, offs, 0, &pa))
+		return false;
+
+	return !(pa & CORE_MMU_PGDIR_MASK);
+}
+
+bool vm_region_is_block_mapped(const struct vm_region *r)
+{
+	return !(r->va & CORE_MMU_PGDIR_MASK) &&
+	       mobj_range_is_block_aligned(r->mobj, r->offset, r->size);
+}
+#else
+static bool mobj_range_is_block_aligned(struct mobj *mobj __unused,
+					size_t offs __unused,
+					size_t size __unused)
+{
+	return false;
+}
+#endif
+
+/*
+ * A block mapped region covers its CORE_MMU_PGDIR_SIZE ranges alone, so
+ * translation tables left in the range from earlier mappings are stale
+ * and must be released before they may be picked up again.
+ */
+static void flush_block_region_pgt(struct user_mode_ctx *uctx,
+				   struct vm_region *r)
+{
+	if (vm_region_is_block_mapped(r))
+		pgt_flush_range(uctx, r->va, r->va + r->size);
+}
+
+static void clear_um_block_region(struct user_mode_ctx *uctx,
+				  struct vm_region *r)
+{
+	struct core_mmu_table_info dir_info = { };
+	unsigned int idx = 0;
+	unsigned int end = 0;
+
+	/*
+	 * The block entries only exist in the page directory of the
+	 * thread where the context is active. Elsewhere they are simply
+	 * not recreated the next time the page directory is populated.
+	 */
+	if (thread_get_tsd()->ctx == uctx->ts_ctx) {
+		core_mmu_get_user_pgdir(&dir_info);
+		idx = core_mmu_va2idx(&dir_info, r->va);
+		end = core_mmu_va2idx(&dir_info, r->va + r->size);
+		for (; idx < end; idx++)
+			core_mmu_set_entry(&dir_info, idx, 0, 0);
+	}
+	tlbi_va_range_asid(r->va, r->size, CORE_MMU_PGDIR_SIZE,
+			   uctx->vm_info.asid);
+}
+
 static void rem_um_region(struct user_mode_ctx *uctx, struct vm_region *r)
 {
 	vaddr_t begin = ROUNDDOWN(r->va, CORE_MMU_PGDIR_SIZE);
 	vaddr_t last = ROUNDUP(r->va + r->size, CORE_MMU_PGDIR_SIZE);
 	struct vm_region *r2 = NULL;
 
-	if (mobj_is_paged(r->mobj)) {
+	/* A revoked parked parameter mapping has no mobj left */
+	if (r->mobj && mobj_is_paged(r->mobj)) {
 		tee_pager_rem_um_region(uctx, r->va, r->size);
+	} else if (r->mobj && vm_region_is_block_mapped(r)) {
+		clear_um_block_region(uctx, r);
 	} else {
 		pgt_clear_range(uctx, r->va, r->va + r->size);
 		tlbi_va_range_asid(r->va, r->size, SMALL_PAGE_SIZE,
@@ -206,6 +338,13 @@ static void set_um_region(struct user_mode_ctx *uctx, struct vm_region *r)
 
 	assert(!mobj_is_paged(r->mobj));
 
+	/*
+	 * Block mapped regions have no translation tables, the block
+	 * entries are added when the page directory is populated.
+	 */
+	if (vm_region_is_block_mapped(r))
+		return;
+
 	core_mmu_set_info_table(&ti, CORE_MMU_PGDIR_LEVEL, 0, NULL);
 
 	if (p) {
@@ -266,6 +405,35 @@ static TEE_Result umap_add_region(struct vm_info *vmi, struct vm_region *reg,
 	if (!IS_POWER_OF_TWO(granul))
 		return TEE_ERROR_BAD_PARAMETERS;
 
+	if (reg->va) {
+		/*
+		 * A fixed address can only fit in the gap just before
+		 * the first region starting at or above the address.
+		 */
+		prev_r = find_vm_region_before(vmi, reg->va);
+		if (prev_r)
+			r = TAILQ_NEXT(prev_r, link);
+		else
+			r = TAILQ_FIRST(&vmi->regions);
+		if (!prev_r)
+			prev_r = &dummy_first_reg;
+		if (!r)
+			r = &dummy_last_reg;
+
+		va = select_va_in_range(prev_r, r, reg, pad_begin, pad_end,
+					granul);
+		if (!va)
+			return TEE_ERROR_ACCESS_CONFLICT;
+
+		reg->va = va;
+		if (r == &dummy_last_reg)
+			TAILQ_INSERT_TAIL(&vmi->regions, reg, link);
+		else
+			TAILQ_INSERT_BEFORE(r, reg, link);
+		region_tree_insert(vmi, reg);
+		return TEE_SUCCESS;
+	}
+
 	prev_r = &dummy_first_reg;
 	TAILQ_FOREACH(r, &vmi->regions, link) {
 		va = select_va_in_range(prev_r, r, reg, pad_begin, pad_end,
@@ -273,6 +441,7 @@ static TEE_Result umap_add_region(struct vm_info *vmi, struct vm_region *reg,
 		if (va) {
 			reg->va = va;
 			TAILQ_INSERT_BEFORE(r, reg, link);
+			region_tree_insert(vmi, reg);
 			return TEE_SUCCESS;
 		}
 		prev_r = r;
@@ -286,6 +455,7 @@ static TEE_Result umap_add_region(struct vm_info *vmi, struct vm_region *reg,
 	if (va) {
 		reg->va = va;
 		TAILQ_INSERT_TAIL(&vmi->regions, reg, link);
+		region_tree_insert(vmi, reg);
 		return TEE_SUCCESS;
 	}
 
@@ -326,10 +496,21 @@ TEE_Result vm_map_pad(struct user_mode_ctx *uctx, vaddr_t *va, size_t len,
 	reg->size = ROUNDUP(len, SMALL_PAGE_SIZE);
 	reg->attr = attr | prot;
 	reg->flags = flags;
+	if (flags & VM_FLAG_EPHEMERAL)
+		reg->thread_id = thread_get_id();
+
+	/*
+	 * Let memory which can be mapped with blocks start on a block
+	 * boundary unless the caller has placed other requirements.
+	 */
+	if (!reg->va && !align &&
+	    mobj_range_is_block_aligned(mobj, offs, reg->size))
+		align = CORE_MMU_PGDIR_SIZE;
 
 	res = umap_add_region(&uctx->vm_info, reg, pad_begin, pad_end, align);
 	if (res)
 		goto err_put_mobj;
+	flush_block_region_pgt(uctx, reg);
 
 	res = alloc_pgt(uctx);
 	if (res)
@@ -364,6 +545,7 @@ TEE_Result vm_map_pad(struct user_mode_ctx *uctx, vaddr_t *va, size_t len,
 
 err_rem_reg:
 	TAILQ_REMOVE(&uctx->vm_info.regions, reg, link);
+	region_tree_remove(&uctx->vm_info, reg);
 err_put_mobj:
 	mobj_put(reg->mobj);
 err_free_reg:
@@ -371,17 +553,6 @@ err_free_reg:
 	return res;
 }
 
-static struct vm_region *find_vm_region(struct vm_info *vm_info, vaddr_t va)
-{
-	struct vm_region *r = NULL;
-
-	TAILQ_FOREACH(r, &vm_info->regions, link)
-		if (va >= r->va && va < r->va + r->size)
-			return r;
-
-	return NULL;
-}
-
 static bool va_range_is_contiguous(struct vm_region *r0, vaddr_t va,
 				   size_t len,
 				   bool (*cmp_regs)(const struct vm_region *r0,
@@ -413,8 +584,10 @@ static bool va_range_is_contiguous(struct vm_region *r0, vaddr_t va,
 static TEE_Result split_vm_region(struct user_mode_ctx *uctx,
 				  struct vm_region *r, vaddr_t va)
 {
+	bool was_block_mapped = vm_region_is_block_mapped(r);
 	struct vm_region *r2 = NULL;
 	size_t diff = va - r->va;
+	TEE_Result res = TEE_SUCCESS;
 
 	assert(diff && diff < r->size);
 
@@ -423,8 +596,7 @@ static TEE_Result split_vm_region(struct user_mode_ctx *uctx,
 		return TEE_ERROR_OUT_OF_MEMORY;
 
 	if (mobj_is_paged(r->mobj)) {
-		TEE_Result res = tee_pager_split_um_region(uctx, va);
-
+		res = tee_pager_split_um_region(uctx, va);
 		if (res) {
 			free(r2);
 			return res;
@@ -441,6 +613,30 @@ static TEE_Result split_vm_region(struct user_mode_ctx *uctx,
 	r->size = diff;
 
 	TAILQ_INSERT_AFTER(&uctx->vm_info.regions, r, r2, link);
+	region_tree_insert(&uctx->vm_info, r2);
+
+	if (was_block_mapped || vm_region_is_block_mapped(r) ||
+	    vm_region_is_block_mapped(r2)) {
+		/*
+		 * Parts of the range are going between block and
+		 * translation table mapping, make sure that the needed
+		 * translation tables are available and rebuild the page
+		 * directory.
+		 */
+		res = alloc_pgt(uctx);
+		if (res) {
+			TAILQ_REMOVE(&uctx->vm_info.regions, r2, link);
+			region_tree_remove(&uctx->vm_info, r2);
+			r->size += r2->size;
+			mobj_put(r2->mobj);
+			free(r2);
+			return res;
+		}
+		flush_block_region_pgt(uctx, r);
+		flush_block_region_pgt(uctx, r2);
+		if (thread_get_tsd()->ctx == uctx->ts_ctx)
+			vm_set_ctx(uctx->ts_ctx);
+	}
 
 	return TEE_SUCCESS;
 }
@@ -494,21 +690,36 @@ static TEE_Result split_vm_range(struct user_mode_ctx *uctx, vaddr_t va,
 	return TEE_SUCCESS;
 }
 
-static void merge_vm_range(struct user_mode_ctx *uctx, vaddr_t va, size_t len)
+static bool merged_region_is_block_mapped(const struct vm_region *r,
+					  const struct vm_region *r_next)
+{
+	struct vm_region merged = *r;
+
+	merged.size += r_next->size;
+
+	return vm_region_is_block_mapped(&merged);
+}
+
+/*
+ * Returns true if the merge turned a region into a block mapped region,
+ * the page directory must then be rebuilt.
+ */
+static bool merge_vm_range(struct user_mode_ctx *uctx, vaddr_t va, size_t len)
 {
 	struct vm_region *r_next = NULL;
 	struct vm_region *r = NULL;
+	bool block_mapped = false;
 	vaddr_t end_va = 0;
 
 	if (ADD_OVERFLOW(va, len, &end_va))
-		return;
+		return false;
 
 	tee_pager_merge_um_region(uctx, va, len);
 
 	for (r = TAILQ_FIRST(&uctx->vm_info.regions);; r = r_next) {
 		r_next = TAILQ_NEXT(r, link);
 		if (!r_next)
-			return;
+			return block_mapped;
 
 		/* Try merging with the region just before va */
 		if (r->va + r->size < va)
@@ -520,22 +731,37 @@ static void merge_vm_range(struct user_mode_ctx *uctx, vaddr_t va, size_t len)
 		 * try to merge.
 		 */
 		if (r->va > end_va)
-			return;
+			return block_mapped;
 
 		if (r->va + r->size != r_next->va)
 			continue;
 		if (r->mobj != r_next->mobj ||
 		    r->flags != r_next->flags ||
-		    r->attr != r_next->attr)
+		    r->attr != r_next->attr ||
+		    r->thread_id != r_next->thread_id)
 			continue;
 		if (r->offset + r->size != r_next->offset)
 			continue;
+		/*
+		 * Don't merge a block mapped region into a region needing
+		 * translation tables, there may be no tables available.
+		 */
+		if ((vm_region_is_block_mapped(r) ||
+		     vm_region_is_block_mapped(r_next)) &&
+		    !merged_region_is_block_mapped(r, r_next))
+			continue;
 
 		TAILQ_REMOVE(&uctx->vm_info.regions, r_next, link);
+		region_tree_remove(&uctx->vm_info, r_next);
 		r->size += r_next->size;
 		mobj_put(r_next->mobj);
 		free(r_next);
 		r_next = r;
+
+		if (vm_region_is_block_mapped(r)) {
+			flush_block_region_pgt(uctx, r);
+			block_mapped = true;
+		}
 	}
 }
 
@@ -588,6 +814,7 @@ TEE_Result vm_remap(struct user_mode_ctx *uctx, vaddr_t *new_va, vaddr_t old_va,
 		r_next = TAILQ_NEXT(r, link);
 		rem_um_region(uctx, r);
 		TAILQ_REMOVE(&uctx->vm_info.regions, r, link);
+		region_tree_remove(&uctx->vm_info, r);
 		TAILQ_INSERT_TAIL(&regs, r, link);
 	}
 
@@ -611,6 +838,7 @@ TEE_Result vm_remap(struct user_mode_ctx *uctx, vaddr_t *new_va, vaddr_t old_va,
 		}
 		if (!res) {
 			r_last = r;
+			flush_block_region_pgt(uctx, r);
 			res = alloc_pgt(uctx);
 		}
 		if (!res) {
@@ -637,11 +865,21 @@ TEE_Result vm_remap(struct user_mode_ctx *uctx, vaddr_t *new_va, vaddr_t old_va,
 				 */
 				TAILQ_INSERT_HEAD(&regs, r, link);
 			}
-			if (r_last)
-				r_stop = TAILQ_NEXT(r_last, link);
+
+			/*
+			 * Only r_first up to and including r_last have been
+			 * added to the region list and tree. If r_last is
+			 * NULL the first region failed and r_first is back
+			 * in regs already.
+			 */
+			if (!r_last)
+				goto err_restore_map;
+
+			r_stop = TAILQ_NEXT(r_last, link);
 			for (r = r_first; r != r_stop; r = r_next) {
 				r_next = TAILQ_NEXT(r, link);
 				TAILQ_REMOVE(&uctx->vm_info.regions, r, link);
+				region_tree_remove(&uctx->vm_info, r);
 				if (r_tmp)
 					TAILQ_INSERT_AFTER(&regs, r_tmp, r,
 							   link);
@@ -670,6 +908,7 @@ err_restore_map:
 		next_va += r->size;
 		if (umap_add_region(&uctx->vm_info, r, 0, 0, 0))
 			panic("Cannot restore mapping");
+		flush_block_region_pgt(uctx, r);
 		if (alloc_pgt(uctx))
 			panic("Cannot restore mapping");
 		if (fobj) {
@@ -747,6 +986,7 @@ TEE_Result vm_set_prot(struct user_mode_ctx *uctx, vaddr_t va, size_t len,
 	struct vm_region *r0 = NULL;
 	struct vm_region *r = NULL;
 	bool was_writeable = false;
+	bool need_remap = false;
 	bool need_sync = false;
 
 	assert(thread_get_tsd()->ctx == uctx->ts_ctx);
@@ -767,6 +1007,9 @@ TEE_Result vm_set_prot(struct user_mode_ctx *uctx, vaddr_t va, size_t len,
 		r->attr &= ~TEE_MATTR_PROT_MASK;
 		r->attr |= prot;
 
+		if (vm_region_is_block_mapped(r))
+			need_remap = true;
+
 		if (!mobj_is_paged(r->mobj)) {
 			need_sync = true;
 			set_um_region(uctx, r);
@@ -799,7 +1042,12 @@ TEE_Result vm_set_prot(struct user_mode_ctx *uctx, vaddr_t va, size_t len,
 	if (need_sync && was_writeable)
 		cache_op_inner(ICACHE_INVALIDATE, NULL, 0);
 
-	merge_vm_range(uctx, va, len);
+	/*
+	 * Block entries are only updated when the page directory is
+	 * populated.
+	 */
+	if (merge_vm_range(uctx, va, len) || need_remap)
+		vm_set_ctx(uctx->ts_ctx);
 
 	return TEE_SUCCESS;
 }
@@ -807,6 +1055,7 @@ TEE_Result vm_set_prot(struct user_mode_ctx *uctx, vaddr_t va, size_t len,
 static void umap_remove_region(struct vm_info *vmi, struct vm_region *reg)
 {
 	TAILQ_REMOVE(&vmi->regions, reg, link);
+	region_tree_remove(vmi, reg);
 	mobj_put(reg->mobj);
 	free(reg);
 }
@@ -876,6 +1125,27 @@ static TEE_Result map_kinit(struct user_mode_ctx *uctx)
 	return TEE_SUCCESS;
 }
 
+#ifdef CFG_TA_TIME_PAGE
+TEE_Result vm_map_time_page(struct user_mode_ctx *uctx)
+{
+	TEE_Result res = TEE_SUCCESS;
+	struct mobj *mobj = NULL;
+	size_t offs = 0;
+	vaddr_t va = 0;
+
+	if (!tee_time_get_user_page(&mobj, &offs))
+		return TEE_SUCCESS;
+
+	res = vm_map(uctx, &va, SMALL_PAGE_SIZE, TEE_MATTR_UR,
+		     VM_FLAG_PERMANENT, mobj, offs);
+	if (res)
+		return res;
+
+	uctx->time_page_va = va;
+	return TEE_SUCCESS;
+}
+#endif
+
 TEE_Result vm_info_init(struct user_mode_ctx *uctx, struct ts_ctx *ts_ctx)
 {
 	TEE_Result res;
@@ -888,6 +1158,7 @@ TEE_Result vm_info_init(struct user_mode_ctx *uctx, struct ts_ctx *ts_ctx)
 
 	memset(uctx, 0, sizeof(*uctx));
 	TAILQ_INIT(&uctx->vm_info.regions);
+	RB_INIT(&uctx->vm_info.region_tree);
 	SLIST_INIT(&uctx->pgt_cache);
 	uctx->vm_info.asid = asid;
 	uctx->ts_ctx = ts_ctx;
@@ -898,13 +1169,25 @@ TEE_Result vm_info_init(struct user_mode_ctx *uctx, struct ts_ctx *ts_ctx)
 	return res;
 }
 
+/*
+ * Parameters are mapped for each call into the TA. With a TA executing
+ * several sessions concurrently (TA_FLAG_CONCURRENT) the parameters of
+ * the other sessions are mapped too, so only the regions mapped by the
+ * calling thread are considered.
+ */
+static bool is_own_param(struct vm_region *r)
+{
+	return (r->flags & VM_FLAG_EPHEMERAL) &&
+	       r->thread_id == thread_get_id();
+}
+
 void vm_clean_param(struct user_mode_ctx *uctx)
 {
 	struct vm_region *next_r;
 	struct vm_region *r;
 
 	TAILQ_FOREACH_SAFE(r, &uctx->vm_info.regions, link, next_r) {
-		if (r->flags & VM_FLAG_EPHEMERAL) {
+		if (is_own_param(r)) {
 			rem_um_region(uctx, r);
 			umap_remove_region(&uctx->vm_info, r);
 		}
@@ -916,9 +1199,150 @@ static void check_param_map_empty(struct user_mode_ctx *uctx __maybe_unused)
 	struct vm_region *r = NULL;
 
 	TAILQ_FOREACH(r, &uctx->vm_info.regions, link)
-		assert(!(r->flags & VM_FLAG_EPHEMERAL));
+		assert(!is_own_param(r));
+}
+
+#ifdef CFG_TA_PARAM_MAP_CACHE
+/*
+ * Parked parameter mappings stay in the VM map of the context between two
+ * entries into the TA. parked_param_mu protects the parked_param arrays
+ * and the list of contexts with parked mappings, the list is needed to
+ * find the mappings to revoke when a registered shared memory object is
+ * released.
+ */
+static struct mutex parked_param_mu = MUTEX_INITIALIZER;
+static SLIST_HEAD(, user_mode_ctx) parked_param_ctxs =
+	SLIST_HEAD_INITIALIZER(parked_param_ctxs);
+
+static bool can_park_param(struct vm_region *r)
+{
+	/*
+	 * Only mappings of shared memory registered by the normal world
+	 * are kept, the release of such memory is taken care of with
+	 * vm_revoke_parked_param().
+	 */
+	return mobj_reg_shm_is_live(r->mobj) && !vm_region_is_block_mapped(r);
+}
+
+void vm_park_param(struct user_mode_ctx *uctx)
+{
+	struct vm_region *next_r = NULL;
+	struct vm_region *r = NULL;
+	size_t n = 0;
+
+	mutex_lock(&parked_param_mu);
+	TAILQ_FOREACH_SAFE(r, &uctx->vm_info.regions, link, next_r) {
+		if (!is_own_param(r))
+			continue;
+		if (n < TEE_NUM_PARAMS && can_park_param(r)) {
+			r->thread_id = THREAD_ID_INVALID;
+			uctx->parked_param[n] = r;
+			n++;
+		} else {
+			rem_um_region(uctx, r);
+			umap_remove_region(&uctx->vm_info, r);
+		}
+	}
+	if (n)
+		SLIST_INSERT_HEAD(&parked_param_ctxs, uctx, parked_link);
+	mutex_unlock(&parked_param_mu);
+}
+
+/*
+ * Takes back the parked mappings matching an entry in @mem as parameter
+ * mappings of the calling thread and clears the mobj of that entry to
+ * tell that it's already mapped. All other parked mappings, including
+ * revoked ones, are removed.
+ */
+static void unpark_param(struct user_mode_ctx *uctx, struct param_mem *mem,
+			 size_t num_mem)
+{
+	struct vm_region *r = NULL;
+	bool parked = false;
+	size_t n = 0;
+	size_t m = 0;
+
+	mutex_lock(&parked_param_mu);
+	for (n = 0; n < TEE_NUM_PARAMS; n++) {
+		r = uctx->parked_param[n];
+		if (!r)
+			continue;
+		uctx->parked_param[n] = NULL;
+		parked = true;
+
+		for (m = 0; m < num_mem; m++) {
+			if (mem[m].mobj && mem[m].mobj == r->mobj &&
+			    mem[m].offs == r->offset &&
+			    mem[m].size == r->size &&
+			    mem[m].readonly == !(r->attr & TEE_MATTR_UW))
+				break;
+		}
+		if (m < num_mem) {
+			r->thread_id = thread_get_id();
+			mem[m].mobj = NULL;
+		} else {
+			rem_um_region(uctx, r);
+			umap_remove_region(&uctx->vm_info, r);
+		}
+	}
+	if (parked)
+		SLIST_REMOVE(&parked_param_ctxs, uctx, user_mode_ctx,
+			     parked_link);
+	mutex_unlock(&parked_param_mu);
+}
+
+void vm_clean_parked_param(struct user_mode_ctx *uctx)
+{
+	unpark_param(uctx, NULL, 0);
+}
+
+void vm_revoke_parked_param(struct mobj *mobj)
+{
+	struct user_mode_ctx *uctx = NULL;
+	struct vm_region *r = NULL;
+	size_t n = 0;
+
+	mutex_lock(&parked_param_mu);
+	SLIST_FOREACH(uctx, &parked_param_ctxs, parked_link) {
+		for (n = 0; n < TEE_NUM_PARAMS; n++) {
+			r = uctx->parked_param[n];
+			if (r && r->mobj == mobj) {
+				r->mobj = NULL;
+				mobj_put(mobj);
+			}
+		}
+	}
+	mutex_unlock(&parked_param_mu);
 }
 
+static void forget_parked_param(struct user_mode_ctx *uctx)
+{
+	bool parked = false;
+	size_t n = 0;
+
+	mutex_lock(&parked_param_mu);
+	for (n = 0; n < TEE_NUM_PARAMS; n++) {
+		if (uctx->parked_param[n])
+			parked = true;
+		uctx->parked_param[n] = NULL;
+	}
+	if (parked)
+		SLIST_REMOVE(&parked_param_ctxs, uctx, user_mode_ctx,
+			     parked_link);
+	mutex_unlock(&parked_param_mu);
+}
+#else
+static void unpark_param(struct user_mode_ctx *uctx __unused,
+			 struct param_mem *mem __unused,
+			 size_t num_mem __unused)
+{
+}
+
+static void forget_parked_param(struct user_mode_ctx *uctx __unused)
+{
+}
+#endif
+
 static TEE_Result param_mem_to_user_va(struct user_mode_ctx *uctx,
 				       struct param_mem *mem, void **user_va)
 {
@@ -928,10 +1352,12 @@ static TEE_Result param_mem_to_user_va(struct user_mode_ctx *uctx,
 		vaddr_t va = 0;
 		size_t phys_offs = 0;
 
-		if (!(region->flags & VM_FLAG_EPHEMERAL))
+		if (!is_own_param(region))
 			continue;
 		if (mem->mobj != region->mobj)
 			continue;
+		if (mem->readonly != !(region->attr & TEE_MATTR_UW))
+			continue;
 
 		phys_offs = mobj_get_phys_offs(mem->mobj,
 					       CORE_MMU_USER_PARAM_SIZE);
@@ -969,6 +1395,10 @@ static int cmp_param_mem(const void *a0, const void *a1)
 	if (ret)
 		return ret;
 
+	ret = CMP_TRILEAN(m0->readonly, m1->readonly);
+	if (ret)
+		return ret;
+
 	ret = CMP_TRILEAN(m0->offs, m1->offs);
 	if (ret)
 		return ret;
@@ -996,6 +1426,7 @@ TEE_Result vm_map_param(struct user_mode_ctx *uctx, struct tee_ta_param *param,
 		phys_offs = mobj_get_phys_offs(param->u[n].mem.mobj,
 					       CORE_MMU_USER_PARAM_SIZE);
 		mem[n].mobj = param->u[n].mem.mobj;
+		mem[n].readonly = param->u[n].mem.readonly;
 		mem[n].offs = ROUNDDOWN(phys_offs + param->u[n].mem.offs,
 					CORE_MMU_USER_PARAM_SIZE);
 		mem[n].size = ROUNDUP(phys_offs + param->u[n].mem.offs -
@@ -1021,6 +1452,7 @@ TEE_Result vm_map_param(struct user_mode_ctx *uctx, struct tee_ta_param *param,
 
 	for (n = 1, m = 0; n < TEE_NUM_PARAMS && mem[n].mobj; n++) {
 		if (mem[n].mobj == mem[m].mobj &&
+		    mem[n].readonly == mem[m].readonly &&
 		    (mem[n].offs == (mem[m].offs + mem[m].size) ||
 		     core_is_buffer_intersect(mem[m].offs, mem[m].size,
 					      mem[n].offs, mem[n].size))) {
@@ -1040,12 +1472,19 @@ TEE_Result vm_map_param(struct user_mode_ctx *uctx, struct tee_ta_param *param,
 		m++;
 
 	check_param_map_empty(uctx);
+	unpark_param(uctx, mem, m);
 
 	for (n = 0; n < m; n++) {
+		uint32_t prot = TEE_MATTR_PRW | TEE_MATTR_URW;
 		vaddr_t va = 0;
 
-		res = vm_map(uctx, &va, mem[n].size,
-			     TEE_MATTR_PRW | TEE_MATTR_URW,
+		/* Already mapped by a parked mapping */
+		if (!mem[n].mobj)
+			continue;
+
+		if (mem[n].readonly)
+			prot = TEE_MATTR_PR | TEE_MATTR_UR;
+		res = vm_map(uctx, &va, mem[n].size, prot,
 			     VM_FLAG_EPHEMERAL | VM_FLAG_SHAREABLE,
 			     mem[n].mobj, mem[n].offs);
 		if (res)
@@ -1137,6 +1576,7 @@ void vm_info_final(struct user_mode_ctx *uctx)
 	asid_free(uctx->vm_info.asid);
 	uctx->vm_info.asid = 0;
 
+	forget_parked_param(uctx);
 	while (!TAILQ_EMPTY(&uctx->vm_info.regions))
 		umap_remove_region(&uctx->vm_info,
 				   TAILQ_FIRST(&uctx->vm_info.regions));
@@ -1146,16 +1586,12 @@ void vm_info_final(struct user_mode_ctx *uctx)
 bool vm_buf_is_inside_um_private(const struct user_mode_ctx *uctx,
 				 const void *va, size_t size)
 {
-	struct vm_region *r = NULL;
+	struct vm_region *r = find_vm_region(&uctx->vm_info, (vaddr_t)va);
 
-	TAILQ_FOREACH(r, &uctx->vm_info.regions, link) {
-		if (r->flags & VM_FLAGS_NONPRIV)
-			continue;
-		if (core_is_buffer_inside((vaddr_t)va, size, r->va, r->size))
-			return true;
-	}
+	if (!r || (r->flags & VM_FLAGS_NONPRIV))
+		return false;
 
-	return false;
+	return core_is_buffer_inside((vaddr_t)va, size, r->va, r->size);
 }
 
 /* return true only if buffer intersects TA private memory */
@@ -1163,8 +1599,17 @@ bool vm_buf_intersects_um_private(const struct user_mode_ctx *uctx,
 				  const void *va, size_t size)
 {
 	struct vm_region *r = NULL;
+	vaddr_t end_va = 0;
 
-	TAILQ_FOREACH(r, &uctx->vm_info.regions, link) {
+	if (ADD_OVERFLOW((vaddr_t)va, size, &end_va))
+		end_va = (vaddr_t)-1;
+
+	/* Start with the region covering or just preceding @va */
+	r = find_vm_region_before(&uctx->vm_info, (vaddr_t)va + 1);
+	if (!r)
+		r = TAILQ_FIRST(&uctx->vm_info.regions);
+
+	for (; r && r->va < end_va; r = TAILQ_NEXT(r, link)) {
 		if (r->attr & VM_FLAGS_NONPRIV)
 			continue;
 		if (core_is_buffer_intersect((vaddr_t)va, size, r->va, r->size))
@@ -1178,69 +1623,59 @@ TEE_Result vm_buf_to_mboj_offs(const struct user_mode_ctx *uctx,
 			       const void *va, size_t size,
 			       struct mobj **mobj, size_t *offs)
 {
-	struct vm_region *r = NULL;
+	struct vm_region *r = find_vm_region(&uctx->vm_info, (vaddr_t)va);
+	size_t poffs = 0;
 
-	TAILQ_FOREACH(r, &uctx->vm_info.regions, link) {
-		if (!r->mobj)
-			continue;
-		if (core_is_buffer_inside((vaddr_t)va, size, r->va, r->size)) {
-			size_t poffs;
+	if (!r || !r->mobj ||
+	    !core_is_buffer_inside((vaddr_t)va, size, r->va, r->size))
+		return TEE_ERROR_BAD_PARAMETERS;
 
-			poffs = mobj_get_phys_offs(r->mobj,
-						   CORE_MMU_USER_PARAM_SIZE);
-			*mobj = r->mobj;
-			*offs = (vaddr_t)va - r->va + r->offset - poffs;
-			return TEE_SUCCESS;
-		}
-	}
+	poffs = mobj_get_phys_offs(r->mobj, CORE_MMU_USER_PARAM_SIZE);
+	*mobj = r->mobj;
+	*offs = (vaddr_t)va - r->va + r->offset - poffs;
 
-	return TEE_ERROR_BAD_PARAMETERS;
+	return TEE_SUCCESS;
 }
 
 static TEE_Result tee_mmu_user_va2pa_attr(const struct user_mode_ctx *uctx,
 					  void *ua, paddr_t *pa, uint32_t *attr)
 {
-	struct vm_region *region = NULL;
+	struct vm_region *region = find_vm_region(&uctx->vm_info, (vaddr_t)ua);
 
-	TAILQ_FOREACH(region, &uctx->vm_info.regions, link) {
-		if (!core_is_buffer_inside((vaddr_t)ua, 1, region->va,
-					   region->size))
-			continue;
-
-		if (pa) {
-			TEE_Result res;
-			paddr_t p;
-			size_t offset;
-			size_t granule;
+	if (!region)
+		return TEE_ERROR_ACCESS_DENIED;
 
-			/*
-			 * mobj and input user address may each include
-			 * a specific offset-in-granule position.
-			 * Drop both to get target physical page base
-			 * address then apply only user address
-			 * offset-in-granule.
-			 * Mapping lowest granule is the small page.
-			 */
-			granule = MAX(region->mobj->phys_granule,
-				      (size_t)SMALL_PAGE_SIZE);
-			assert(!granule || IS_POWER_OF_TWO(granule));
+	if (pa) {
+		TEE_Result res;
+		paddr_t p;
+		size_t offset;
+		size_t granule;
 
-			offset = region->offset +
-				 ROUNDDOWN((vaddr_t)ua - region->va, granule);
+		/*
+		 * mobj and input user address may each include
+		 * a specific offset-in-granule position.
+		 * Drop both to get target physical page base
+		 * address then apply only user address
+		 * offset-in-granule.
+		 * Mapping lowest granule is the small page.
+		 */
+		granule = MAX(region->mobj->phys_granule,
+			      (size_t)SMALL_PAGE_SIZE);
+		assert(!granule || IS_POWER_OF_TWO(granule));
 
-			res = mobj_get_pa(region->mobj, offset, granule, &p);
-			if (res != TEE_SUCCESS)
-				return res;
+		offset = region->offset +
+			 ROUNDDOWN((vaddr_t)ua - region->va, granule);
 
-			*pa = p | ((vaddr_t)ua & (granule - 1));
-		}
-		if (attr)
-			*attr = region->attr;
+		res = mobj_get_pa(region->mobj, offset, granule, &p);
+		if (res != TEE_SUCCESS)
+			return res;
 
-		return TEE_SUCCESS;
+		*pa = p | ((vaddr_t)ua & (granule - 1));
 	}
+	if (attr)
+		*attr = region->attr;
 
-	return TEE_ERROR_ACCESS_DENIED;
+	return TEE_SUCCESS;
 }
 
 TEE_Result vm_va2pa(const struct user_mode_ctx *uctx, void *ua, paddr_t *pa)
@@ -1298,6 +1733,7 @@ void *vm_pa2va(const struct user_mode_ctx *uctx, paddr_t pa, size_t pa_size)
 TEE_Result vm_check_access_rights(const struct user_mode_ctx *uctx,
 				  uint32_t flags, uaddr_t uaddr, size_t len)
 {
+	struct vm_region *r = NULL;
 	uaddr_t a = 0;
 	uaddr_t end_addr = 0;
 	size_t addr_incr = MIN(CORE_MMU_USER_CODE_SIZE,
@@ -1318,13 +1754,18 @@ TEE_Result vm_check_access_rights(const struct user_mode_ctx *uctx,
 	   !vm_buf_is_inside_um_private(uctx, (void *)uaddr, len))
 		return TEE_ERROR_ACCESS_DENIED;
 
-	for (a = ROUNDDOWN(uaddr, addr_incr); a < end_addr; a += addr_incr) {
-		uint32_t attr;
-		TEE_Result res;
+	/*
+	 * The attributes are the same for the entire region so check one
+	 * region at a time instead of each page.
+	 */
+	for (a = ROUNDDOWN(uaddr, addr_incr); a < end_addr;
+	     a = r->va + r->size) {
+		uint32_t attr = 0;
 
-		res = tee_mmu_user_va2pa_attr(uctx, (void *)a, NULL, &attr);
-		if (res != TEE_SUCCESS)
-			return res;
+		r = find_vm_region(&uctx->vm_info, a);
+		if (!r)
+			return TEE_ERROR_ACCESS_DENIED;
+		attr = r->attr;
 
 		if ((flags & TEE_MEMORY_ACCESS_NONSECURE) &&
 		    (attr & TEE_MATTR_SECURE))
@@ -5,7 +5,9 @@
 #include <compiler.h>
 #include <stdio.h>
 #include <trace.h>
+#include <kernel/mutex.h>
 #include <kernel/pseudo_ta.h>
+#include <mm/mobj.h>
 #include <mm/tee_pager.h>
 #include <mm/tee_mm.h>
 #include <string.h>
@@ -18,6 +20,18 @@
 		{ 0xd96a5b40, 0xe2c7, 0xb1af, \
 			{ 0x87, 0x94, 0x10, 0x02, 0xa5, 0xd5, 0xc6, 0x1b } }
 
+/*
+ * STATS_CMD_PAGER_STATS - pager statistics
+ * [out]    value[0].a       Number of pages available for paging
+ * [out]    value[0].b       Number of pages registered with the pager
+ * [out]    value[1].a       Number of read-only pages loaded
+ * [out]    value[1].b       Number of read-write pages loaded
+ * [out]    value[2].a       Number of faults on hidden pages (hits)
+ * [out]    value[2].b       Number of released zero initialized pages
+ * [out]    value[3].a       Optional, number of pages loaded (misses)
+ * [out]    value[3].b       Optional, number of recently evicted pages
+ *                           which had to be loaded again (refaults)
+ */
 #define STATS_CMD_PAGER_STATS		0
 #define STATS_CMD_ALLOC_STATS		1
 #define STATS_CMD_MEMLEAK_STATS		2
@@ -37,6 +51,22 @@
  * uint32_t    Biggest byte size which allocation succeeded
  */
 #define STATS_CMD_TA_STATS		3
+/*
+ * STATS_CMD_SHM_MAP_STATS - core mappings of registered shared memory
+ * [out]    value[0].a       Bytes of core VA space used by the mappings
+ * [out]    value[0].b       Bytes of idle mappings kept for reuse
+ * [out]    value[1].a       Number of mappings reused from the idle ones
+ * [out]    value[1].b       Number of mappings created
+ * [out]    value[2].a       Number of idle mappings reclaimed
+ * [out]    value[2].b       Number of idle mappings
+ */
+#define STATS_CMD_SHM_MAP_STATS		4
+/*
+ * STATS_CMD_MUTEX_STATS - contended mutexes
+ * [out]    value[0].a       Number of mutexes acquired while spinning
+ * [out]    value[0].b       Number of waits in normal world for a mutex
+ */
+#define STATS_CMD_MUTEX_STATS		5
 
 #define STATS_NB_POOLS			4
 
@@ -120,12 +150,17 @@ static TEE_Result get_alloc_stats(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
 static TEE_Result get_pager_stats(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
 {
 	struct tee_pager_stats stats;
+	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT,
+					    TEE_PARAM_TYPE_VALUE_OUTPUT,
+					    TEE_PARAM_TYPE_VALUE_OUTPUT,
+					    TEE_PARAM_TYPE_NONE);
+	uint32_t exp_type4 = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT,
+					     TEE_PARAM_TYPE_VALUE_OUTPUT,
+					     TEE_PARAM_TYPE_VALUE_OUTPUT,
+					     TEE_PARAM_TYPE_VALUE_OUTPUT);
 
-	if (TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT,
-			    TEE_PARAM_TYPE_VALUE_OUTPUT,
-			    TEE_PARAM_TYPE_VALUE_OUTPUT,
-			    TEE_PARAM_TYPE_NONE) != type) {
-		EMSG("expect 3 output values as argument");
+	if (type != exp_type && type != exp_type4) {
+		EMSG("expect 3 or 4 output values as argument");
 		return TEE_ERROR_BAD_PARAMETERS;
 	}
 
@@ -136,6 +171,10 @@ static TEE_Result get_pager_stats(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
 	p[1].value.b = stats.rw_hits;
 	p[2].value.a = stats.hidden_hits;
 	p[2].value.b = stats.zi_released;
+	if (type == exp_type4) {
+		p[3].value.a = stats.misses;
+		p[3].value.b = stats.refaults;
+	}
 
 	return TEE_SUCCESS;
 }
@@ -175,6 +214,52 @@ static TEE_Result get_user_ta_stats(uint32_t type,
 	return res;
 }
 
+#if defined(CFG_CORE_DYN_SHM) && !defined(CFG_CORE_FFA)
+static TEE_Result get_shm_map_stats(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	struct mobj_reg_shm_map_stats stats = { };
+
+	if (TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_NONE) != type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	mobj_reg_shm_get_map_stats(&stats);
+	p[0].value.a = stats.mapped_bytes;
+	p[0].value.b = stats.idle_bytes;
+	p[1].value.a = stats.hits;
+	p[1].value.b = stats.misses;
+	p[2].value.a = stats.evictions;
+	p[2].value.b = stats.idle_count;
+
+	return TEE_SUCCESS;
+}
+#else
+static TEE_Result get_shm_map_stats(uint32_t type __unused,
+				    TEE_Param p[TEE_NUM_PARAMS] __unused)
+{
+	return TEE_ERROR_NOT_SUPPORTED;
+}
+#endif
+
+static TEE_Result get_mutex_stats(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	struct mutex_stats stats = { };
+
+	if (TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_NONE,
+			    TEE_PARAM_TYPE_NONE,
+			    TEE_PARAM_TYPE_NONE) != type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	mutex_get_stats(&stats);
+	p[0].value.a = stats.spin_acquired;
+	p[0].value.b = stats.sleeps;
+
+	return TEE_SUCCESS;
+}
+
 /*
  * Trusted Application Entry Points
  */
@@ -192,6 +277,10 @@ static TEE_Result invoke_command(void *psess __unused,
 		return get_memleak_stats(ptypes, params);
 	case STATS_CMD_TA_STATS:
 		return get_user_ta_stats(ptypes, params);
+	case STATS_CMD_SHM_MAP_STATS:
+		return get_shm_map_stats(ptypes, params);
+	case STATS_CMD_MUTEX_STATS:
+		return get_mutex_stats(ptypes, params);
 	default:
 		break;
 	}
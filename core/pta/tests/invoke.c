@@ -433,6 +433,8 @@ static TEE_Result invoke_command(void *pSessionContext __unused,
 		return core_aes_perf_tests(nParamTypes, pParams);
 	case PTA_INVOKE_TESTS_CMD_DT_DRIVER_TESTS:
 		return core_dt_driver_tests(nParamTypes, pParams);
+	case PTA_INVOKE_TESTS_CMD_SPINLOCK_BENCH:
+		return core_spinlock_bench_tests(nParamTypes, pParams);
 	default:
 		break;
 	}
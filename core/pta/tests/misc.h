@@ -31,6 +31,9 @@ static inline TEE_Result core_lockdep_tests(
 }
 #endif
 
+TEE_Result core_spinlock_bench_tests(uint32_t param_types,
+				      TEE_Param params[TEE_NUM_PARAMS]);
+
 TEE_Result core_aes_perf_tests(uint32_t param_types,
 			       TEE_Param params[TEE_NUM_PARAMS]);
 
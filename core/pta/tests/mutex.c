@@ -5,6 +5,7 @@
 
 #include <atomic.h>
 #include <kernel/mutex.h>
+#include <kernel/rwlock.h>
 #include <pta_invoke_tests.h>
 #include <trace.h>
 
@@ -19,14 +20,48 @@ static uint64_t val0;
 static uint64_t val1;
 
 struct mutex test_mutex = MUTEX_INITIALIZER;
+static struct rwlock test_rwlock = RWLOCK_INITIALIZER;
 
-static TEE_Result mutex_test_writer(TEE_Param params[TEE_NUM_PARAMS])
+static void test_write_lock(bool rwlock)
+{
+	if (rwlock)
+		rwlock_write_lock(&test_rwlock);
+	else
+		mutex_lock(&test_mutex);
+}
+
+static void test_write_unlock(bool rwlock)
+{
+	if (rwlock)
+		rwlock_write_unlock(&test_rwlock);
+	else
+		mutex_unlock(&test_mutex);
+}
+
+static void test_read_lock(bool rwlock)
+{
+	if (rwlock)
+		rwlock_read_lock(&test_rwlock);
+	else
+		mutex_read_lock(&test_mutex);
+}
+
+static void test_read_unlock(bool rwlock)
+{
+	if (rwlock)
+		rwlock_read_unlock(&test_rwlock);
+	else
+		mutex_read_unlock(&test_mutex);
+}
+
+static TEE_Result mutex_test_writer(TEE_Param params[TEE_NUM_PARAMS],
+				    bool rwlock)
 {
 	size_t n;
 
 	params[1].value.a = atomic_inc32(&before_lock_writers);
 
-	mutex_lock(&test_mutex);
+	test_write_lock(rwlock);
 
 	atomic_dec32(&before_lock_writers);
 
@@ -39,19 +74,20 @@ static TEE_Result mutex_test_writer(TEE_Param params[TEE_NUM_PARAMS])
 	}
 
 	atomic_dec32(&during_lock_writers);
-	mutex_unlock(&test_mutex);
+	test_write_unlock(rwlock);
 
 	return TEE_SUCCESS;
 }
 
-static TEE_Result mutex_test_reader(TEE_Param params[TEE_NUM_PARAMS])
+static TEE_Result mutex_test_reader(TEE_Param params[TEE_NUM_PARAMS],
+				    bool rwlock)
 {
 	TEE_Result res = TEE_SUCCESS;
 	size_t n;
 
 	params[1].value.a = atomic_inc32(&before_lock_readers);
 
-	mutex_read_lock(&test_mutex);
+	test_read_lock(rwlock);
 
 	atomic_dec32(&before_lock_readers);
 
@@ -63,7 +99,7 @@ static TEE_Result mutex_test_reader(TEE_Param params[TEE_NUM_PARAMS])
 	}
 
 	atomic_dec32(&during_lock_readers);
-	mutex_read_unlock(&test_mutex);
+	test_read_unlock(rwlock);
 
 	return res;
 }
@@ -83,9 +119,13 @@ TEE_Result core_mutex_tests(uint32_t param_types,
 
 	switch (params[0].value.a) {
 	case PTA_MUTEX_TEST_WRITER:
-		return mutex_test_writer(params);
+		return mutex_test_writer(params, false);
 	case PTA_MUTEX_TEST_READER:
-		return mutex_test_reader(params);
+		return mutex_test_reader(params, false);
+	case PTA_MUTEX_TEST_RWLOCK_WRITER:
+		return mutex_test_writer(params, true);
+	case PTA_MUTEX_TEST_RWLOCK_READER:
+		return mutex_test_reader(params, true);
 	default:
 		return TEE_ERROR_BAD_PARAMETERS;
 	}
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: BSD-2-Clause
+/*
+ * Copyright (c) 2026, Analog Devices, Inc.
+ */
+
+#include <atomic.h>
+#include <kernel/delay.h>
+#include <kernel/spinlock.h>
+#include <pta_invoke_tests.h>
+#include <trace.h>
+
+#include "misc.h"
+
+static unsigned int bench_lock = SPINLOCK_UNLOCK;
+static uint32_t bench_users;
+static unsigned int bench_max_users;
+static uint32_t bench_holders;
+/* Volatile so the work done while holding the lock isn't optimized out */
+static volatile uint64_t bench_val;
+
+TEE_Result core_spinlock_bench_tests(uint32_t param_types,
+				     TEE_Param params[TEE_NUM_PARAMS])
+{
+	uint32_t exp_pt = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+					  TEE_PARAM_TYPE_VALUE_OUTPUT,
+					  TEE_PARAM_TYPE_NONE,
+					  TEE_PARAM_TYPE_NONE);
+	TEE_Result res = TEE_SUCCESS;
+	uint32_t exceptions = 0;
+	uint64_t timeout = 0;
+	uint32_t count = 0;
+	uint32_t users = 0;
+	unsigned int max = 0;
+	size_t n = 0;
+
+	if (exp_pt != param_types) {
+		DMSG("bad parameter types");
+		return TEE_ERROR_BAD_PARAMETERS;
+	}
+
+	users = atomic_inc32(&bench_users);
+	max = atomic_load_uint(&bench_max_users);
+	while (users > max &&
+	       !atomic_cas_uint(&bench_max_users, &max, users))
+		;
+
+	timeout = timeout_init_us(params[0].value.a);
+	while (!timeout_elapsed(timeout)) {
+		exceptions = cpu_spin_lock_xsave(&bench_lock);
+
+		if (atomic_inc32(&bench_holders) != 1)
+			res = TEE_ERROR_BAD_STATE;
+		for (n = 0; n < params[0].value.b; n++)
+			bench_val++;
+		atomic_dec32(&bench_holders);
+
+		cpu_spin_unlock_xrestore(&bench_lock, exceptions);
+		count++;
+	}
+
+	params[1].value.a = count;
+	params[1].value.b = atomic_load_uint(&bench_max_users);
+
+	if (!atomic_dec32(&bench_users))
+		atomic_store_uint(&bench_max_users, 0);
+
+	return res;
+}
@@ -20,6 +20,7 @@
 #include <optee_msg.h>
 #include <string.h>
 #include <tee/entry_std.h>
+#include <tee/msg_ring.h>
 #include <tee/tee_cryp_utl.h>
 #include <tee/uuid.h>
 #include <util.h>
@@ -520,6 +521,24 @@ static void unregister_shm(struct optee_msg_arg *arg, uint32_t num_params)
 #endif /*CFG_CORE_DYN_SHM*/
 #endif
 
+TEE_Result tee_entry_std_session_cmd(struct optee_msg_arg *arg,
+				     uint32_t num_params, uint32_t cmd)
+{
+	switch (cmd) {
+	case OPTEE_MSG_CMD_OPEN_SESSION:
+		entry_open_session(arg, num_params);
+		return TEE_SUCCESS;
+	case OPTEE_MSG_CMD_CLOSE_SESSION:
+		entry_close_session(arg, num_params);
+		return TEE_SUCCESS;
+	case OPTEE_MSG_CMD_INVOKE_COMMAND:
+		entry_invoke_command(arg, num_params);
+		return TEE_SUCCESS;
+	default:
+		return TEE_ERROR_NOT_IMPLEMENTED;
+	}
+}
+
 void nsec_sessions_list_head(struct tee_ta_session_head **open_sessions)
 {
 	*open_sessions = &tee_open_sessions;
@@ -563,6 +582,17 @@ TEE_Result __tee_entry_std(struct optee_msg_arg *arg, uint32_t num_params)
 		unregister_shm(arg, num_params);
 		break;
 #endif
+#endif
+#ifdef CFG_CORE_MSG_RING
+	case OPTEE_MSG_CMD_REGISTER_RING:
+		msg_ring_register(arg, num_params);
+		break;
+	case OPTEE_MSG_CMD_UNREGISTER_RING:
+		msg_ring_unregister(arg, num_params);
+		break;
+	case OPTEE_MSG_CMD_DRAIN_RING:
+		msg_ring_drain(arg, num_params);
+		break;
 #endif
 
 	case OPTEE_MSG_CMD_DO_BOTTOM_HALF:
@@ -7,6 +7,7 @@
 #include <crypto/crypto.h>
 #include <initcall.h>
 #include <kernel/tee_common_otp.h>
+#include <kernel/user_access.h>
 #include <stdlib.h>
 #include <string_ext.h>
 #include <string.h>
@@ -807,8 +808,8 @@ static TEE_Result get_block_node(struct tee_fs_htree *ht, bool create,
 	return res;
 }
 
-TEE_Result tee_fs_htree_write_block(struct tee_fs_htree **ht_arg,
-				    size_t block_num, const void *block)
+static TEE_Result write_block(struct tee_fs_htree **ht_arg, size_t block_num,
+			      const void *block, bool user_block)
 {
 	struct tee_fs_htree *ht = *ht_arg;
 	TEE_Result res;
@@ -839,8 +840,12 @@ TEE_Result tee_fs_htree_write_block(struct tee_fs_htree **ht_arg,
 			   ht->stor->block_size);
 	if (res != TEE_SUCCESS)
 		goto out;
+	if (user_block)
+		enter_user_access();
 	res = authenc_encrypt_final(ctx, node->node.tag, block,
 				    ht->stor->block_size, enc_block);
+	if (user_block)
+		exit_user_access();
 	if (res != TEE_SUCCESS)
 		goto out;
 
@@ -857,8 +862,21 @@ out:
 	return res;
 }
 
-TEE_Result tee_fs_htree_read_block(struct tee_fs_htree **ht_arg,
-				   size_t block_num, void *block)
+TEE_Result tee_fs_htree_write_block(struct tee_fs_htree **ht_arg,
+				    size_t block_num, const void *block)
+{
+	return write_block(ht_arg, block_num, block, false);
+}
+
+TEE_Result tee_fs_htree_write_user_block(struct tee_fs_htree **ht_arg,
+					 size_t block_num,
+					 const void *user_block)
+{
+	return write_block(ht_arg, block_num, user_block, true);
+}
+
+static TEE_Result read_block(struct tee_fs_htree **ht_arg, size_t block_num,
+			     void *block, bool user_block)
 {
 	struct tee_fs_htree *ht = *ht_arg;
 	TEE_Result res;
@@ -896,14 +914,33 @@ TEE_Result tee_fs_htree_read_block(struct tee_fs_htree **ht_arg,
 	if (res != TEE_SUCCESS)
 		goto out;
 
+	if (user_block)
+		enter_user_access();
 	res = authenc_decrypt_final(ctx, node->node.tag, enc_block,
 				    ht->stor->block_size, block);
+	/* Don't leave unauthenticated plaintext behind in user space */
+	if (user_block && res != TEE_SUCCESS)
+		memset(block, 0, ht->stor->block_size);
+	if (user_block)
+		exit_user_access();
 out:
 	if (res != TEE_SUCCESS)
 		tee_fs_htree_close(ht_arg);
 	return res;
 }
 
+TEE_Result tee_fs_htree_read_block(struct tee_fs_htree **ht_arg,
+				   size_t block_num, void *block)
+{
+	return read_block(ht_arg, block_num, block, false);
+}
+
+TEE_Result tee_fs_htree_read_user_block(struct tee_fs_htree **ht_arg,
+					size_t block_num, void *user_block)
+{
+	return read_block(ht_arg, block_num, user_block, true);
+}
+
 TEE_Result tee_fs_htree_truncate(struct tee_fs_htree **ht_arg, size_t block_num)
 {
 	struct tee_fs_htree *ht = *ht_arg;
@@ -0,0 +1,287 @@
+// SPDX-License-Identifier: BSD-2-Clause
+/*
+ * Copyright (c) 2026, Analog Devices, Inc.
+ */
+
+#include <compiler.h>
+#include <io.h>
+#include <kernel/mutex.h>
+#include <kernel/notif.h>
+#include <kernel/panic.h>
+#include <malloc.h>
+#include <mm/mobj.h>
+#include <optee_msg.h>
+#include <string.h>
+#include <tee/entry_std.h>
+#include <tee/msg_ring.h>
+#include <trace.h>
+#include <util.h>
+
+/* Upper limit of ring entries, keeps the queues within a few pages */
+#define MSG_RING_MAX_ENTRIES	U(1024)
+
+/*
+ * struct msg_ring - a registered submission/completion ring
+ * @mobj:	 Registered shared memory holding the ring
+ * @hdr:	 Ring header in shared memory
+ * @sq:		 Submission queue in shared memory
+ * @cq:		 Completion queue in shared memory
+ * @entries:	 First entry in shared memory
+ * @num_entries: Number of entries, copied from @hdr at registration
+ * @entry_size:	 Size of an entry, copied from @hdr at registration
+ * @max_params:	 Number of parameters fitting in an entry
+ * @sq_head:	 Secure copy of next submission to consume
+ * @cq_tail:	 Secure copy of next completion to produce
+ * @notif_value: Asynchronous notification value signalled on completion
+ * @drain_count: Number of threads currently draining the ring
+ *
+ * Fields read from @hdr are only trusted when the ring is registered, the
+ * rest is kept in secure memory since normal world may change @hdr at
+ * any time.
+ */
+struct msg_ring {
+	struct mobj *mobj;
+	struct optee_msg_ring *hdr;
+	uint32_t *sq;
+	uint32_t *cq;
+	uint8_t *entries;
+	uint32_t num_entries;
+	uint32_t entry_size;
+	uint32_t max_params;
+	uint32_t sq_head;
+	uint32_t cq_tail;
+	uint32_t notif_value;
+	unsigned int drain_count;
+};
+
+static struct msg_ring *msg_ring;
+static struct mutex msg_ring_mu = MUTEX_INITIALIZER;
+static struct condvar msg_ring_cv = CONDVAR_INITIALIZER;
+
+static void set_result(struct optee_msg_arg *arg, TEE_Result res)
+{
+	arg->ret = res;
+	arg->ret_origin = TEE_ORIGIN_TEE;
+}
+
+static TEE_Result map_ring(struct msg_ring *r,
+			   const struct optee_msg_param_rmem *rmem)
+{
+	size_t entries_offs = 0;
+	size_t sz = 0;
+	void *va = NULL;
+
+	r->mobj = mobj_reg_shm_get_by_cookie(rmem->shm_ref);
+	if (!r->mobj)
+		return TEE_ERROR_BAD_PARAMETERS;
+	if (mobj_inc_map(r->mobj)) {
+		mobj_put(r->mobj);
+		r->mobj = NULL;
+		return TEE_ERROR_OUT_OF_MEMORY;
+	}
+
+	r->hdr = mobj_get_va(r->mobj, rmem->offs, sizeof(*r->hdr));
+	if (!r->hdr || !IS_ALIGNED_WITH_TYPE(r->hdr, uint64_t))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	r->num_entries = READ_ONCE(r->hdr->num_entries);
+	r->entry_size = READ_ONCE(r->hdr->entry_size);
+	if (!r->num_entries || r->num_entries > MSG_RING_MAX_ENTRIES ||
+	    !IS_POWER_OF_TWO(r->num_entries))
+		return TEE_ERROR_BAD_PARAMETERS;
+	if (r->entry_size < OPTEE_MSG_GET_ARG_SIZE(0) ||
+	    r->entry_size > OPTEE_MSG_GET_ARG_SIZE(OPTEE_MSG_MAX_NUM_PARAMS) ||
+	    !IS_ALIGNED(r->entry_size, 8))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	entries_offs = OPTEE_MSG_RING_ENTRIES_OFFS(r->num_entries);
+	sz = entries_offs + r->num_entries * r->entry_size;
+	if (sz > rmem->size)
+		return TEE_ERROR_BAD_PARAMETERS;
+	va = mobj_get_va(r->mobj, rmem->offs, sz);
+	if (!va)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	r->sq = r->hdr->queues;
+	r->cq = r->hdr->queues + r->num_entries;
+	r->entries = (uint8_t *)va + entries_offs;
+	r->max_params = (r->entry_size - OPTEE_MSG_GET_ARG_SIZE(0)) /
+			sizeof(struct optee_msg_param);
+	r->sq_head = READ_ONCE(r->hdr->sq_head);
+	r->cq_tail = READ_ONCE(r->hdr->cq_tail);
+
+	return TEE_SUCCESS;
+}
+
+static void free_ring(struct msg_ring *r)
+{
+	if (r->mobj) {
+		mobj_dec_map(r->mobj);
+		mobj_put(r->mobj);
+	}
+	free(r);
+}
+
+void msg_ring_register(struct optee_msg_arg *arg, uint32_t num_params)
+{
+	struct msg_ring *r = NULL;
+	TEE_Result res = TEE_SUCCESS;
+
+	if (num_params != 2 ||
+	    arg->params[0].attr != OPTEE_MSG_ATTR_TYPE_RMEM_INPUT ||
+	    arg->params[1].attr != OPTEE_MSG_ATTR_TYPE_VALUE_OUTPUT) {
+		set_result(arg, TEE_ERROR_BAD_PARAMETERS);
+		return;
+	}
+
+	r = calloc(1, sizeof(*r));
+	if (!r) {
+		set_result(arg, TEE_ERROR_OUT_OF_MEMORY);
+		return;
+	}
+
+	res = map_ring(r, &arg->params[0].u.rmem);
+	if (res)
+		goto err;
+
+	res = notif_alloc_async_value(&r->notif_value);
+	if (res)
+		goto err;
+
+	mutex_lock(&msg_ring_mu);
+	if (msg_ring) {
+		mutex_unlock(&msg_ring_mu);
+		notif_free_async_value(r->notif_value);
+		res = TEE_ERROR_BUSY;
+		goto err;
+	}
+	msg_ring = r;
+	mutex_unlock(&msg_ring_mu);
+
+	arg->params[1].u.value.a = r->notif_value;
+	arg->params[1].u.value.b = 0;
+	arg->params[1].u.value.c = 0;
+	set_result(arg, TEE_SUCCESS);
+	return;
+err:
+	free_ring(r);
+	set_result(arg, res);
+}
+
+void msg_ring_unregister(struct optee_msg_arg *arg, uint32_t num_params)
+{
+	struct msg_ring *r = NULL;
+
+	if (num_params) {
+		set_result(arg, TEE_ERROR_BAD_PARAMETERS);
+		return;
+	}
+
+	mutex_lock(&msg_ring_mu);
+	r = msg_ring;
+	msg_ring = NULL;
+	while (r && r->drain_count)
+		condvar_wait(&msg_ring_cv, &msg_ring_mu);
+	mutex_unlock(&msg_ring_mu);
+
+	if (!r) {
+		set_result(arg, TEE_ERROR_ITEM_NOT_FOUND);
+		return;
+	}
+
+	notif_free_async_value(r->notif_value);
+	free_ring(r);
+	set_result(arg, TEE_SUCCESS);
+}
+
+/*
+ * Returns the number of the next submitted entry or UINT32_MAX if the
+ * submission queue is empty or corrupt. Called with msg_ring_mu held.
+ */
+static uint32_t pop_submission(struct msg_ring *r)
+{
+	uint32_t tail = __atomic_load_n(&r->hdr->sq_tail, __ATOMIC_ACQUIRE);
+	uint32_t idx = 0;
+
+	if (tail == r->sq_head)
+		return UINT32_MAX;
+	if (tail - r->sq_head > r->num_entries) {
+		EMSG("Corrupt submission queue");
+		return UINT32_MAX;
+	}
+
+	idx = READ_ONCE(r->sq[r->sq_head & (r->num_entries - 1)]);
+	r->sq_head++;
+	__atomic_store_n(&r->hdr->sq_head, r->sq_head, __ATOMIC_RELEASE);
+
+	return idx;
+}
+
+/* Called with msg_ring_mu held */
+static void push_completion(struct msg_ring *r, uint32_t idx)
+{
+	r->cq[r->cq_tail & (r->num_entries - 1)] = idx;
+	r->cq_tail++;
+	__atomic_store_n(&r->hdr->cq_tail, r->cq_tail, __ATOMIC_RELEASE);
+}
+
+static void process_entry(struct msg_ring *r, uint32_t idx)
+{
+	struct optee_msg_arg *arg = NULL;
+	uint32_t num_params = 0;
+	uint32_t cmd = 0;
+
+	arg = (void *)(r->entries + (size_t)idx * r->entry_size);
+	cmd = READ_ONCE(arg->cmd);
+	num_params = READ_ONCE(arg->num_params);
+	if (num_params > r->max_params ||
+	    tee_entry_std_session_cmd(arg, num_params, cmd))
+		set_result(arg, TEE_ERROR_BAD_PARAMETERS);
+}
+
+void msg_ring_drain(struct optee_msg_arg *arg, uint32_t num_params)
+{
+	struct msg_ring *r = NULL;
+	uint32_t idx = 0;
+
+	if (num_params) {
+		set_result(arg, TEE_ERROR_BAD_PARAMETERS);
+		return;
+	}
+
+	mutex_lock(&msg_ring_mu);
+	r = msg_ring;
+	if (!r) {
+		mutex_unlock(&msg_ring_mu);
+		set_result(arg, TEE_ERROR_ITEM_NOT_FOUND);
+		return;
+	}
+	r->drain_count++;
+
+	while (msg_ring == r) {
+		idx = pop_submission(r);
+		if (idx == UINT32_MAX)
+			break;
+		if (idx >= r->num_entries) {
+			EMSG("Bad ring entry %"PRIu32, idx);
+			/* Complete it so normal world doesn't wait for it */
+			push_completion(r, idx | OPTEE_MSG_RING_CQ_ERROR);
+			notif_send_async(r->notif_value);
+			continue;
+		}
+		mutex_unlock(&msg_ring_mu);
+
+		process_entry(r, idx);
+
+		mutex_lock(&msg_ring_mu);
+		push_completion(r, idx);
+		notif_send_async(r->notif_value);
+	}
+
+	r->drain_count--;
+	if (!r->drain_count)
+		condvar_broadcast(&msg_ring_cv);
+	mutex_unlock(&msg_ring_mu);
+
+	set_result(arg, TEE_SUCCESS);
+}
@@ -7,8 +7,10 @@
 #include <config.h>
 #include <kernel/mutex.h>
 #include <kernel/panic.h>
+#include <kernel/rwlock.h>
 #include <kernel/thread.h>
 #include <kernel/user_access.h>
+#include <memtag.h>
 #include <mempool.h>
 #include <mm/core_memprot.h>
 #include <mm/tee_pager.h>
@@ -36,6 +38,7 @@ struct tee_fs_fd {
 	int fd;
 	struct tee_fs_dirfile_fileh dfh;
 	const TEE_UUID *uuid;
+	struct mutex read_mu;	/* serializes readers of this file handle */
 };
 
 struct tee_fs_dir {
@@ -50,7 +53,13 @@ static int pos_to_block_num(int position)
 	return position >> BLOCK_SHIFT;
 }
 
-static struct mutex ree_fs_mutex = MUTEX_INITIALIZER;
+/*
+ * Reading a file only needs the file handle, all other operations may
+ * update the directory file so they take the lock exclusively. Reads of
+ * the same file handle are serialized with tee_fs_fd::read_mu since a
+ * failed read closes the hash tree of the file.
+ */
+static struct rwlock ree_fs_rwlock = RWLOCK_INITIALIZER;
 
 static void *get_tmp_block(void)
 {
@@ -62,6 +71,23 @@ static void put_tmp_block(void *tmp_block)
 	mempool_free(mempool_default, tmp_block);
 }
 
+/*
+ * With CFG_REE_FS_ZERO_COPY a complete block of a user buffer is
+ * encrypted from or decrypted into the user buffer directly instead of
+ * going through a temporary block.
+ */
+static bool is_user_block(const void *buf_user, size_t offset, size_t size,
+			  uint32_t flags)
+{
+	if (!IS_ENABLED(CFG_REE_FS_ZERO_COPY) || !buf_user || offset ||
+	    size != BLOCK_SIZE)
+		return false;
+
+	return !check_user_access(flags | TEE_MEMORY_ACCESS_ANY_OWNER,
+				  memtag_strip_tag_const(buf_user),
+				  BLOCK_SIZE);
+}
+
 static TEE_Result out_of_place_write(struct tee_fs_fd *fdp, size_t pos,
 				     const void *buf_core,
 				     const void *buf_user, size_t len)
@@ -94,6 +120,16 @@ static TEE_Result out_of_place_write(struct tee_fs_fd *fdp, size_t pos,
 		if (size_to_write + offset > BLOCK_SIZE)
 			size_to_write = BLOCK_SIZE - offset;
 
+		if (is_user_block(data_user_ptr, offset, size_to_write,
+				  TEE_MEMORY_ACCESS_READ)) {
+			res = tee_fs_htree_write_user_block(&fdp->ht,
+						start_block_num,
+						memtag_strip_tag(data_user_ptr));
+			if (res != TEE_SUCCESS)
+				goto exit;
+			goto next;
+		}
+
 		if (start_block_num * BLOCK_SIZE <
 		    ROUNDUP(meta->length, BLOCK_SIZE)) {
 			res = tee_fs_htree_read_block(&fdp->ht,
@@ -110,7 +146,7 @@ static TEE_Result out_of_place_write(struct tee_fs_fd *fdp, size_t pos,
 			res = copy_from_user(block + offset, data_user_ptr,
 					     size_to_write);
 			if (res)
-				return res;
+				goto exit;
 		} else {
 			memset(block + offset, 0, size_to_write);
 		}
@@ -119,7 +155,7 @@ static TEE_Result out_of_place_write(struct tee_fs_fd *fdp, size_t pos,
 					       block);
 		if (res != TEE_SUCCESS)
 			goto exit;
-
+next:
 		if (data_core_ptr)
 			data_core_ptr += size_to_write;
 		if (data_user_ptr)
@@ -353,6 +389,17 @@ static TEE_Result ree_fs_read_primitive(struct tee_file_handle *fh, size_t pos,
 		if (size_to_read + offset > BLOCK_SIZE)
 			size_to_read = BLOCK_SIZE - offset;
 
+		if (is_user_block(data_user_ptr, offset, size_to_read,
+				  TEE_MEMORY_ACCESS_WRITE)) {
+			res = tee_fs_htree_read_user_block(&fdp->ht,
+						start_block_num,
+						memtag_strip_tag(data_user_ptr));
+			if (res != TEE_SUCCESS)
+				goto exit;
+			data_user_ptr += size_to_read;
+			goto next;
+		}
+
 		res = tee_fs_htree_read_block(&fdp->ht, start_block_num, block);
 		if (res != TEE_SUCCESS)
 			goto exit;
@@ -367,7 +414,7 @@ static TEE_Result ree_fs_read_primitive(struct tee_file_handle *fh, size_t pos,
 				goto exit;
 			data_user_ptr += size_to_read;
 		}
-
+next:
 		remain_bytes -= size_to_read;
 		pos += size_to_read;
 
@@ -383,11 +430,14 @@ exit:
 static TEE_Result ree_fs_read(struct tee_file_handle *fh, size_t pos,
 			      void *buf_core, void *buf_user, size_t *len)
 {
+	struct tee_fs_fd *fdp = (struct tee_fs_fd *)fh;
 	TEE_Result res;
 
-	mutex_lock(&ree_fs_mutex);
+	rwlock_read_lock(&ree_fs_rwlock);
+	mutex_lock(&fdp->read_mu);
 	res = ree_fs_read_primitive(fh, pos, buf_core, buf_user, len);
-	mutex_unlock(&ree_fs_mutex);
+	mutex_unlock(&fdp->read_mu);
+	rwlock_read_unlock(&ree_fs_rwlock);
 
 	return res;
 }
@@ -433,6 +483,7 @@ static TEE_Result ree_fs_open_primitive(bool create, uint8_t *hash,
 		return TEE_ERROR_OUT_OF_MEMORY;
 	fdp->fd = -1;
 	fdp->uuid = uuid;
+	mutex_init(&fdp->read_mu);
 
 	if (create)
 		res = tee_fs_rpc_create_dfh(OPTEE_RPC_CMD_FS,
@@ -459,6 +510,7 @@ out:
 			tee_fs_rpc_close(OPTEE_RPC_CMD_FS, fdp->fd);
 		if (create)
 			tee_fs_rpc_remove_dfh(OPTEE_RPC_CMD_FS, dfh);
+		mutex_destroy(&fdp->read_mu);
 		free(fdp);
 	}
 
@@ -472,6 +524,7 @@ static void ree_fs_close_primitive(struct tee_file_handle *fh)
 	if (fdp) {
 		tee_fs_htree_close(&fdp->ht);
 		tee_fs_rpc_close(OPTEE_RPC_CMD_FS, fdp->fd);
+		mutex_destroy(&fdp->read_mu);
 		free(fdp);
 	}
 }
@@ -662,7 +715,7 @@ static TEE_Result ree_fs_open(struct tee_pobj *po, size_t *size,
 	struct tee_fs_dirfile_dirh *dirh = NULL;
 	struct tee_fs_dirfile_fileh dfh;
 
-	mutex_lock(&ree_fs_mutex);
+	rwlock_write_lock(&ree_fs_rwlock);
 
 	res = get_dirh(&dirh);
 	if (res != TEE_SUCCESS)
@@ -689,7 +742,7 @@ static TEE_Result ree_fs_open(struct tee_pobj *po, size_t *size,
 out:
 	if (res)
 		put_dirh(dirh, true);
-	mutex_unlock(&ree_fs_mutex);
+	rwlock_write_unlock(&ree_fs_rwlock);
 
 	return res;
 }
@@ -734,11 +787,11 @@ static TEE_Result set_name(struct tee_fs_dirfile_dirh *dirh,
 static void ree_fs_close(struct tee_file_handle **fh)
 {
 	if (*fh) {
-		mutex_lock(&ree_fs_mutex);
+		rwlock_write_lock(&ree_fs_rwlock);
 		put_dirh_primitive(false);
 		ree_fs_close_primitive(*fh);
 		*fh = NULL;
-		mutex_unlock(&ree_fs_mutex);
+		rwlock_write_unlock(&ree_fs_rwlock);
 
 	}
 }
@@ -759,7 +812,7 @@ static TEE_Result ree_fs_create(struct tee_pobj *po, bool overwrite,
 	assert(!data_core || !data_user);
 
 	*fh = NULL;
-	mutex_lock(&ree_fs_mutex);
+	rwlock_write_lock(&ree_fs_rwlock);
 
 	res = get_dirh(&dirh);
 	if (res)
@@ -809,7 +862,7 @@ out:
 			tee_fs_rpc_remove_dfh(OPTEE_RPC_CMD_FS, &dfh);
 		}
 	}
-	mutex_unlock(&ree_fs_mutex);
+	rwlock_write_unlock(&ree_fs_rwlock);
 
 	return res;
 }
@@ -825,7 +878,7 @@ static TEE_Result ree_fs_write(struct tee_file_handle *fh, size_t pos,
 	/* One of buf_core and buf_user must be NULL */
 	assert(!buf_core || !buf_user);
 
-	mutex_lock(&ree_fs_mutex);
+	rwlock_write_lock(&ree_fs_rwlock);
 
 	res = get_dirh(&dirh);
 	if (res)
@@ -845,7 +898,7 @@ static TEE_Result ree_fs_write(struct tee_file_handle *fh, size_t pos,
 	res = commit_dirh_writes(dirh);
 out:
 	put_dirh(dirh, res);
-	mutex_unlock(&ree_fs_mutex);
+	rwlock_write_unlock(&ree_fs_rwlock);
 
 	return res;
 }
@@ -861,7 +914,7 @@ static TEE_Result ree_fs_rename(struct tee_pobj *old, struct tee_pobj *new,
 	if (!new)
 		return TEE_ERROR_BAD_PARAMETERS;
 
-	mutex_lock(&ree_fs_mutex);
+	rwlock_write_lock(&ree_fs_rwlock);
 	res = get_dirh(&dirh);
 	if (res)
 		goto out;
@@ -898,7 +951,7 @@ static TEE_Result ree_fs_rename(struct tee_pobj *old, struct tee_pobj *new,
 
 out:
 	put_dirh(dirh, res);
-	mutex_unlock(&ree_fs_mutex);
+	rwlock_write_unlock(&ree_fs_rwlock);
 
 	return res;
 
@@ -910,7 +963,7 @@ static TEE_Result ree_fs_remove(struct tee_pobj *po)
 	struct tee_fs_dirfile_dirh *dirh = NULL;
 	struct tee_fs_dirfile_fileh dfh;
 
-	mutex_lock(&ree_fs_mutex);
+	rwlock_write_lock(&ree_fs_rwlock);
 	res = get_dirh(&dirh);
 	if (res)
 		goto out;
@@ -934,7 +987,7 @@ static TEE_Result ree_fs_remove(struct tee_pobj *po)
 				   &dfh));
 out:
 	put_dirh(dirh, res);
-	mutex_unlock(&ree_fs_mutex);
+	rwlock_write_unlock(&ree_fs_rwlock);
 
 	return res;
 }
@@ -945,7 +998,7 @@ static TEE_Result ree_fs_truncate(struct tee_file_handle *fh, size_t len)
 	struct tee_fs_dirfile_dirh *dirh = NULL;
 	struct tee_fs_fd *fdp = (struct tee_fs_fd *)fh;
 
-	mutex_lock(&ree_fs_mutex);
+	rwlock_write_lock(&ree_fs_rwlock);
 
 	res = get_dirh(&dirh);
 	if (res)
@@ -965,7 +1018,7 @@ static TEE_Result ree_fs_truncate(struct tee_file_handle *fh, size_t len)
 	res = commit_dirh_writes(dirh);
 out:
 	put_dirh(dirh, res);
-	mutex_unlock(&ree_fs_mutex);
+	rwlock_write_unlock(&ree_fs_rwlock);
 
 	return res;
 }
@@ -982,7 +1035,7 @@ static TEE_Result ree_fs_opendir_rpc(const TEE_UUID *uuid,
 
 	d->uuid = uuid;
 
-	mutex_lock(&ree_fs_mutex);
+	rwlock_write_lock(&ree_fs_rwlock);
 
 	res = get_dirh(&d->dirh);
 	if (res)
@@ -1003,7 +1056,7 @@ out:
 			put_dirh(d->dirh, false);
 		free(d);
 	}
-	mutex_unlock(&ree_fs_mutex);
+	rwlock_write_unlock(&ree_fs_rwlock);
 
 	return res;
 }
@@ -1011,12 +1064,12 @@ out:
 static void ree_fs_closedir_rpc(struct tee_fs_dir *d)
 {
 	if (d) {
-		mutex_lock(&ree_fs_mutex);
+		rwlock_write_lock(&ree_fs_rwlock);
 
 		put_dirh(d->dirh, false);
 		free(d);
 
-		mutex_unlock(&ree_fs_mutex);
+		rwlock_write_unlock(&ree_fs_rwlock);
 	}
 }
 
@@ -1025,7 +1078,7 @@ static TEE_Result ree_fs_readdir_rpc(struct tee_fs_dir *d,
 {
 	TEE_Result res;
 
-	mutex_lock(&ree_fs_mutex);
+	rwlock_write_lock(&ree_fs_rwlock);
 
 	d->d.oidlen = sizeof(d->d.oid);
 	res = tee_fs_dirfile_get_next(d->dirh, d->uuid, &d->idx, d->d.oid,
@@ -1033,7 +1086,7 @@ static TEE_Result ree_fs_readdir_rpc(struct tee_fs_dir *d,
 	if (res == TEE_SUCCESS)
 		*ent = &d->d;
 
-	mutex_unlock(&ree_fs_mutex);
+	rwlock_write_unlock(&ree_fs_rwlock);
 
 	return res;
 }
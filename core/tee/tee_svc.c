@@ -672,11 +672,69 @@ static TEE_Result alloc_temp_sec_mem(size_t size, struct mobj **mobj,
 	return TEE_SUCCESS;
 }
 
+/*
+ * Converts a memref in memory mapped by the TA into the mobj and offset
+ * of the mapping. The called TA only gets write access if the calling TA
+ * can write to the memory and the memref isn't an input memref. The
+ * latter only applies to memory shared from TA private RAM since a called
+ * TA has always been allowed to write into other input memrefs.
+ */
+static TEE_Result memref_to_mobj(struct user_ta_ctx *utc, uint32_t param_type,
+				 bool private_mem, struct param_mem *mem)
+{
+	uint32_t flags = TEE_MEMORY_ACCESS_WRITE | TEE_MEMORY_ACCESS_ANY_OWNER;
+	void *va = (void *)mem->offs;
+	TEE_Result res = TEE_SUCCESS;
+
+	res = vm_buf_to_mboj_offs(&utc->uctx, va, mem->size, &mem->mobj,
+				  &mem->offs);
+	if (res)
+		return res;
+
+	mem->readonly = (private_mem &&
+			 param_type == TEE_PARAM_TYPE_MEMREF_INPUT) ||
+			vm_check_access_rights(&utc->uctx, flags, (uaddr_t)va,
+					       mem->size);
+	return TEE_SUCCESS;
+}
+
+/*
+ * With CFG_TA_ZERO_COPY_MEMREF a memref in TA private RAM is shared with
+ * the called TA instead of being copied, provided it covers complete
+ * pages of a single unpaged region. Only the pages of the memref are
+ * exposed that way and the calling TA is blocked until the called TA
+ * returns.
+ *
+ * A TA_FLAG_CONCURRENT TA isn't blocked as a whole, other threads of the
+ * calling TA could change the buffer while the called TA reads it, so
+ * the called TA could see different data on each access. The memref is
+ * copied for such a TA.
+ */
+static bool can_share_private_memref(struct user_ta_ctx *utc,
+				     struct param_mem *mem)
+{
+	struct mobj *mobj = NULL;
+	size_t offs = 0;
+
+	if (!IS_ENABLED(CFG_TA_ZERO_COPY_MEMREF))
+		return false;
+	if (utc->ta_ctx.flags & TA_FLAG_CONCURRENT)
+		return false;
+	if (!mem->size || (mem->size | mem->offs) & CORE_MMU_USER_PARAM_MASK)
+		return false;
+	if (vm_buf_to_mboj_offs(&utc->uctx, (void *)mem->offs, mem->size,
+				&mobj, &offs))
+		return false;
+
+	return !mobj_is_paged(mobj);
+}
+
 /*
  * TA invokes some TA with parameter.
  * If some parameters are memory references:
  * - either the memref is inside TA private RAM: TA is not allowed to expose
- *   its private RAM: use a temporary memory buffer and copy the data.
+ *   its private RAM: use a temporary memory buffer and copy the data,
+ *   unless the memref can be shared as is, see can_share_private_memref().
  * - or the memref is not in the TA private RAM:
  *   - if the memref was mapped to the TA, TA is allowed to expose it.
  *   - if so, converts memref virtual address into a physical address.
@@ -692,6 +750,7 @@ static TEE_Result tee_svc_copy_param(struct ts_session *sess,
 	struct user_ta_ctx *utc = to_user_ta_ctx(sess->ctx);
 	bool ta_private_memref[TEE_NUM_PARAMS] = { false, };
 	TEE_Result res = TEE_SUCCESS;
+	bool private_mem = false;
 	size_t dst_offs = 0;
 	size_t req_mem = 0;
 	uint8_t *dst = 0;
@@ -742,7 +801,10 @@ static TEE_Result tee_svc_copy_param(struct ts_session *sess,
 				break;
 			}
 			/* uTA cannot expose its private memory */
-			if (vm_buf_is_inside_um_private(&utc->uctx, va, s)) {
+			private_mem = vm_buf_is_inside_um_private(&utc->uctx,
+								  va, s);
+			if (private_mem &&
+			    !can_share_private_memref(utc, &param->u[n].mem)) {
 				s = ROUNDUP(s, sizeof(uint32_t));
 				if (ADD_OVERFLOW(req_mem, s, &req_mem))
 					return TEE_ERROR_BAD_PARAMETERS;
@@ -750,9 +812,9 @@ static TEE_Result tee_svc_copy_param(struct ts_session *sess,
 				break;
 			}
 
-			res = vm_buf_to_mboj_offs(&utc->uctx, va, s,
-						  &param->u[n].mem.mobj,
-						  &param->u[n].mem.offs);
+			res = memref_to_mobj(utc,
+					     TEE_PARAM_TYPE_GET(param->types, n),
+					     private_mem, &param->u[n].mem);
 			if (res != TEE_SUCCESS)
 				return res;
 			break;
@@ -897,6 +959,61 @@ static TEE_Result tee_svc_update_out_param(
 	return TEE_SUCCESS;
 }
 
+/*
+ * A TA_FLAG_CONCURRENT TA holds its address space lock shared during a
+ * system call, see scall_handle_user_ta(). It's released while another
+ * user TA is called so the other threads of the TA can enter and leave
+ * it meanwhile, or the called TA can call back into it. The memory of
+ * memref parameters is kept referenced until the call returns since it
+ * may be unmapped in the meantime.
+ *
+ * A pseudo TA executes in the address space of the calling TA and may
+ * change it, the system PTA for instance, so the lock is held
+ * exclusively while a pseudo TA is invoked.
+ */
+static void call_begin(struct user_ta_ctx *utc, struct tee_ta_param *param,
+		       struct mobj *mobjs[TEE_NUM_PARAMS], bool pseudo_ta)
+{
+	size_t n = 0;
+
+	if (!(utc->ta_ctx.flags & TA_FLAG_CONCURRENT))
+		return;
+
+	user_ta_vm_unlock_shared(utc);
+	if (pseudo_ta) {
+		user_ta_vm_lock(utc);
+		return;
+	}
+
+	for (n = 0; n < TEE_NUM_PARAMS; n++) {
+		switch (TEE_PARAM_TYPE_GET(param->types, n)) {
+		case TEE_PARAM_TYPE_MEMREF_INPUT:
+		case TEE_PARAM_TYPE_MEMREF_OUTPUT:
+		case TEE_PARAM_TYPE_MEMREF_INOUT:
+			mobjs[n] = mobj_get(param->u[n].mem.mobj);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void call_end(struct user_ta_ctx *utc,
+		     struct mobj *mobjs[TEE_NUM_PARAMS], bool pseudo_ta)
+{
+	size_t n = 0;
+
+	if (!(utc->ta_ctx.flags & TA_FLAG_CONCURRENT))
+		return;
+
+	if (pseudo_ta)
+		user_ta_vm_unlock(utc);
+	user_ta_vm_lock_shared(utc);
+
+	for (n = 0; n < TEE_NUM_PARAMS; n++)
+		mobj_put(mobjs[n]);
+}
+
 /* Called when a TA calls an OpenSession on another TA */
 TEE_Result syscall_open_ta_session(const TEE_UUID *dest,
 			unsigned long cancel_req_to,
@@ -914,6 +1031,7 @@ TEE_Result syscall_open_ta_session(const TEE_UUID *dest,
 	TEE_Identity *clnt_id = malloc(sizeof(TEE_Identity));
 	void *tmp_buf_va[TEE_NUM_PARAMS] = { NULL };
 	size_t tmp_buf_size[TEE_NUM_PARAMS] = { 0 };
+	struct mobj *mobjs[TEE_NUM_PARAMS] = { NULL };
 
 	if (uuid == NULL || param == NULL || clnt_id == NULL) {
 		res = TEE_ERROR_OUT_OF_MEMORY;
@@ -934,9 +1052,12 @@ TEE_Result syscall_open_ta_session(const TEE_UUID *dest,
 	if (res != TEE_SUCCESS)
 		goto function_exit;
 
+	/* Parameters are always copied when opening a session */
+	call_begin(utc, param, mobjs, false);
 	res = tee_ta_open_session(&ret_o, &s, &utc->open_sessions, uuid,
 				  clnt_id, cancel_req_to, param);
 	vm_set_ctx(&utc->ta_ctx.ts_ctx);
+	call_end(utc, mobjs, false);
 	if (res != TEE_SUCCESS)
 		goto function_exit;
 
@@ -961,14 +1082,20 @@ TEE_Result syscall_close_ta_session(unsigned long ta_sess)
 	struct ts_session *sess = ts_get_current_session();
 	struct user_ta_ctx *utc = to_user_ta_ctx(sess->ctx);
 	TEE_Identity clnt_id = { };
-	struct tee_ta_session *s = NULL;
-
-	s = tee_ta_find_session(ta_sess, &utc->open_sessions);
+	TEE_Result res = TEE_SUCCESS;
 
 	clnt_id.login = TEE_LOGIN_TRUSTED_APP;
 	memcpy(&clnt_id.uuid, &sess->ctx->uuid, sizeof(TEE_UUID));
 
-	return tee_ta_close_session(s, &utc->open_sessions, &clnt_id);
+	/*
+	 * Looked up by ID since another thread of a concurrent TA may close
+	 * the session too. See call_begin() about the lock.
+	 */
+	user_ta_vm_unlock_shared(utc);
+	res = tee_ta_close_session_id(ta_sess, &utc->open_sessions, &clnt_id);
+	user_ta_vm_lock_shared(utc);
+
+	return res;
 }
 
 TEE_Result syscall_invoke_ta_command(unsigned long ta_sess,
@@ -986,6 +1113,8 @@ TEE_Result syscall_invoke_ta_command(unsigned long ta_sess,
 	struct mobj *mobj_param = NULL;
 	void *tmp_buf_va[TEE_NUM_PARAMS] = { NULL };
 	size_t tmp_buf_size[TEE_NUM_PARAMS] = { };
+	struct mobj *mobjs[TEE_NUM_PARAMS] = { NULL };
+	bool pseudo_ta = false;
 
 	called_sess = tee_ta_get_session((uint32_t)ta_sess, true,
 				&utc->open_sessions);
@@ -1000,8 +1129,11 @@ TEE_Result syscall_invoke_ta_command(unsigned long ta_sess,
 	if (res != TEE_SUCCESS)
 		goto function_exit;
 
+	pseudo_ta = is_pseudo_ta_ctx(called_sess->ts_sess.ctx);
+	call_begin(utc, &param, mobjs, pseudo_ta);
 	res = tee_ta_invoke_command(&ret_o, called_sess, &clnt_id,
 				    cancel_req_to, cmd_id, &param);
+	call_end(utc, mobjs, pseudo_ta);
 	if (res == TEE_ERROR_TARGET_DEAD)
 		goto function_exit;
 
@@ -1105,6 +1237,22 @@ TEE_Result syscall_wait(unsigned long timeout)
 	return res;
 }
 
+#ifdef CFG_CONCURRENT_USER_TA
+TEE_Result syscall_lock_wait(uint32_t *lock, unsigned long val)
+{
+	struct ts_session *s = ts_get_current_session();
+
+	return user_ta_lock_wait(to_user_ta_ctx(s->ctx), (vaddr_t)lock, val);
+}
+
+TEE_Result syscall_lock_wake(uint32_t *lock, unsigned long count)
+{
+	struct ts_session *s = ts_get_current_session();
+
+	return user_ta_lock_wake(to_user_ta_ctx(s->ctx), (vaddr_t)lock, count);
+}
+#endif
+
 TEE_Result syscall_get_time(unsigned long cat, TEE_Time *mytime)
 {
 	struct ts_session *s = ts_get_current_session();
@@ -1136,6 +1284,21 @@ TEE_Result syscall_get_time(unsigned long cat, TEE_Time *mytime)
 	return res;
 }
 
+#ifdef CFG_TA_TIME_PAGE
+TEE_Result syscall_get_time_page(uint64_t *va)
+{
+	struct ts_session *s = ts_get_current_session();
+	struct user_ta_ctx *utc = to_user_ta_ctx(s->ctx);
+	uint64_t v = utc->uctx.time_page_va;
+
+	/* Not mapped if system time can't be computed in user mode */
+	if (!v)
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	return copy_to_user_private(va, &v, sizeof(v));
+}
+#endif
+
 TEE_Result syscall_set_ta_time(const TEE_Time *mytime)
 {
 	struct ts_session *s = ts_get_current_session();
@@ -23,6 +23,7 @@
  * @flags:	  [out] Flags field of TA header
  * @entry_func:	  [out] TA entry function
  * @stack_ptr:	  [out] TA stack pointer
+ * @stack_size:	  [out] Size of the TA stack
  * @dump_entry:	  [out] Dump TA mappings and stack trace
  * @ftrace_entry: [out] Dump TA mappings and ftrace buffer
  * @fbuf:         [out] ftrace buffer pointer
@@ -35,6 +36,7 @@ struct ldelf_arg {
 	uint64_t entry_func;
 	uint64_t load_addr;
 	uint64_t stack_ptr;
+	uint64_t stack_size;
 	uint64_t dump_entry;
 	uint64_t ftrace_entry;
 	uint64_t dl_entry;
@@ -149,7 +149,7 @@ void ldelf(struct ldelf_arg *arg)
 
 	/* Load the main binary and get a list of dependencies, if any. */
 	ta_elf_load_main(&arg->uuid, &arg->is_32bit, &arg->stack_ptr,
-			 &arg->flags);
+			 &arg->stack_size, &arg->flags);
 
 	/*
 	 * Load binaries, ta_elf_load() may add external libraries to the
@@ -1248,7 +1248,7 @@ static void load_main(struct ta_elf *elf)
 }
 
 void ta_elf_load_main(const TEE_UUID *uuid, uint32_t *is_32bit, uint64_t *sp,
-		      uint32_t *ta_flags)
+		      uint64_t *stack_size, uint32_t *ta_flags)
 {
 	struct ta_elf *elf = queue_elf(uuid);
 	vaddr_t va = 0;
@@ -1270,6 +1270,7 @@ void ta_elf_load_main(const TEE_UUID *uuid, uint32_t *is_32bit, uint64_t *sp,
 
 	*ta_flags = elf->head->flags;
 	*sp = va + elf->head->stack_size;
+	*stack_size = elf->head->stack_size;
 	ta_stack = va;
 	ta_stack_size = elf->head->stack_size;
 }
@@ -121,7 +121,7 @@ extern struct ta_elf_queue main_elf_queue;
 struct ta_elf *ta_elf_find_elf(const TEE_UUID *uuid);
 
 void ta_elf_load_main(const TEE_UUID *uuid, uint32_t *is_32bit, uint64_t *sp,
-		      uint32_t *ta_flags);
+		      uint64_t *stack_size, uint32_t *ta_flags);
 void ta_elf_finalize_load_main(uint64_t *entry, uint64_t *load_addr);
 void ta_elf_load_dependency(struct ta_elf *elf, bool is_32bit);
 void ta_elf_relocate(struct ta_elf *elf);
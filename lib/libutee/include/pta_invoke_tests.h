@@ -57,7 +57,7 @@
 #define PTA_INVOKE_TESTS_CMD_FS_HTREE		6
 
 /*
- * Tests mutex
+ * Tests mutex and rwlock
  *
  * [in]  value[0].a	Test function PTA_MUTEX_TEST_*
  * [in]  value[0].b	delay number
@@ -66,6 +66,8 @@
  */
 #define PTA_MUTEX_TEST_WRITER			0
 #define PTA_MUTEX_TEST_READER			1
+#define PTA_MUTEX_TEST_RWLOCK_WRITER		2
+#define PTA_MUTEX_TEST_RWLOCK_READER		3
 #define PTA_INVOKE_TESTS_CMD_MUTEX		7
 
 /*
@@ -108,5 +110,17 @@
  */
 #define PTA_INVOKE_TESTS_CMD_DT_DRIVER_TESTS	11
 
+/*
+ * Spinlock contention benchmark, to be invoked concurrently from several
+ * cores with the same parameters. Each invocation takes and releases a
+ * shared spinlock in a loop until the duration has elapsed.
+ *
+ * [in]  value[0].a	duration in microseconds
+ * [in]  value[0].b	delay number, iterations spent holding the lock
+ * [out] value[1].a	number of times the lock was acquired
+ * [out] value[1].b	highest number of invocations running concurrently
+ */
+#define PTA_INVOKE_TESTS_CMD_SPINLOCK_BENCH	12
+
 #endif /*__PTA_INVOKE_TESTS_H*/
 
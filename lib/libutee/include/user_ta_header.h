@@ -19,8 +19,10 @@
 #define TA_FLAG_REMAP_SUPPORT		0	 /* Deprecated, was BIT32(6) */
 #define TA_FLAG_CACHE_MAINTENANCE	BIT32(7) /* use cache flush syscall */
 	/*
-	 * TA instance can execute multiple sessions concurrently
-	 * (pseudo-TAs only).
+	 * TA instance can execute multiple sessions concurrently. A user TA
+	 * must also be single-instance and multi-session, and the TEE core
+	 * must be built with CFG_CONCURRENT_USER_TA=y, otherwise the flag is
+	 * ignored for user TAs.
 	 */
 #define TA_FLAG_CONCURRENT		BIT32(8)
 	/*
@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2026, Analog Devices, Inc.
+ */
+#ifndef UTEE_LOCK_H
+#define UTEE_LOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <utee_syscalls.h>
+
+/*
+ * Lock shared by the threads executing in a TA with TA_FLAG_CONCURRENT
+ * set. The lock word is UTEE_LOCK_CONTENDED while other threads may be
+ * sleeping on it. A thread spins for a while before it marks the lock
+ * contended and sleeps with _utee_lock_wait(), the owner wakes a sleeping
+ * thread when it releases a contended lock.
+ */
+#define UTEE_LOCK_UNLOCKED	0
+#define UTEE_LOCK_LOCKED	1
+#define UTEE_LOCK_CONTENDED	2
+
+#define UTEE_LOCK_SPIN_COUNT	100
+
+static inline bool utee_trylock(uint32_t *lock)
+{
+	uint32_t v = UTEE_LOCK_UNLOCKED;
+
+	return __atomic_compare_exchange_n(lock, &v, UTEE_LOCK_LOCKED, false,
+					   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static inline void utee_lock(uint32_t *lock)
+{
+	unsigned int n = 0;
+
+	for (n = 0; n < UTEE_LOCK_SPIN_COUNT; n++) {
+		if (utee_trylock(lock))
+			return;
+		if (__atomic_load_n(lock, __ATOMIC_RELAXED) ==
+		    UTEE_LOCK_CONTENDED)
+			break;
+	}
+
+	while (__atomic_exchange_n(lock, UTEE_LOCK_CONTENDED,
+				   __ATOMIC_ACQUIRE) != UTEE_LOCK_UNLOCKED)
+		_utee_lock_wait(lock, UTEE_LOCK_CONTENDED);
+}
+
+static inline void utee_unlock(uint32_t *lock)
+{
+	if (__atomic_exchange_n(lock, UTEE_LOCK_UNLOCKED, __ATOMIC_RELEASE) ==
+	    UTEE_LOCK_CONTENDED)
+		_utee_lock_wake(lock, 1);
+}
+
+#endif /*UTEE_LOCK_H*/
@@ -223,6 +223,18 @@ TEE_Result _utee_storage_obj_seek(unsigned long obj, int32_t offset,
 /* op is of type enum _utee_cache_operation */
 TEE_Result _utee_cache_operation(void *va, size_t l, unsigned long op);
 
+/* Returns the address of the read-only struct utee_time_page in @va */
+TEE_Result _utee_get_time_page(uint64_t *va);
+
+/*
+ * Sleeps until woken by _utee_lock_wake() on @lock, returns at once if
+ * *@lock != @val. Only for TAs with TA_FLAG_CONCURRENT set.
+ */
+TEE_Result _utee_lock_wait(uint32_t *lock, unsigned long val);
+
+/* Wakes at most @count threads sleeping in _utee_lock_wait() on @lock */
+TEE_Result _utee_lock_wake(uint32_t *lock, unsigned long count);
+
 TEE_Result _utee_gprof_send(void *buf, size_t size, uint32_t *id);
 
 #endif /* UTEE_SYSCALLS_H */
@@ -57,6 +57,27 @@ struct utee_attribute {
 	uint32_t attribute_id;
 };
 
+/*
+ * struct utee_time_page - system time page shared read-only with user TAs
+ * @seq:	sequence counter, odd while the page is being updated
+ * @cnt_freq:	frequency of the counter in Hz
+ * @cnt_offset:	subtracted from the counter before it's scaled to time
+ *
+ * System time is computed as (counter - @cnt_offset) / @cnt_freq. The
+ * fields are only consistent if @seq is even and unchanged after they
+ * have been read.
+ *
+ * The page is currently only written at boot, before any TA can map it,
+ * so @seq stays 0 and @cnt_offset is 0. They are reserved for updating
+ * the page at runtime, TAs must still follow the protocol above.
+ */
+struct utee_time_page {
+	uint32_t seq;
+	uint32_t pad;
+	uint64_t cnt_freq;
+	uint64_t cnt_offset;
+};
+
 struct utee_object_info {
 	uint32_t obj_type;
 	uint32_t obj_size;
@@ -8,6 +8,7 @@ srcs-y += trace_ext.c
 ifneq ($(sm),ldelf)
 srcs-y += base64.c
 srcs-y += tee_api.c
+srcs-$(CFG_TA_USER_DRBG) += tee_api_drbg.c
 srcs-y += tee_api_arith_mpi.c
 srcs-y += tee_api_objects.c
 srcs-y += tee_api_operations.c
@@ -5,12 +5,14 @@
 /*
  * Support for Thread-Local Storage (TLS) ABIs for ARMv7/Aarch32 and Aarch64.
  *
- * TAs are currently single-threaded, so the only benefit of implementing these
- * ABIs is to support toolchains that need them even when the target program is
- * single-threaded. Such as, the g++ compiler from the GCC toolchain targeting a
- * "Posix thread" Linux runtime, which OP-TEE has been using for quite some time
- * (arm-linux-gnueabihf-* and aarch64-linux-gnu-*). This allows building C++ TAs
- * without having to build a specific toolchain with --disable-threads.
+ * TAs are single-threaded unless TA_FLAG_CONCURRENT is set, in which case
+ * each entry into the TA gets a TCB of its own. Otherwise the only benefit of
+ * implementing these ABIs is to support toolchains that need them even when
+ * the target program is single-threaded. Such as, the g++ compiler from the
+ * GCC toolchain targeting a "Posix thread" Linux runtime, which OP-TEE has
+ * been using for quite some time (arm-linux-gnueabihf-* and
+ * aarch64-linux-gnu-*). This allows building C++ TAs without having to build
+ * a specific toolchain with --disable-threads.
  *
  * This implementation is based on [1].
  *
@@ -32,12 +34,13 @@
  *     https://www.akkadia.org/drepper/tls.pdf
  */
 
-#include <arm64_user_sysreg.h>
+#include <arm_user_sysreg.h>
 #include <assert.h>
 #include <link.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/queue.h>
+#include "tee_api_private.h"
 #include "user_ta_header.h"
 
 /* DTV - Dynamic Thread Vector
@@ -58,9 +61,12 @@ union dtv {
 
 /* Thread Control Block */
 struct tcb_head {
-	/* Two words are reserved as per the "TLS variant 1" ABI */
+	/*
+	 * Two words are reserved as per the "TLS variant 1" ABI, the
+	 * second is struct utee_tls::entry.
+	 */
 	union dtv *dtv;
-	unsigned long reserved;
+	void *entry;
 	/*
 	 * The rest of the structure contains the TLS blocks for each ELF module
 	 * having a PT_TLS segment. Each block is a copy of the .tdata section
@@ -70,13 +76,41 @@ struct tcb_head {
 };
 
 /*
- * Since TAs are single threaded, only one TCB is needed. This would need to
- * change if multi-threading is introduced.
+ * TCB of the TA unless TA_FLAG_CONCURRENT is set, then each entry into the
+ * TA has its own struct utee_tls.
  */
-static struct tcb_head *_tcb;
-static size_t _tls_size;
+static struct utee_tls _tls;
+
+#define TCB_SIZE(tls_size) (sizeof(struct tcb_head) + (tls_size))
+
+static void set_thread_pointer(void *tp __maybe_unused)
+{
+#if defined(ARM64)
+	write_tpidr_el0((vaddr_t)tp);
+#elif defined(ARM32)
+	write_tpidrurw((vaddr_t)tp);
+#endif
+}
+
+static void *get_thread_pointer(void)
+{
+#if defined(ARM64)
+	return (void *)(vaddr_t)read_tpidr_el0();
+#elif defined(ARM32)
+	return (void *)(vaddr_t)read_tpidrurw();
+#else
+	return NULL;
+#endif
+}
+
+static struct utee_tls *get_tls(void)
+{
+	struct utee_tls *tls = __utee_entry_get_tls();
 
-#define TCB_SIZE(tls_size) (sizeof(*_tcb) + (tls_size))
+	if (tls)
+		return tls;
+	return &_tls;
+}
 
 /*
  * Initialize or update the TCB.
@@ -85,8 +119,10 @@ static size_t _tls_size;
  */
 void __utee_tcb_init(void)
 {
+	struct utee_tls *tls = get_tls();
 	struct dl_phdr_info *dlpi = NULL;
 	const Elf_Phdr *phdr = NULL;
+	struct tcb_head *tcb = NULL;
 	size_t total_size = 0;
 	size_t size = 0;
 	size_t i = 0;
@@ -105,22 +141,26 @@ void __utee_tcb_init(void)
 	}
 
 	/* ELF modules currently cannot be unmapped */
-	assert(total_size >= _tls_size);
+	assert(total_size >= tls->size);
 
-	if (total_size == _tls_size)
+	if (total_size == tls->size)
 		return;
 
 	/* (Re-)allocate the TCB */
-	_tcb = realloc(_tcb, TCB_SIZE(total_size));
-	if (!_tcb) {
+	tcb = realloc(tls->tcb, TCB_SIZE(total_size));
+	if (!tcb) {
 		EMSG("TCB allocation failed (%zu bytes)", TCB_SIZE(total_size));
 		abort();
 	}
+	if (!tls->tcb)
+		tcb->dtv = NULL;
+	tcb->entry = tls->entry;
+	tls->tcb = tcb;
 
 	/* (Re-)allocate the DTV. + 1 since dtv[0] holds the size */
 	size = DTV_SIZE((__elf_phdr_info.count + 1) * sizeof(union dtv));
-	_tcb->dtv = realloc(_tcb->dtv, size);
-	if (!_tcb->dtv) {
+	tcb->dtv = realloc(tcb->dtv, size);
+	if (!tcb->dtv) {
 		EMSG("DTV allocation failed (%zu bytes)", size);
 		abort();
 	}
@@ -133,31 +173,67 @@ void __utee_tcb_init(void)
 			phdr = dlpi->dlpi_phdr + j;
 			if (phdr->p_type != PT_TLS)
 				continue;
-			if (size + phdr->p_memsz <= _tls_size) {
+			if (size + phdr->p_memsz <= tls->size) {
 				/* Already copied */
 				break;
 			}
-			_tcb->dtv[i + 1].tls = _tcb->tls + size;
+			tcb->dtv[i + 1].tls = tcb->tls + size;
 			/* Copy .tdata */
-			memcpy(_tcb->tls + size,
+			memcpy(tcb->tls + size,
 			       (void *)(dlpi->dlpi_addr + phdr->p_vaddr),
 			       phdr->p_filesz);
 			/* Initialize .tbss */
-			memset(_tcb->tls + size + phdr->p_filesz, 0,
+			memset(tcb->tls + size + phdr->p_filesz, 0,
 			       phdr->p_memsz - phdr->p_filesz);
 			size += phdr->p_memsz;
 		}
 	}
-	_tcb->dtv[0].size = i;
+	tcb->dtv[0].size = i;
 
-	_tls_size = total_size;
-#ifdef ARM64
+	tls->size = total_size;
 	/*
 	 * Aarch64 ABI requirement: the thread pointer shall point to the
-	 * thread's TCB. ARMv7 and Aarch32 access the TCB via _tls_get_addr().
+	 * thread's TCB. ARMv7 and Aarch32 access the TCB via _tls_get_addr()
+	 * but the thread pointer is still used to find the current entry.
 	 */
-	write_tpidr_el0((vaddr_t)_tcb);
-#endif
+	set_thread_pointer(tcb);
+}
+
+void __utee_tls_enter(struct utee_tls *tls)
+{
+	struct tcb_head *head = (struct tcb_head *)tls->tp_head;
+
+	/* tp_head stands in for the two words at the start of the TCB */
+	static_assert(sizeof(tls->tp_head) == sizeof(struct tcb_head));
+
+	if (tls->tcb) {
+		set_thread_pointer(tls->tcb);
+	} else {
+		head->dtv = NULL;
+		head->entry = tls->entry;
+		set_thread_pointer(head);
+	}
+}
+
+void *__utee_tls_get_entry(void)
+{
+	struct tcb_head *tcb = get_thread_pointer();
+
+	if (!tcb)
+		return NULL;
+	return tcb->entry;
+}
+
+void __utee_tls_free(struct utee_tls *tls)
+{
+	struct tcb_head *tcb = tls->tcb;
+
+	if (tcb) {
+		free(tcb->dtv);
+		free(tcb);
+	}
+	tls->tcb = NULL;
+	tls->size = 0;
 }
 
 struct tls_index {
@@ -169,23 +245,25 @@ void *__tls_get_addr(struct tls_index *ti);
 
 void *__tls_get_addr(struct tls_index *ti)
 {
-	return _tcb->dtv[ti->module].tls + ti->offset;
+	struct tcb_head *tcb = get_tls()->tcb;
+
+	return tcb->dtv[ti->module].tls + ti->offset;
 }
 
 int dl_iterate_phdr(int (*callback)(struct dl_phdr_info *, size_t, void *),
 		    void *data)
 {
+	struct tcb_head *tcb = get_tls()->tcb;
 	struct dl_phdr_info *dlpi = NULL;
 	size_t id = 0;
 	size_t i = 0;
 	int st = 0;
 
 	/*
-	 * dlpi_tls_data is thread-specific so if we were to support
-	 * multi-threading, we would need one copy of struct dl_phdr_info per
-	 * thread. Could be a pre-allocated area, or could be allocated on the
-	 * heap. Doing the latter here so that it would at least work if/when we
-	 * add thread support. Further optimization can always come later.
+	 * dlpi_tls_data is thread-specific so with TA_FLAG_CONCURRENT we
+	 * need one copy of struct dl_phdr_info per entry into the TA. It's
+	 * allocated on the heap, further optimization can always come
+	 * later.
 	 */
 	dlpi = calloc(1, sizeof(*dlpi));
 	if (!dlpi) {
@@ -198,7 +276,7 @@ int dl_iterate_phdr(int (*callback)(struct dl_phdr_info *, size_t, void *),
 		dlpi->dlpi_tls_data = NULL;
 		id = dlpi->dlpi_tls_modid;
 		if (id)
-			dlpi->dlpi_tls_data = _tcb->dtv[id].tls;
+			dlpi->dlpi_tls_data = tcb->dtv[id].tls;
 		st = callback(dlpi, sizeof(*dlpi), data);
 	}
 
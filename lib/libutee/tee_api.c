@@ -2,6 +2,11 @@
 /*
  * Copyright (c) 2014, STMicroelectronics International N.V.
  */
+#if defined(ARM32) || defined(ARM64)
+#include <arm_user_sysreg.h>
+#elif defined(RV32) || defined(RV64)
+#include <riscv_user_sysreg.h>
+#endif
 #include <stdlib.h>
 #include <string.h>
 #include <string_ext.h>
@@ -9,7 +14,9 @@
 #include <tee_internal_api_extensions.h>
 #include <types_ext.h>
 #include <user_ta_header.h>
+#include <utee_defines.h>
 #include <utee_syscalls.h>
+#include <utee_types.h>
 #include "tee_api_private.h"
 
 /*
@@ -253,12 +260,16 @@ static bool bufs_intersect(void *buf1, size_t sz1, void *buf2, size_t sz2)
 static TEE_Result check_mem_access_rights_params(uint32_t flags, void *buf,
 						 size_t len)
 {
+	const TEE_Param *params = NULL;
+	uint32_t param_types = 0;
 	size_t n = 0;
 
+	__utee_entry_get_params(&param_types, &params);
+
 	for (n = 0; n < TEE_NUM_PARAMS; n++) {
 		uint32_t f = TEE_MEMORY_ACCESS_ANY_OWNER;
 
-		switch (TEE_PARAM_TYPE_GET(ta_param_types, n)) {
+		switch (TEE_PARAM_TYPE_GET(param_types, n)) {
 		case TEE_PARAM_TYPE_MEMREF_OUTPUT:
 		case TEE_PARAM_TYPE_MEMREF_INOUT:
 			f |= TEE_MEMORY_ACCESS_WRITE;
@@ -266,8 +277,8 @@ static TEE_Result check_mem_access_rights_params(uint32_t flags, void *buf,
 		case TEE_PARAM_TYPE_MEMREF_INPUT:
 			f |= TEE_MEMORY_ACCESS_READ;
 			if (bufs_intersect(buf, len,
-					   ta_params[n].memref.buffer,
-					   ta_params[n].memref.size)) {
+					   params[n].memref.buffer,
+					   params[n].memref.size)) {
 				if ((flags & f) != flags)
 					return TEE_ERROR_ACCESS_DENIED;
 			}
@@ -640,10 +651,68 @@ void __GP11_TEE_MemFill(void *buff, uint32_t x, uint32_t size)
 
 /* Date & Time API */
 
+#ifdef CFG_TA_TIME_PAGE
+static const struct utee_time_page *time_page;
+static bool time_page_probed;
+
+static const struct utee_time_page *get_time_page(void)
+{
+	uint64_t va = 0;
+
+	if (!time_page_probed) {
+		if (!_utee_get_time_page(&va))
+			time_page = (const void *)(vaddr_t)va;
+		time_page_probed = true;
+	}
+
+	return time_page;
+}
+
+/*
+ * Computes system time in user mode from the counter if the kernel has
+ * mapped a time page, this saves a syscall per call.
+ */
+static bool get_system_time_from_page(TEE_Time *time)
+{
+	const struct utee_time_page *tp = get_time_page();
+	uint64_t freq = 0;
+	uint64_t cnt = 0;
+	uint32_t seq = 0;
+
+	if (!tp)
+		return false;
+
+	do {
+		seq = __atomic_load_n(&tp->seq, __ATOMIC_ACQUIRE);
+		freq = tp->cnt_freq;
+		cnt = barrier_read_counter_timer() - tp->cnt_offset;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while ((seq & 1) ||
+		 seq != __atomic_load_n(&tp->seq, __ATOMIC_RELAXED));
+
+	if (freq < TEE_TIME_MILLIS_BASE)
+		return false;
+
+	time->seconds = cnt / freq;
+	time->millis = (cnt % freq) / (freq / TEE_TIME_MILLIS_BASE);
+
+	return true;
+}
+#else
+static bool get_system_time_from_page(TEE_Time *time __unused)
+{
+	return false;
+}
+#endif
+
 void TEE_GetSystemTime(TEE_Time *time)
 {
-	TEE_Result res = _utee_get_time(UTEE_TIME_CAT_SYSTEM, time);
+	TEE_Result res = TEE_SUCCESS;
+
+	if (get_system_time_from_page(time))
+		return;
 
+	res = _utee_get_time(UTEE_TIME_CAT_SYSTEM, time);
 	if (res != TEE_SUCCESS)
 		TEE_Panic(res);
 }
@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: BSD-2-Clause
+/*
+ * Copyright (c) 2026, Analog Devices, Inc.
+ */
+
+/*
+ * User mode DRBG serving small TEE_GenerateRandom() and rand() requests
+ * without a syscall.
+ *
+ * The generator is ChaCha20 used with fast key erasure: each refill
+ * produces DRBG_BLOCKS blocks of keystream, the first DRBG_SEED_SIZE bytes
+ * immediately replace the key and nonce and the rest is handed out, each
+ * byte being wiped as it's consumed. A compromise of the TA memory can
+ * thus not reveal output which has already been returned.
+ *
+ * Seeding and reseeding:
+ * - The DRBG is seeded from the kernel RNG at the first request.
+ * - It's reseeded from the kernel RNG once DRBG_RESEED_BYTES have been
+ *   output since the last (re)seed.
+ * - Requests larger than DRBG_MAX_REQUEST bytes, typically key material,
+ *   are served by the kernel RNG directly.
+ *
+ * Fork semantics: a TA can't fork, each TA instance has its own address
+ * space and hence its own DRBG state. Sessions of a single instance TA
+ * share the state of that instance. The state isn't saved anywhere and is
+ * gone when the instance is destroyed, a new instance seeds again.
+ */
+
+#include <string.h>
+#include <string_ext.h>
+#include <tee_api.h>
+#include <utee_lock.h>
+#include <utee_syscalls.h>
+#include <util.h>
+#include "tee_api_private.h"
+
+#define CHACHA_KEY_SIZE		32
+#define CHACHA_NONCE_SIZE	12
+#define CHACHA_BLOCK_SIZE	64
+
+#define DRBG_SEED_SIZE		(CHACHA_KEY_SIZE + CHACHA_NONCE_SIZE)
+#define DRBG_BLOCKS		8
+#define DRBG_BUF_SIZE		(DRBG_BLOCKS * CHACHA_BLOCK_SIZE)
+#define DRBG_MAX_REQUEST	256
+#define DRBG_RESEED_BYTES	(64 * 1024)
+
+/*
+ * struct drbg_state - state of the user mode DRBG
+ * @kn:		ChaCha20 key followed by the nonce
+ * @buf:	Keystream of the last refill
+ * @avail:	Number of unused bytes at the end of @buf
+ * @count:	Number of bytes output since the last (re)seed
+ * @seeded:	True if @kn has been seeded
+ */
+struct drbg_state {
+	uint32_t kn[DRBG_SEED_SIZE / sizeof(uint32_t)];
+	uint8_t buf[DRBG_BUF_SIZE] __aligned(sizeof(uint32_t));
+	size_t avail;
+	size_t count;
+	bool seeded;
+};
+
+static struct drbg_state drbg;
+/* Protects drbg, concurrent entries into a TA may use it */
+static uint32_t drbg_lock;
+
+static uint32_t rotl32(uint32_t v, unsigned int n)
+{
+	return (v << n) | (v >> (32 - n));
+}
+
+#define QUARTER_ROUND(a, b, c, d) do { \
+		a += b; d = rotl32(d ^ a, 16); \
+		c += d; b = rotl32(b ^ c, 12); \
+		a += b; d = rotl32(d ^ a, 8); \
+		c += d; b = rotl32(b ^ c, 7); \
+	} while (0)
+
+/*
+ * Produces one 64 byte ChaCha20 keystream block into @out, @kn holds the
+ * key followed by the nonce
+ */
+static void chacha20_block(uint32_t out[16], const uint32_t kn[11],
+			   uint32_t counter)
+{
+	static const uint32_t sigma[4] = {
+		0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+	};
+	uint32_t in[16] = { };
+	size_t n = 0;
+
+	memcpy(in, sigma, sizeof(sigma));
+	memcpy(in + 4, kn, CHACHA_KEY_SIZE);
+	in[12] = counter;
+	memcpy(in + 13, (const uint8_t *)kn + CHACHA_KEY_SIZE,
+	       CHACHA_NONCE_SIZE);
+	memcpy(out, in, sizeof(in));
+
+	for (n = 0; n < 10; n++) {
+		QUARTER_ROUND(out[0], out[4], out[8], out[12]);
+		QUARTER_ROUND(out[1], out[5], out[9], out[13]);
+		QUARTER_ROUND(out[2], out[6], out[10], out[14]);
+		QUARTER_ROUND(out[3], out[7], out[11], out[15]);
+		QUARTER_ROUND(out[0], out[5], out[10], out[15]);
+		QUARTER_ROUND(out[1], out[6], out[11], out[12]);
+		QUARTER_ROUND(out[2], out[7], out[8], out[13]);
+		QUARTER_ROUND(out[3], out[4], out[9], out[14]);
+	}
+
+	for (n = 0; n < 16; n++)
+		out[n] += in[n];
+
+	memzero_explicit(in, sizeof(in));
+}
+
+/*
+ * Known answer test of chacha20_block() with the test vector in RFC 8439
+ * section 2.3.2, run before the DRBG is seeded the first time.
+ */
+static void chacha20_self_test(void)
+{
+	static const uint8_t kn[DRBG_SEED_SIZE] __aligned(sizeof(uint32_t)) = {
+		/* Key */
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+		0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+		0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+		0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+		/* Nonce */
+		0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x4a,
+		0x00, 0x00, 0x00, 0x00,
+	};
+	static const uint32_t expect[16] = {
+		0xe4e7f110, 0x15593bd1, 0x1fdd0f50, 0xc47120a3,
+		0xc7f4d1c7, 0x0368c033, 0x9aaa2204, 0x4e6cd4c3,
+		0x466482d2, 0x09aa9f07, 0x05d7c214, 0xa2028bd9,
+		0xd19c12b5, 0xb94e16de, 0xe883d0cb, 0x4e3c50a2,
+	};
+	uint32_t out[16] = { };
+
+	chacha20_block(out, (const void *)kn, 1);
+	if (memcmp(out, expect, sizeof(out)))
+		TEE_Panic(0);
+}
+
+static TEE_Result drbg_seed(void)
+{
+	uint32_t seed[DRBG_SEED_SIZE / sizeof(uint32_t)] = { };
+	TEE_Result res = TEE_SUCCESS;
+	size_t n = 0;
+
+	if (!drbg.seeded)
+		chacha20_self_test();
+
+	res = _utee_cryp_random_number_generate(seed, sizeof(seed));
+	if (res)
+		return res;
+
+	/*
+	 * On a reseed the fresh seed is mixed into the current key rather
+	 * than replacing it.
+	 */
+	for (n = 0; n < ARRAY_SIZE(seed); n++)
+		drbg.kn[n] ^= seed[n];
+	memzero_explicit(seed, sizeof(seed));
+
+	memzero_explicit(drbg.buf, sizeof(drbg.buf));
+	drbg.avail = 0;
+	drbg.count = 0;
+	drbg.seeded = true;
+
+	return TEE_SUCCESS;
+}
+
+static void drbg_refill(void)
+{
+	size_t n = 0;
+
+	for (n = 0; n < DRBG_BLOCKS; n++)
+		chacha20_block((void *)(drbg.buf + n * CHACHA_BLOCK_SIZE),
+			       drbg.kn, n);
+
+	/* Fast key erasure: the first bytes become the next key and nonce */
+	memcpy(drbg.kn, drbg.buf, DRBG_SEED_SIZE);
+	memzero_explicit(drbg.buf, DRBG_SEED_SIZE);
+	drbg.avail = DRBG_BUF_SIZE - DRBG_SEED_SIZE;
+}
+
+TEE_Result __utee_drbg_generate(void *buf, size_t len)
+{
+	TEE_Result res = TEE_SUCCESS;
+	uint8_t *b = buf;
+	uint8_t *p = NULL;
+	size_t l = 0;
+
+	if (len > DRBG_MAX_REQUEST)
+		return _utee_cryp_random_number_generate(buf, len);
+
+	utee_lock(&drbg_lock);
+
+	if (!drbg.seeded || drbg.count >= DRBG_RESEED_BYTES) {
+		res = drbg_seed();
+		if (res)
+			goto out;
+	}
+
+	while (len) {
+		if (!drbg.avail)
+			drbg_refill();
+
+		l = MIN(len, drbg.avail);
+		p = drbg.buf + DRBG_BUF_SIZE - drbg.avail;
+		memcpy(b, p, l);
+		memzero_explicit(p, l);
+		drbg.avail -= l;
+		drbg.count += l;
+		b += l;
+		len -= l;
+	}
+
+out:
+	utee_unlock(&drbg_lock);
+
+	return res;
+}
@@ -2390,7 +2390,11 @@ void TEE_GenerateRandom(void *randomBuffer, size_t randomBufferLen)
 {
 	TEE_Result res;
 
-	res = _utee_cryp_random_number_generate(randomBuffer, randomBufferLen);
+	if (IS_ENABLED(CFG_TA_USER_DRBG))
+		res = __utee_drbg_generate(randomBuffer, randomBufferLen);
+	else
+		res = _utee_cryp_random_number_generate(randomBuffer,
+							randomBufferLen);
 	if (res != TEE_SUCCESS)
 		TEE_Panic(res);
 }
@@ -18,6 +18,42 @@ void __utee_from_gp11_attr(struct utee_attribute *ua,
 TEE_Result __utee_entry(unsigned long func, unsigned long session_id,
 			struct utee_params *up, unsigned long cmd_id);
 
+/*
+ * struct utee_tls - thread-local storage, with TA_FLAG_CONCURRENT each
+ * entry into the TA has its own
+ * @tcb:	Thread Control Block, the thread pointer points to it
+ * @size:	Size of the TLS blocks in @tcb
+ * @entry:	State of the entry into the TA, see __utee_tls_get_entry()
+ * @tp_head:	Thread pointer target until @tcb is allocated
+ */
+struct utee_tls {
+	void *tcb;
+	size_t size;
+	void *entry;
+	void *tp_head[2];
+};
+
+/*
+ * Returns the struct utee_tls of the current entry into the TA or NULL if
+ * TA_FLAG_CONCURRENT isn't set.
+ */
+struct utee_tls *__utee_entry_get_tls(void);
+/* Points the thread pointer at @tls, @tls->entry must be set */
+void __utee_tls_enter(struct utee_tls *tls);
+/* Returns @entry of the struct utee_tls the thread pointer points at */
+void *__utee_tls_get_entry(void);
+void __utee_tls_free(struct utee_tls *tls);
+
+/* Returns the parameters the current entry into the TA was invoked with */
+void __utee_entry_get_params(uint32_t *param_types,
+			     const TEE_Param **params);
+
+
+/*
+ * Fills @buf with @len random bytes from the user mode DRBG, see
+ * tee_api_drbg.c
+ */
+TEE_Result __utee_drbg_generate(void *buf, size_t len);
 
 #if defined(CFG_TA_GPROF_SUPPORT)
 void __utee_gprof_init(void);
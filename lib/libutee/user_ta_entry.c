@@ -4,6 +4,7 @@
  * Copyright (c) 2022, Linaro Limited.
  */
 #include <compiler.h>
+#include <config.h>
 #include <link.h>
 #include <malloc.h>
 #include <memtag.h>
@@ -16,6 +17,7 @@
 #include <tee_internal_api_extensions.h>
 #include <tee_ta_api.h>
 #include <user_ta_header.h>
+#include <utee_lock.h>
 #include <utee_syscalls.h>
 #include "tee_api_private.h"
 
@@ -28,7 +30,24 @@ struct ta_session {
 static TAILQ_HEAD(ta_sessions, ta_session) ta_sessions =
 		TAILQ_HEAD_INITIALIZER(ta_sessions);
 
-static bool init_done;
+enum init_state { INIT_NONE, INIT_BUSY, INIT_DONE };
+
+/* enum init_state, a 32-bit word since entries may sleep on it */
+static uint32_t init_state;
+
+/*
+ * State of an entry into a TA with TA_FLAG_CONCURRENT set. Each such
+ * entry runs on a stack of its own and keeps this struct in the frame of
+ * __utee_entry(), it's found with the thread pointer.
+ */
+struct utee_entry {
+	uint32_t param_types;
+	TEE_Param params[TEE_NUM_PARAMS];
+	struct utee_tls tls;
+};
+
+/* Protects ta_sessions and init_state */
+static uint32_t sessions_lock;
 
 /* From user_ta_header.c, built within TA */
 extern uint8_t ta_heap[];
@@ -155,6 +174,67 @@ void __utee_call_elf_fini_fn(void)
 	dl_iterate_phdr(_fini_iterate_phdr_cb, NULL);
 }
 
+static bool is_concurrent(void)
+{
+	return IS_ENABLED(CFG_CONCURRENT_USER_TA) &&
+	       (ta_head.flags & TA_FLAG_CONCURRENT);
+}
+
+static void ta_lock(uint32_t *lock)
+{
+	if (is_concurrent())
+		utee_lock(lock);
+}
+
+static void ta_unlock(uint32_t *lock)
+{
+	if (is_concurrent())
+		utee_unlock(lock);
+}
+
+/* Called with sessions_lock held when leaving INIT_BUSY */
+static void set_init_state(enum init_state state)
+{
+	init_state = state;
+	if (is_concurrent())
+		_utee_lock_wake(&init_state, UINT32_MAX);
+}
+
+static struct utee_entry *get_entry(void)
+{
+	struct utee_entry *e = NULL;
+
+	if (!is_concurrent())
+		return NULL;
+
+	e = __utee_tls_get_entry();
+	if (!e)
+		TEE_Panic(0);
+	return e;
+}
+
+struct utee_tls *__utee_entry_get_tls(void)
+{
+	struct utee_entry *e = get_entry();
+
+	if (!e)
+		return NULL;
+	return &e->tls;
+}
+
+void __utee_entry_get_params(uint32_t *param_types, const TEE_Param **params)
+{
+	struct utee_entry *e = get_entry();
+
+	if (e) {
+		*param_types = e->param_types;
+		*params = e->params;
+	} else {
+		*param_types = ta_param_types;
+		*params = ta_params;
+	}
+}
+
 static unsigned int get_memtag_implementation(void)
 {
 	const char *s = "org.trustedfirmware.optee.cpu.feat_memtag_implemented";
@@ -196,12 +276,21 @@ static void uninit_instance(void)
 static void ta_header_save_params(uint32_t param_types,
 				  TEE_Param params[TEE_NUM_PARAMS])
 {
-	ta_param_types = param_types;
+	struct utee_entry *e = get_entry();
+	uint32_t *types = &ta_param_types;
+	TEE_Param *p = ta_params;
+
+	if (e) {
+		types = &e->param_types;
+		p = e->params;
+	}
+
+	*types = param_types;
 
 	if (params)
-		memcpy(ta_params, params, sizeof(ta_params));
+		memcpy(p, params, sizeof(ta_params));
 	else
-		memset(ta_params, 0, sizeof(ta_params));
+		memset(p, 0, sizeof(ta_params));
 }
 
 static struct ta_session *ta_header_get_session(uint32_t session_id)
@@ -215,30 +304,70 @@ static struct ta_session *ta_header_get_session(uint32_t session_id)
 	return NULL;
 }
 
+/*
+ * With TA_FLAG_CONCURRENT each entry needs a TCB of its own, this is only
+ * possible once the instance is initialized and the heap is available.
+ */
+static void init_entry_tls(void)
+{
+	if (is_concurrent())
+		__utee_tcb_init();
+}
+
+static struct ta_session *ta_header_find_session(uint32_t session_id)
+{
+	struct ta_session *itr = NULL;
+
+	ta_lock(&sessions_lock);
+	itr = ta_header_get_session(session_id);
+	ta_unlock(&sessions_lock);
+
+	return itr;
+}
+
 static TEE_Result ta_header_add_session(uint32_t session_id)
 {
-	struct ta_session *itr = ta_header_get_session(session_id);
-	TEE_Result res;
+	struct ta_session *itr = NULL;
+	TEE_Result res = TEE_SUCCESS;
 
+	ta_lock(&sessions_lock);
+
+	itr = ta_header_get_session(session_id);
 	if (itr)
-		return TEE_SUCCESS;
+		goto out;
+
+	/* Another entry is initializing or uninitializing the instance */
+	while (init_state == INIT_BUSY) {
+		ta_unlock(&sessions_lock);
+		_utee_lock_wait(&init_state, INIT_BUSY);
+		ta_lock(&sessions_lock);
+	}
 
-	if (!init_done) {
-		init_done = true;
+	if (init_state == INIT_NONE) {
+		init_state = INIT_BUSY;
+		ta_unlock(&sessions_lock);
 		res = init_instance();
-		if (res)
-			return res;
+		ta_lock(&sessions_lock);
+		if (res) {
+			set_init_state(INIT_NONE);
+			goto out;
+		}
+		set_init_state(INIT_DONE);
 	}
 
 	itr = TEE_Malloc(sizeof(struct ta_session),
 			TEE_USER_MEM_HINT_NO_FILL_ZERO);
-	if (!itr)
-		return TEE_ERROR_OUT_OF_MEMORY;
+	if (!itr) {
+		res = TEE_ERROR_OUT_OF_MEMORY;
+		goto out;
+	}
 	itr->session_id = session_id;
 	itr->session_ctx = 0;
 	TAILQ_INSERT_TAIL(&ta_sessions, itr, link);
+out:
+	ta_unlock(&sessions_lock);
 
-	return TEE_SUCCESS;
+	return res;
 }
 
 static void ta_header_remove_session(uint32_t session_id)
@@ -246,6 +375,7 @@ static void ta_header_remove_session(uint32_t session_id)
 	struct ta_session *itr;
 	bool keep_alive;
 
+	ta_lock(&sessions_lock);
 	TAILQ_FOREACH(itr, &ta_sessions, link) {
 		if (itr->session_id == session_id) {
 			TAILQ_REMOVE(&ta_sessions, itr, link);
@@ -254,12 +384,18 @@ static void ta_header_remove_session(uint32_t session_id)
 			keep_alive =
 				(ta_head.flags & TA_FLAG_SINGLE_INSTANCE) &&
 				(ta_head.flags & TA_FLAG_INSTANCE_KEEP_ALIVE);
-			if (TAILQ_EMPTY(&ta_sessions) && !keep_alive)
+			if (TAILQ_EMPTY(&ta_sessions) && !keep_alive) {
+				init_state = INIT_BUSY;
+				ta_unlock(&sessions_lock);
 				uninit_instance();
+				ta_lock(&sessions_lock);
+				set_init_state(INIT_NONE);
+			}
 
-			return;
+			break;
 		}
 	}
+	ta_unlock(&sessions_lock);
 }
 
 static void to_utee_params(struct utee_params *up, uint32_t param_types,
@@ -335,10 +471,12 @@ static TEE_Result entry_open_session(unsigned long session_id,
 	if (res != TEE_SUCCESS)
 		return res;
 
-	session = ta_header_get_session(session_id);
+	session = ta_header_find_session(session_id);
 	if (!session)
 		return TEE_ERROR_BAD_STATE;
 
+	init_entry_tls();
+
 	from_utee_params(params, &param_types, up);
 	ta_header_save_params(param_types, params);
 
@@ -354,11 +492,12 @@ static TEE_Result entry_open_session(unsigned long session_id,
 
 static TEE_Result entry_close_session(unsigned long session_id)
 {
-	struct ta_session *session = ta_header_get_session(session_id);
+	struct ta_session *session = ta_header_find_session(session_id);
 
 	if (!session)
 		return TEE_ERROR_BAD_STATE;
 
+	init_entry_tls();
 	TA_CloseSessionEntryPoint(session->session_ctx);
 
 	ta_header_remove_session(session_id);
@@ -371,11 +510,12 @@ static TEE_Result entry_invoke_command(unsigned long session_id,
 	TEE_Result res;
 	uint32_t param_types;
 	TEE_Param params[TEE_NUM_PARAMS];
-	struct ta_session *session = ta_header_get_session(session_id);
+	struct ta_session *session = ta_header_find_session(session_id);
 
 	if (!session)
 		return TEE_ERROR_BAD_STATE;
 
+	init_entry_tls();
 	from_utee_params(params, &param_types, up);
 	ta_header_save_params(param_types, params);
 
@@ -419,8 +559,14 @@ static TEE_Result entry_dump_memstats(unsigned long session_id __unused,
 TEE_Result __utee_entry(unsigned long func, unsigned long session_id,
 			struct utee_params *up, unsigned long cmd_id)
 {
+	struct utee_entry entry = { };
 	TEE_Result res;
 
+	if (is_concurrent()) {
+		entry.tls.entry = &entry;
+		__utee_tls_enter(&entry.tls);
+	}
+
 	switch (func) {
 	case UTEE_ENTRY_FUNC_OPEN_SESSION:
 		res = entry_open_session(session_id, up);
@@ -442,5 +588,8 @@ TEE_Result __utee_entry(unsigned long func, unsigned long session_id,
 	}
 	ta_header_save_params(0, NULL);
 
+	if (is_concurrent())
+		__utee_tls_free(&entry.tls);
+
 	return res;
 }
@@ -109,6 +109,9 @@ static __maybe_unused void *memcpy_unchecked(void *dst, const void *src,
 
 #else /*__KERNEL__*/
 /* Compiling for TA */
+#if defined(CFG_CONCURRENT_USER_TA) && !defined(__LDELF__)
+#include <utee_lock.h>
+#endif
 
 static void *memset_unchecked(void *s, int c, size_t n)
 {
@@ -137,8 +140,10 @@ struct malloc_ctx {
 #ifdef BufStats
 	struct malloc_stats mstats;
 #endif
-#ifdef __KERNEL__
+#if defined(__KERNEL__)
 	unsigned int spinlock;
+#elif defined(CFG_CONCURRENT_USER_TA) && !defined(__LDELF__)
+	uint32_t lock;
 #endif
 };
 
@@ -154,6 +159,24 @@ static void malloc_unlock(struct malloc_ctx *ctx, uint32_t exceptions)
 	cpu_spin_unlock_xrestore(&ctx->spinlock, exceptions);
 }
 
+#elif defined(CFG_CONCURRENT_USER_TA) && !defined(__LDELF__)
+
+/*
+ * A TA with TA_FLAG_CONCURRENT may have several threads executing in it,
+ * a contended lock sleeps in the kernel, see <utee_lock.h>.
+ */
+static uint32_t malloc_lock(struct malloc_ctx *ctx)
+{
+	utee_lock(&ctx->lock);
+	return 0;
+}
+
+static void malloc_unlock(struct malloc_ctx *ctx,
+			  uint32_t exceptions __unused)
+{
+	utee_unlock(&ctx->lock);
+}
+
 #else  /* __KERNEL__ */
 
 static uint32_t malloc_lock(struct malloc_ctx *ctx __unused)
@@ -106,6 +106,15 @@ CFG_MSG_LONG_PREFIX_MASK ?= 0x1a
 # Number of threads
 CFG_NUM_THREADS ?= 2
 
+# CFG_DYN_THREAD_STACKS, when enabled only the first CFG_NUM_STATIC_THREADS
+# threads have a kernel stack reserved at boot. The remaining threads, up to
+# CFG_NUM_THREADS, get a stack from the core heap when a call needs them and
+# give it back once they have been idle for CFG_DYN_THREAD_STACK_IDLE_MS.
+# Not supported with CFG_WITH_PAGER or CFG_NS_VIRTUALIZATION.
+CFG_DYN_THREAD_STACKS ?= n
+CFG_NUM_STATIC_THREADS ?= 2
+CFG_DYN_THREAD_STACK_IDLE_MS ?= 1000
+
 # API implementation version
 CFG_TEE_API_VERSION ?= GPD-1.1-dev
 
@@ -148,6 +157,14 @@ CFG_TEE_FW_MANUFACTURER ?= FW_MAN_UNDEF
 # TEE_STORAGE_PRIVATE is passed to the trusted storage API)
 CFG_REE_FS ?= y
 
+# CFG_REE_FS_ZERO_COPY, when enabled, lets REE FS read and write complete
+# blocks of a TA buffer by decrypting into and encrypting from the TA
+# buffer directly, saving a copy through a temporary block. The crypto
+# implementation must then be able to access user space buffers, which
+# may not be the case for some hardware accelerated drivers.
+CFG_REE_FS_ZERO_COPY ?= n
+$(eval $(call cfg-depends-all,CFG_REE_FS_ZERO_COPY,CFG_REE_FS))
+
 # RPMB file system support
 CFG_RPMB_FS ?= n
 
@@ -247,6 +264,13 @@ CFG_LIBUTILS_WITH_ISOC ?= y
 # With CFG_TA_FLOAT_SUPPORT enabled TA code is free use floating point types
 CFG_TA_FLOAT_SUPPORT ?= y
 
+# CFG_TA_USER_DRBG, when enabled, lets libutee serve TEE_GenerateRandom()
+# and rand() requests of up to 256 bytes from a ChaCha20 based DRBG in the
+# TA, seeded and reseeded every 64 KiB of output from the kernel RNG.
+# Larger requests still go to the kernel RNG. See
+# lib/libutee/tee_api_drbg.c for details.
+CFG_TA_USER_DRBG ?= n
+
 # Stack unwinding: print a stack dump to the console on core or TA abort, or
 # when a TA panics.
 # If CFG_UNWIND is enabled, both the kernel and user mode call stacks can be
@@ -417,10 +441,68 @@ CFG_WITH_PAGER ?= n
 # Use the pager for user TAs
 CFG_PAGED_USER_TA ?= $(CFG_WITH_PAGER)
 
+# Page replacement policy of the pager. With CFG_PAGER_2Q=y pages are
+# first loaded into a FIFO probation list and only pages loaded again
+# shortly after being evicted are promoted to a list kept in LRU order.
+# This keeps large sequential accesses from evicting the working set at
+# the cost of some bookkeeping. With CFG_PAGER_2Q=n all pages are kept in
+# a single list in approximated LRU order.
+CFG_PAGER_2Q ?= n
+
+# CFG_PAGER_FAULT_AROUND, maximum number of read-only pages loaded ahead
+# of a faulting read-only page as long as there are unused physical pages.
+# The actual number adapts to how sequential the faults are. 0 disables.
+CFG_PAGER_FAULT_AROUND ?= 0
+
+# CFG_PAGER_PRECLEAN, maximum number of dirty pages among those next in
+# line to be evicted that are saved each time a standard call has been
+# served. Such pages can then be evicted without saving them while
+# handling a page fault. 0 disables.
+# CFG_PAGER_PRECLEAN_WATERMARK, pages are only saved ahead when fewer than
+# this number of unused pages and clean pages next in line to be evicted
+# are available.
+CFG_PAGER_PRECLEAN ?= 0
+CFG_PAGER_PRECLEAN_WATERMARK ?= 4
+
+# CFG_PAGER_RW_COMPRESS, when enabled evicted read/write pages are
+# compressed before they are encrypted and stored in secure DDR, so only
+# the compressed data is encrypted and decrypted. Pages only containing
+# zeroes aren't encrypted at all. The compressed data is stored in slots
+# of variable size allocated when a page is evicted. If that fails the
+# page is stored uncompressed in a reserve of
+# CFG_PAGER_RW_COMPRESS_RESERVE pages allocated at boot. The tags and IVs
+# are kept in the heap so this is incompatible with
+# CFG_CORE_PAGE_TAG_AND_IV.
+CFG_PAGER_RW_COMPRESS ?= n
+CFG_PAGER_RW_COMPRESS_RESERVE ?= 16
+ifeq ($(CFG_PAGER_RW_COMPRESS),y)
+CFG_CORE_PAGE_TAG_AND_IV ?= n
+endif
+
+# CFG_PAGER_ZERO_PAGE, when enabled a read of a not yet written page in a
+# read/write user TA mapping, such as .bss, heap or stack, maps a shared
+# read-only page of zeroes instead of populating a page. A page is only
+# populated on the first write, so the number of physical pages used
+# follows what the TA actually writes.
+CFG_PAGER_ZERO_PAGE ?= $(CFG_PAGED_USER_TA)
+$(eval $(call cfg-depends-all,CFG_PAGER_ZERO_PAGE,CFG_PAGED_USER_TA))
+
 # If paging of user TAs, that is, R/W paging default to enable paging of
 # TAG and IV in order to reduce heap usage.
 CFG_CORE_PAGE_TAG_AND_IV ?= $(CFG_PAGED_USER_TA)
 
+# CFG_MUTEX_SPIN_US, maximum time in microseconds a thread spins waiting
+# for a contended mutex as long as the thread holding it is executing on
+# another core, before it waits in normal world instead. 0 disables
+# spinning.
+CFG_MUTEX_SPIN_US ?= 0
+
+# CFG_TICKET_SPINLOCK, when enabled cpu_spin_lock() and friends are
+# implemented as ticket locks instead of test-and-set locks. Cores
+# waiting for a lock acquire it in FIFO order and only the lock holder
+# writes to the lock on release, which keeps contended locks fair.
+CFG_TICKET_SPINLOCK ?= n
+
 # Runtime lock dependency checker: ensures that a proper locking hierarchy is
 # used in the TEE core when acquiring and releasing mutexes. Any violation will
 # cause a panic as soon as the invalid locking condition is detected. If
@@ -670,6 +752,13 @@ CFG_CORE_THREAD_SHIFT ?= 0
 # non-secure memory).
 CFG_CORE_DYN_SHM ?= y
 
+# CFG_CORE_DYN_SHM_MAP_CACHE_SIZE, size in bytes of the core mappings of
+# registered shared memory that may be kept while not in use. Such mappings
+# are reused if normal world passes the same shared memory again and are
+# reclaimed under virtual memory pressure or when the shared memory is
+# unregistered. 0 unmaps the shared memory as soon as it is unused.
+CFG_CORE_DYN_SHM_MAP_CACHE_SIZE ?= 0x400000
+
 # Enable support for reserved shared memory (shared memory in a carved out
 # memory area).
 CFG_CORE_RESERVED_SHM ?= y
@@ -853,6 +942,14 @@ CFG_PREALLOC_RPC_CACHE ?= n
 endif
 CFG_PREALLOC_RPC_CACHE ?= y
 
+# CFG_RPC_PAYLOAD_CACHE, when enabled, makes each secure thread keep RPC
+# payload buffers in a few size classes (1, 2, 4 and 8 pages) instead of
+# freeing them with an RPC after each use. Application payloads are
+# released when the secure thread has completed its execution, kernel
+# payloads are kept until the prealloc RPC cache is disabled.
+CFG_RPC_PAYLOAD_CACHE ?= $(CFG_PREALLOC_RPC_CACHE)
+$(eval $(call cfg-depends-all,CFG_RPC_PAYLOAD_CACHE,CFG_PREALLOC_RPC_CACHE))
+
 # When enabled, CFG_DRIVERS_CLK embeds a clock framework in OP-TEE core.
 # This clock framework allows to describe clock tree and provides functions to
 # get and configure the clocks.
@@ -915,6 +1012,10 @@ ifeq (y-y,$(CFG_NS_VIRTUALIZATION)-$(call cfg-one-enabled, CFG_TA_BTI CFG_CORE_B
 $(error CFG_NS_VIRTUALIZATION and BTI are currently incompatible)
 endif
 
+ifeq (y-y,$(CFG_PAGER_RW_COMPRESS)-$(CFG_CORE_PAGE_TAG_AND_IV))
+$(error CFG_PAGER_RW_COMPRESS and CFG_CORE_PAGE_TAG_AND_IV are incompatible)
+endif
+
 ifeq (y-y,$(CFG_PAGED_USER_TA)-$(CFG_TA_BTI))
 $(error CFG_PAGED_USER_TA and CFG_TA_BTI are currently incompatible)
 endif
@@ -945,6 +1046,33 @@ $(eval $(call cfg-depends-one,CFG_PAN,CFG_ARM64_core CFG_RV64_core CFG_RV32_core
 # CFG_CORE_ASYNC_NOTIF_GIC_INTID defined.
 CFG_CORE_ASYNC_NOTIF ?= n
 
+# CFG_CORE_MSG_RING, when enabled, lets normal world register a shared
+# memory ring of struct optee_msg_arg submissions which are drained by
+# secure threads with OPTEE_MSG_CMD_DRAIN_RING. Completions are signalled
+# with an asynchronous notification so several open session, invoke
+# command or close session requests can be served per world switch.
+CFG_CORE_MSG_RING ?= n
+$(eval $(call cfg-depends-all,CFG_CORE_MSG_RING,CFG_CORE_ASYNC_NOTIF \
+	 CFG_CORE_DYN_SHM))
+
+# CFG_TA_PARAM_MAP_CACHE, when enabled, keeps the user TA mappings of
+# memref parameters in registered shared memory between two entries into
+# the TA. A mapping is reused if the next entry passes the same memory,
+# else it's removed before the TA executes. Mappings are dropped as soon
+# as the normal world unregisters the shared memory.
+CFG_TA_PARAM_MAP_CACHE ?= n
+$(eval $(call cfg-depends-all,CFG_TA_PARAM_MAP_CACHE,CFG_WITH_USER_TA \
+	 CFG_CORE_DYN_SHM))
+
+# CFG_TA_ZERO_COPY_MEMREF, when enabled, lets a user TA pass memrefs in
+# its private memory to another user TA without copying them through
+# secure kernel memory. A memref is shared if it covers complete pages of
+# a single region, input memrefs are mapped read-only in the called TA.
+# Other memrefs in private memory, including all memrefs in memory paged
+# with CFG_PAGED_USER_TA, are still copied.
+CFG_TA_ZERO_COPY_MEMREF ?= n
+$(eval $(call cfg-depends-all,CFG_TA_ZERO_COPY_MEMREF,CFG_WITH_USER_TA))
+
 $(eval $(call cfg-enable-all-depends,CFG_MEMPOOL_REPORT_LAST_OFFSET, \
 	 CFG_WITH_STATS))
 
@@ -999,6 +1127,23 @@ endif
 # the platform code
 CFG_CORE_HAS_GENERIC_TIMER ?= y
 
+# CFG_REE_TIME_CACHE, when enabled, samples REE time with an RPC at most
+# every CFG_REE_TIME_CACHE_MS milliseconds and extrapolates it with the
+# generic timer counter in between, so most TEE_GetREETime() calls don't
+# need a switch to normal world. Changes of the REE clock, backwards
+# included, are seen within CFG_REE_TIME_CACHE_MS.
+CFG_REE_TIME_CACHE ?= n
+CFG_REE_TIME_CACHE_MS ?= 1000
+$(eval $(call cfg-depends-all,CFG_REE_TIME_CACHE,CFG_CORE_HAS_GENERIC_TIMER))
+
+# CFG_TA_TIME_PAGE, when enabled, maps a read-only page with the counter
+# frequency into each user TA and gives user mode access to the generic
+# timer counter, so TEE_GetSystemTime() is served in user mode without a
+# syscall. TAs fall back to the syscall if the time source doesn't
+# support this.
+CFG_TA_TIME_PAGE ?= n
+$(eval $(call cfg-depends-all,CFG_TA_TIME_PAGE,CFG_WITH_USER_TA CFG_CORE_HAS_GENERIC_TIMER))
+
 # Enable RTC API
 CFG_DRIVERS_RTC ?= n
 
@@ -1015,6 +1160,25 @@ ifeq (y-y,$(CFG_CORE_PREALLOC_EL0_TBLS)-$(CFG_WITH_PAGER))
 $(error "CFG_WITH_PAGER can't support CFG_CORE_PREALLOC_EL0_TBLS")
 endif
 
+ifeq ($(CFG_DYN_THREAD_STACKS),y)
+ifneq (,$(filter y,$(CFG_WITH_PAGER) $(CFG_NS_VIRTUALIZATION)))
+$(error CFG_DYN_THREAD_STACKS can't be used with CFG_WITH_PAGER or CFG_NS_VIRTUALIZATION)
+endif
+endif
+
+# CFG_CONCURRENT_USER_TA, when enabled a user TA with TA_FLAG_SINGLE_INSTANCE,
+# TA_FLAG_MULTI_SESSION and TA_FLAG_CONCURRENT set may have several of its
+# sessions executing at the same time, each on a stack of its own. Without
+# this the TA_FLAG_CONCURRENT flag is ignored for user TAs. The translation
+# tables of a user TA must remain in place while any of its threads
+# executes so this depends on CFG_CORE_PREALLOC_EL0_TBLS.
+# System calls from such a TA run concurrently, only changes of its address
+# space and its crypto and storage system calls are serialized. In the TA,
+# libutee and malloc() are made thread-safe, but the TEE Arithmetical API
+# and the TA's own global state are not. Only supported with an AArch64 core.
+CFG_CONCURRENT_USER_TA ?= n
+$(eval $(call cfg-depends-all,CFG_CONCURRENT_USER_TA,CFG_CORE_PREALLOC_EL0_TBLS CFG_WITH_USER_TA))
+
 # User TA runtime context dump.
 # When this option is enabled, OP-TEE provides a debug method for
 # developer to dump user TA's runtime context, including TA's heap stats.